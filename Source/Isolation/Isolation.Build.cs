@@ -8,7 +8,7 @@ public class Isolation : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 	
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "Niagara", "PhysicsCore", "UMG", "EnhancedInput", "AIModule"});
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "Niagara", "PhysicsCore", "UMG", "EnhancedInput", "AIModule", "NavigationSystem"});
 
 		PrivateDependencyModuleNames.AddRange(new string[] { "AIModule" });
 
@@ -4,3 +4,19 @@
 #include "Modules/ModuleManager.h"
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, Isolation, "Isolation" );
+
+DEFINE_STAT(STAT_WeaponFire);
+DEFINE_STAT(STAT_WeaponTrace);
+DEFINE_STAT(STAT_WeaponDamage);
+DEFINE_STAT(STAT_WeaponVFX);
+DEFINE_STAT(STAT_WeaponAudio);
+DEFINE_STAT(STAT_WeaponReload);
+DEFINE_STAT(STAT_WeaponSpawnAttachments);
+DEFINE_STAT(STAT_WeaponRenderScope);
+DEFINE_STAT(STAT_WeaponProjectileStep);
+
+DEFINE_STAT(STAT_WeaponShots);
+DEFINE_STAT(STAT_WeaponPellets);
+DEFINE_STAT(STAT_WeaponTraces);
+
+CSV_DEFINE_CATEGORY_MODULE(ISOLATION_API, IsolationWeapons, true);
\ No newline at end of file
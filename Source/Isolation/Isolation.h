@@ -3,10 +3,43 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Stats/Stats.h"
 
 #define WEAPON_TRACE				ECC_GameTraceChannel1
 #define PICKUP_COLLISION			ECC_GameTraceChannel2
 #define FOOTSTEP_TRACE				ECC_GameTraceChannel3
 #define STAND_UP_CHECK_COLLISION	ECC_GameTraceChannel4
 #define ENEMYWEAPON_TRACE			ECC_GameTraceChannel5
-#define EQS							ECC_GameTraceChannel6
\ No newline at end of file
+#define EQS							ECC_GameTraceChannel6
+
+/** Weapon profiling, shown with "stat IsolationWeapons" and recorded under IsolationWeapons in -csvprofile captures */
+DECLARE_STATS_GROUP(TEXT("IsolationWeapons"), STATGROUP_IsolationWeapons, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Fire"), STAT_WeaponFire, STATGROUP_IsolationWeapons, ISOLATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Trace"), STAT_WeaponTrace, STATGROUP_IsolationWeapons, ISOLATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Damage"), STAT_WeaponDamage, STATGROUP_IsolationWeapons, ISOLATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("VFX Spawn"), STAT_WeaponVFX, STATGROUP_IsolationWeapons, ISOLATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Audio Spawn"), STAT_WeaponAudio, STATGROUP_IsolationWeapons, ISOLATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Reload"), STAT_WeaponReload, STATGROUP_IsolationWeapons, ISOLATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Spawn Attachments"), STAT_WeaponSpawnAttachments, STATGROUP_IsolationWeapons, ISOLATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Render Scope"), STAT_WeaponRenderScope, STATGROUP_IsolationWeapons, ISOLATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Projectile Step"), STAT_WeaponProjectileStep, STATGROUP_IsolationWeapons, ISOLATION_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Shots"), STAT_WeaponShots, STATGROUP_IsolationWeapons, ISOLATION_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pellets"), STAT_WeaponPellets, STATGROUP_IsolationWeapons, ISOLATION_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Traces"), STAT_WeaponTraces, STATGROUP_IsolationWeapons, ISOLATION_API);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(ISOLATION_API, IsolationWeapons);
+
+/** Times the rest of the enclosing scope under the given weapon stat, in the stats system, Insights and CSV profiles */
+#define ISOLATION_WEAPON_SCOPE(Stat) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(Stat); \
+	CSV_SCOPED_TIMING_STAT(IsolationWeapons, Stat)
+
+/** Adds to the given weapon counter, in the stats system and CSV profiles */
+#define ISOLATION_WEAPON_COUNTER(Stat, Amount) \
+	INC_DWORD_STAT_BY(Stat, Amount); \
+	CSV_CUSTOM_STAT(IsolationWeapons, Stat, static_cast<int32>(Amount), ECsvCustomStatOp::Accumulate)
\ No newline at end of file
@@ -4,6 +4,12 @@
 #include "AI/AICharacter.h"
 #include "func_lib/AttachmentHelpers.h"
 #include "AI/AICharacterController.h"
+#include "AI/AIManager.h"
+#include "AI/AISignificanceManager.h"
+#include "Components/TargetSelectionComponent.h"
+#include "Kismet/KismetMathLibrary.h"
+#include "Weapons/WeaponPoolSubsystem.h"
+#include "Weapons/WeaponStatsCache.h"
 
 AAICharacter::AAICharacter()
 {
@@ -13,6 +19,17 @@ AAICharacter::AAICharacter()
 void AAICharacter::BeginPlay()
 {
 	Super::BeginPlay();
+
+	// Every AI gets a loadout seed, so that its loadout can be rebuilt if it is dehydrated and hydrated again
+	if (LoadoutSeed == 0)
+	{
+		LoadoutSeed = FMath::RandRange(1, MAX_int32);
+	}
+
+	if (UAISignificanceManager* SignificanceManager = GetWorld()->GetSubsystem<UAISignificanceManager>())
+	{
+		SignificanceManager->RegisterAgent(this);
+	}
 	
 	if (StarterWeapon)
 	{
@@ -22,78 +39,139 @@ void AAICharacter::BeginPlay()
 
 void AAICharacter::UpdateWeapon(const TSubclassOf<AWeaponBase> NewWeapon)
 {
-	 // Determining spawn parameters (forcing the weapon to spawn at all times)
-    FActorSpawnParameters SpawnParameters;
-    SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	// Weapons come from the pool, so that AI being hydrated and dehydrated don't spawn and destroy them each time
+	UWeaponPoolSubsystem* WeaponPool = GetWorld()->GetSubsystem<UWeaponPoolSubsystem>();
+	if (!WeaponPool)
+	{
+		return;
+	}
 
-    // Spawns the new weapon and sets the enemy AI as it's owner
-    CurrentWeapon = GetWorld()->SpawnActor<AWeaponBase>(NewWeapon, FVector::ZeroVector, FRotator::ZeroRotator, SpawnParameters);
-    if (CurrentWeapon)
-    {
+	ReleaseWeapon();
 
-    	
-    	// Placing the new weapon at the correct location and finishing up it's initialisation
-        CurrentWeapon->SetOwner(this);
-    	CurrentWeapon->AttachToComponent(GetMesh(), FAttachmentTransformRules::SnapToTargetNotIncludingScale, CurrentWeapon->GetStaticWeaponData()->AiAttachmentSocketName);
+	// Acquiring the new weapon and setting the enemy AI as it's owner
+	CurrentWeapon = WeaponPool->AcquireWeapon(NewWeapon);
+	if (CurrentWeapon)
+	{
+		// Placing the new weapon at the correct location and finishing up it's initialisation
+		CurrentWeapon->SetOwner(this);
+		CurrentWeapon->AttachToComponent(GetMesh(), FAttachmentTransformRules::SnapToTargetNotIncludingScale, CurrentWeapon->GetStaticWeaponData()->AiAttachmentSocketName);
+
+		// The loadout is drawn from our seed, so that the same AI always carries the same weapon
+		const FRandomStream LoadoutStream(LoadoutSeed);
+		UDataTable* AttachmentsDataTable = CurrentWeapon->GetStaticWeaponData()->AttachmentsDataTable;
 
 		FRuntimeWeaponData DataStruct;
-    	
-    	DataStruct.WeaponAttachments = FAttachmentHelpers::ReplaceIncompatibleAttachments(CurrentWeapon->GetStaticWeaponData()->AttachmentsDataTable, FAttachmentHelpers::RandomiseAllAttachments(CurrentWeapon->GetStaticWeaponData()->AttachmentsDataTable));
-
-    	// Applying default values if the weapon doesn't use attachments
-		DataStruct.AmmoType = CurrentWeapon->GetStaticWeaponData()->AmmoToUse;
-		DataStruct.ClipCapacity = CurrentWeapon->GetStaticWeaponData()->ClipCapacity;
-		DataStruct.ClipSize = CurrentWeapon->GetStaticWeaponData()->ClipSize;
-		DataStruct.WeaponHealth = FMath::FRandRange(10.0f, 75.0f);
-    	
-    	// Getting a reference to our Weapon Data table in order to see if we have attachments
-        if (const FStaticWeaponData* WeaponData = CurrentWeapon->GetWeaponDataTable()->FindRow<FStaticWeaponData>(FName(CurrentWeapon->GetDataTableNameRef()), FString(CurrentWeapon->GetDataTableNameRef()),true))
-        {
-	        // Spawning attachments if the weapon has them and the attachments table exists
-	        if (WeaponData->bHasAttachments && CurrentWeapon->GetStaticWeaponData()->AttachmentsDataTable)
-	        {
-		        // Iterating through all the attachments in AttachmentArray
-		        for (FName RowName : DataStruct.WeaponAttachments)
-		        {
-			        // Searching the data table for the attachment
-			        const FAttachmentData* AttachmentData = CurrentWeapon->GetStaticWeaponData()->AttachmentsDataTable->FindRow<FAttachmentData>(
-				        RowName, RowName.ToString(), true);
-
-			        // Applying the effects of the attachment
-			        if (AttachmentData)
-			        {
-				        if (AttachmentData->AttachmentType == EAttachmentType::Barrel)
-				        {
-				        }
-				        else if (AttachmentData->AttachmentType == EAttachmentType::Magazine)
-				        {
-					        // Pulling default values from the Magazine attachment type
-						    DataStruct.AmmoType = AttachmentData->AmmoToUse;
-						    DataStruct.ClipCapacity = AttachmentData->ClipCapacity;
-						    DataStruct.ClipSize = AttachmentData->ClipSize;
-						    DataStruct.WeaponHealth = FMath::FRandRange(10.0f, 75.0f);
-				        }
-			        }
-		        }
-	        }
-		
-        }
-    	CurrentWeapon->SetRuntimeWeaponData(DataStruct);
-        CurrentWeapon->SpawnAttachments();
-
-    	//TODO: Visibility check for AI, to make sure the player is still visible
-    	//TODO: AI Request firing tokens from AI subsystem
-    	//TODO: Handle AI dropping weapon pickups when they die
-    }
+		DataStruct.WeaponAttachments = FAttachmentHelpers::ReplaceIncompatibleAttachments(AttachmentsDataTable, FAttachmentHelpers::RandomiseAllAttachments(AttachmentsDataTable, &LoadoutStream), &LoadoutStream);
+
+		// Pulling default values from the resolved stats (the magazine attachment, or the weapon itself if it doesn't
+		// use attachments). Loadouts shared between AI are only resolved once per world
+		if (const TSharedPtr<const FResolvedWeaponStats> Stats = UWeaponStatsCache::GetStats(this, CurrentWeapon->GetWeaponDataTable(), FName(CurrentWeapon->GetDataTableNameRef()), DataStruct.WeaponAttachments))
+		{
+			DataStruct.AmmoType = Stats->AmmoType;
+			DataStruct.ClipCapacity = Stats->ClipCapacity;
+			DataStruct.ClipSize = Stats->ClipSize;
+		}
+		DataStruct.WeaponHealth = LoadoutStream.FRandRange(10.0f, 75.0f);
+
+		CurrentWeapon->SetRuntimeWeaponData(DataStruct);
+		CurrentWeapon->SpawnAttachments();
+
+		// Pooled weapons come out hidden. AI weapons are only shown, never set active, as that would register their
+		// scope with the scope capture manager in place of the player's
+		CurrentWeapon->SetActorHiddenInGame(false);
+
+		//TODO: Visibility check for AI, to make sure the player is still visible
+		//TODO: Handle AI dropping weapon pickups when they die
+	}
+}
+
+void AAICharacter::ReleaseWeapon()
+{
+	if (!CurrentWeapon)
+	{
+		return;
+	}
+
+	if (UWeaponPoolSubsystem* WeaponPool = GetWorld()->GetSubsystem<UWeaponPoolSubsystem>())
+	{
+		WeaponPool->ReleaseWeapon(CurrentWeapon);
+	}
+	else
+	{
+		CurrentWeapon->Destroy();
+	}
+	CurrentWeapon = nullptr;
 }
 
 void AAICharacter::StartFire()
 {
-	CurrentWeapon->ScheduleAiFire();
+	// Shots are fired by the AI manager while we hold a firing token, which caps how many AI fire at once
+	if (CurrentWeapon)
+	{
+		if (UAIManager* AIManager = GetWorld()->GetSubsystem<UAIManager>())
+		{
+			AIManager->RequestFiringToken(this);
+		}
+	}
 }
 
 void AAICharacter::StopFire()
 {
+	if (UAIManager* AIManager = GetWorld()->GetSubsystem<UAIManager>())
+	{
+		AIManager->ReleaseFiringToken(this);
+	}
+
+	if (CurrentWeapon)
+	{
+		CurrentWeapon->StopFire();
+	}
+}
+
+void AAICharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UAIManager* AIManager = GetWorld()->GetSubsystem<UAIManager>())
+	{
+		AIManager->ReleaseFiringToken(this);
+	}
+
+	if (UAISignificanceManager* SignificanceManager = GetWorld()->GetSubsystem<UAISignificanceManager>())
+	{
+		SignificanceManager->UnregisterAgent(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+AActor* AAICharacter::GetTargetActor() const
+{
+	const AAICharacterController* CharacterController = AiController.Get();
+	return CharacterController ? CharacterController->GetTargetActor() : nullptr;
+}
+
+bool AAICharacter::HasKnownTarget() const
+{
+	const AAICharacterController* CharacterController = AiController.Get();
+	return CharacterController && CharacterController->TargetSelectionComponent->GetRankedTargets().Num() > 0;
+}
+
+void AAICharacter::SetCombatRole(const ECombatRole NewRole)
+{
+	if (CombatRole != NewRole)
+	{
+		CombatRole = NewRole;
+
+		// Being given a role means we are about to act, so we go back to full rate rather than wait to be re-bucketed
+		if (NewRole != ECombatRole::None)
+		{
+			if (UAISignificanceManager* SignificanceManager = GetWorld()->GetSubsystem<UAISignificanceManager>())
+			{
+				SignificanceManager->PromoteAgent(this);
+			}
+		}
+
+		OnCombatRoleChanged.Broadcast(NewRole);
+	}
 }
 
 void AAICharacter::GetActorEyesViewPoint(FVector& OutLocation, FRotator& OutRotation) const
@@ -101,4 +179,29 @@ void AAICharacter::GetActorEyesViewPoint(FVector& OutLocation, FRotator& OutRota
 	Super::GetActorEyesViewPoint(OutLocation, OutRotation);
 	OutLocation = GetMesh()->GetSocketLocation("HeadSocket");
 	OutRotation = GetMesh()->GetSocketRotation("HeadSocket");
+}
+
+void AAICharacter::PossessedBy(AController* NewController)
+{
+	Super::PossessedBy(NewController);
+	AiController = Cast<AAICharacterController>(NewController);
+}
+
+void AAICharacter::UnPossessed()
+{
+	Super::UnPossessed();
+	AiController.Reset();
+}
+
+bool AAICharacter::GetShotAim(const AWeaponBase* Weapon, FVector& OutOrigin, FRotator& OutAimRotation) const
+{
+	const AActor* TargetActor = GetTargetActor();
+	if (!IsValid(TargetActor))
+	{
+		return false;
+	}
+
+	OutOrigin = Weapon->GetMuzzleLocation();
+	OutAimRotation = UKismetMathLibrary::FindLookAtRotation(OutOrigin, TargetActor->GetActorLocation());
+	return true;
 }
\ No newline at end of file
@@ -2,15 +2,30 @@
 
 
 #include "AI/AICharacterController.h"
+#include "AI/AICharacter.h"
+#include "AI/AIManager.h"
+#include "AI/AISignificanceManager.h"
+#include "AI/CoverSubsystem.h"
+#include "AI/FlankPlanner.h"
+#include "Components/TargetSelectionComponent.h"
 #include "Navigation/CrowdFollowingComponent.h"
 #include "Perception/AIPerceptionComponent.h"
 #include "Perception/AISense_Sight.h"
 
+/** How far from our pawn cover is looked for when the utility AI decides we should take cover */
+static constexpr float UtilityCoverSearchRadius = 1000.0f;
+
 AAICharacterController::AAICharacterController(const FObjectInitializer& ObjectInitializer)
 : Super(ObjectInitializer.SetDefaultSubobjectClass<UCrowdFollowingComponent>(TEXT("PathFollowingComponent")))
 {
 	AiPerceptionComponent = CreateDefaultSubobject<UAIPerceptionComponent>(TEXT("AiPerceptionComponent"));
+	TargetSelectionComponent = CreateDefaultSubobject<UTargetSelectionComponent>(TEXT("TargetSelectionComponent"));
 	AAIController::SetGenericTeamId(FGenericTeamId(5));
+
+	Attitude = Attitude::Aggressive;
+	Speed = Speed::Medium;
+	PreferredEngagementRange = PreferredEngagementRange::Medium;
+	bAllowHardpointAssignment = false;
 }
 
 ETeamAttitude::Type AAICharacterController::GetTeamAttitudeTowards(const AActor& Other) const
@@ -32,57 +47,132 @@ void AAICharacterController::BeginPlay()
 	AiPerceptionComponent->OnPerceptionUpdated.AddDynamic(this, &AAICharacterController::HandlePerceptionUpdate);
 }
 
-int AAICharacterController::Partition(TArray<AActor*> *InArray, int Start, int End) const
+void AAICharacterController::OnPossess(APawn* InPawn)
 {
-	const float Pivot = (*InArray)[Start]->GetDistanceTo(this);
+	Super::OnPossess(InPawn);
 
-	int Count = 0;
-	for (int i = Start + 1; i <= End; ++i)
+	if (InPawn)
 	{
-		if ((*InArray)[i]->GetDistanceTo(this) <= Pivot)
+		InPawn->OnTakeAnyDamage.AddDynamic(this, &AAICharacterController::HandlePawnTakeAnyDamage);
+
+		if (UUtilityAISubsystem* UtilityAI = GetWorld()->GetSubsystem<UUtilityAISubsystem>())
 		{
-			Count++;	
-		}	
+			UtilityAI->RegisterAgent(this);
+		}
 	}
+}
 
-	int PivotIndex = Start + Count;
-	Swap(InArray[PivotIndex], InArray[Start]);
-
-	int i = Start, j = End;
-
-	while (i < PivotIndex && j > PivotIndex)
+void AAICharacterController::OnUnPossess()
+{
+	if (APawn* PossessedPawn = GetPawn())
 	{
-		while ((*InArray)[i]->GetDistanceTo(this) <= Pivot)
-		{
-			i++;
-		}
+		PossessedPawn->OnTakeAnyDamage.RemoveDynamic(this, &AAICharacterController::HandlePawnTakeAnyDamage);
 
-		while ((*InArray)[j]->GetDistanceTo(this) > Pivot)
+		if (UCoverSubsystem* CoverSubsystem = GetWorld()->GetSubsystem<UCoverSubsystem>())
 		{
-			j--;
+			CoverSubsystem->ReleaseCover(PossessedPawn);
 		}
+	}
 
-		if (i < PivotIndex && j > PivotIndex)
-		{
-			Swap(InArray[i++], InArray[j--]);
-		}
+	if (UUtilityAISubsystem* UtilityAI = GetWorld()->GetSubsystem<UUtilityAISubsystem>())
+	{
+		UtilityAI->UnregisterAgent(this);
+	}
+	UtilityAction = EUtilityAction::None;
+
+	Super::OnUnPossess();
+}
+
+bool AAICharacterController::FindCoverFromTarget(const float SearchRadius, FVector& OutCoverLocation)
+{
+	const APawn* PossessedPawn = GetPawn();
+	UCoverSubsystem* CoverSubsystem = GetWorld()->GetSubsystem<UCoverSubsystem>();
+	if (!bAllowCover || !PossessedPawn || !TargetActor || !CoverSubsystem)
+	{
+		return false;
+	}
+
+	const int32 CoverIndex = CoverSubsystem->FindBestCover(TargetActor->GetActorLocation(), PossessedPawn->GetActorLocation(),
+	                                                       SearchRadius, ECoverType::Crouch, PossessedPawn);
+	if (CoverIndex == INDEX_NONE || !CoverSubsystem->ClaimCover(CoverIndex, PossessedPawn))
+	{
+		return false;
 	}
 
-	return PivotIndex;
+	OutCoverLocation = CoverSubsystem->GetCoverPoint(CoverIndex).Location;
+	return true;
+}
+
+bool AAICharacterController::FlankTarget()
+{
+	UFlankPlanner* FlankPlanner = GetWorld()->GetSubsystem<UFlankPlanner>();
+	if (!FlankPlanner || !TargetActor)
+	{
+		return false;
+	}
+
+	return FlankPlanner->RequestFlank(Cast<AAICharacter>(GetPawn()), TargetActor,
+	                                  FFlankPlannedDelegate::CreateUObject(this, &AAICharacterController::HandleFlankPlanned));
+}
+
+void AAICharacterController::HandleFlankPlanned(const bool bFound, const FVector& FlankLocation)
+{
+	if (bFound)
+	{
+		MoveToLocation(FlankLocation);
+	}
 }
 
-void AAICharacterController::QuickSort(TArray<AActor*> *InArray, int Start, int End)
+void AAICharacterController::HearNoise(const FNoiseEvent& Noise, const float Strength)
 {
-	if (Start >= End) return;
+	LastHeardNoiseLocation = Noise.Location;
+	LastHeardNoiseTime = GetWorld()->GetTimeSeconds();
 
-	const int P = Partition(InArray, Start, End);
+	// Something worth reacting to, so we need to be running at full rate to react to it
+	PromotePawnSignificance();
 
-	QuickSort(InArray, Start, P-1);
+	OnNoiseHeard.Broadcast(Noise.Location, Noise.Type, Noise.Instigator.Get());
+}
 
-	QuickSort(InArray, P+1, End);
+bool AAICharacterController::GetLastHeardNoise(const float MaxAge, FVector& OutLocation) const
+{
+	if (LastHeardNoiseTime < 0.0f || GetWorld()->GetTimeSeconds() - LastHeardNoiseTime > MaxAge)
+	{
+		return false;
+	}
+
+	OutLocation = LastHeardNoiseLocation;
+	return true;
 }
 
+void AAICharacterController::SetUtilityAction(const EUtilityAction NewAction)
+{
+	if (NewAction == UtilityAction)
+	{
+		return;
+	}
+	UtilityAction = NewAction;
+
+	switch (NewAction)
+	{
+	case EUtilityAction::TakeCover:
+		{
+			FVector CoverLocation;
+			if (FindCoverFromTarget(UtilityCoverSearchRadius, CoverLocation))
+			{
+				MoveToLocation(CoverLocation);
+			}
+			break;
+		}
+	case EUtilityAction::Flank:
+		FlankTarget();
+		break;
+	default:
+		break;
+	}
 
+	OnUtilityActionChanged.Broadcast(NewAction);
+}
 
 void AAICharacterController::HandlePerceptionUpdate(const TArray<AActor*>& UpdatedActors)
 {
@@ -91,13 +181,38 @@ void AAICharacterController::HandlePerceptionUpdate(const TArray<AActor*>& Updat
 
 void AAICharacterController::UpdateTargetActor()
 {
-	AiPerceptionComponent->GetCurrentlyPerceivedActors(UAISense_Sight::StaticClass(), TargetsArray);
-	if (TargetsArray.Num() > 0)
+	TargetSelectionComponent->UpdateTargets(AiPerceptionComponent);
+	AActor* NewTargetActor = TargetSelectionComponent->GetBestVisibleTarget();
+
+	// Gaining or losing sight of a target can change the role we should play in our squad
+	if (NewTargetActor != TargetActor)
 	{
-		TargetActor = TargetsArray[0];
+		TargetActor = NewTargetActor;
+		if (UAIManager* AIManager = GetWorld()->GetSubsystem<UAIManager>())
+		{
+			AIManager->MarkCombatRoleDirty(Cast<AAICharacter>(GetPawn()));
+		}
+
+		if (TargetActor)
+		{
+			PromotePawnSignificance();
+		}
 	}
-	else
+}
+
+void AAICharacterController::HandlePawnTakeAnyDamage(AActor* DamagedActor, const float Damage,
+                                                     const UDamageType* DamageType, AController* InstigatedBy,
+                                                     AActor* DamageCauser)
+{
+	AActor* Source = InstigatedBy && InstigatedBy->GetPawn() ? InstigatedBy->GetPawn() : DamageCauser;
+	TargetSelectionComponent->ReportDamage(Source, Damage);
+	PromotePawnSignificance();
+}
+
+void AAICharacterController::PromotePawnSignificance() const
+{
+	if (UAISignificanceManager* SignificanceManager = GetWorld()->GetSubsystem<UAISignificanceManager>())
 	{
-		TargetActor = nullptr;
+		SignificanceManager->PromoteAgent(Cast<AAICharacter>(GetPawn()));
 	}
 }
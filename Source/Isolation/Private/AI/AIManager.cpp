@@ -2,8 +2,527 @@
 
 
 #include "AI/AIManager.h"
+#include "AI/AICharacter.h"
+#include "AI/AICharacterController.h"
+#include "AI/LineOfSightCache.h"
+#include "WeaponBase.h"
+
+static TAutoConsoleVariable<int32> CVarAiMaxTracesPerFrame(
+	TEXT("isolation.AI.MaxTracesPerFrame"),
+	8,
+	TEXT("The maximum number of weapon traces AI may make in a single frame. Shots beyond the budget are delayed to the next frame."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAiTokenRotationInterval(
+	TEXT("isolation.AI.TokenRotationInterval"),
+	1.0f,
+	TEXT("How often, in seconds, firing tokens are re-scored and handed to the highest priority AI."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAiTokenWaitWeight(
+	TEXT("isolation.AI.TokenWaitWeight"),
+	0.5f,
+	TEXT("Priority gained per second by AI waiting for a firing token, so that tokens rotate between everyone engaged."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarAiRoleUpdatesPerFrame(
+	TEXT("isolation.AI.RoleUpdatesPerFrame"),
+	8,
+	TEXT("The maximum number of AI whose combat roles are re-evaluated in a single frame after their situation changed."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarAiRoleChecksPerFrame(
+	TEXT("isolation.AI.RoleChecksPerFrame"),
+	2,
+	TEXT("The number of AI whose combat roles are re-checked each frame in turn, catching AI that have drifted out of range."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAiSpatialHashCellSize(
+	TEXT("isolation.AI.SpatialHashCellSize"),
+	1000.0f,
+	TEXT("The width of each cell in the AI spatial hash. Takes effect when the next level loads."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarAiSquadSightEnabled(
+	TEXT("isolation.AI.SquadSight.Enabled"),
+	1,
+	TEXT("Whether AI share sight traces with nearby members of their squad."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAiSquadSightShareRadius(
+	TEXT("isolation.AI.SquadSight.ShareRadius"),
+	300.0f,
+	TEXT("AI within this distance of a squad member tracing to the target may take its result rather than tracing themselves."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAiSquadSightMaxShareAngle(
+	TEXT("isolation.AI.SquadSight.MaxShareAngle"),
+	10.0f,
+	TEXT("The largest angle, in degrees, between two AI's directions to the target for one to take the other's result."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarAiSquadSightMaxRepresentatives(
+	TEXT("isolation.AI.SquadSight.MaxRepresentatives"),
+	4,
+	TEXT("The most AI in each squad whose sight traces are shared. Members out of reach of every representative trace for themselves."),
+	ECVF_Default);
+
+/** Sight representatives that haven't looked for this long are replaced */
+static constexpr float SightRepresentativeTimeout = 1.0f;
 
 void UAIManager::Initialize(FSubsystemCollectionBase& Collection)
 {
 	Super::Initialize(Collection);
-}
\ No newline at end of file
+
+	SpatialHash.Reset(CVarAiSpatialHashCellSize.GetValueOnGameThread());
+}
+
+void UAIManager::Deinitialize()
+{
+	Shooters.Empty();
+	RoleAgents.Empty();
+	RoleAgentIndices.Empty();
+	Squads.Empty();
+	DirtyRoleAgents.Empty();
+	SightRepresentatives.Empty();
+	SpatialHash.Reset(CVarAiSpatialHashCellSize.GetValueOnGameThread());
+
+	Super::Deinitialize();
+}
+
+void UAIManager::RequestFiringToken(AAICharacter* Character)
+{
+	if (!Character || Shooters.ContainsByPredicate([Character](const FAiShooter& Shooter) { return Shooter.Character == Character; }))
+	{
+		return;
+	}
+
+	FAiShooter& Shooter = Shooters.AddDefaulted_GetRef();
+	Shooter.Character = Character;
+	Shooter.NextFireTime = GetWorld()->GetTimeSeconds();
+	bTokensDirty = true;
+}
+
+void UAIManager::ReleaseFiringToken(AAICharacter* Character)
+{
+	const int32 Index = Shooters.IndexOfByPredicate([Character](const FAiShooter& Shooter) { return Shooter.Character == Character; });
+	if (Index != INDEX_NONE)
+	{
+		// Handing the token on straight away, rather than leaving it unused until the next rotation
+		bTokensDirty |= Shooters[Index].bHasToken;
+		Shooters.RemoveAtSwap(Index, 1, false);
+	}
+}
+
+bool UAIManager::HasFiringToken(const AAICharacter* Character) const
+{
+	const FAiShooter* Shooter = Shooters.FindByPredicate([Character](const FAiShooter& Entry) { return Entry.Character == Character; });
+	return Shooter && Shooter->bHasToken;
+}
+
+void UAIManager::RegisterAgent(AActor* Agent, const EAgentType Type)
+{
+	SpatialHash.Add(Agent, Type);
+
+	AAICharacter* Character = Cast<AAICharacter>(Agent);
+	if (Character && !RoleAgentIndices.Contains(Character))
+	{
+		RoleAgentIndices.Add(Character, RoleAgents.Num());
+		FRoleAgent& RoleAgent = RoleAgents.AddDefaulted_GetRef();
+		RoleAgent.Key = Character;
+		RoleAgent.Character = Character;
+		RoleAgent.SquadId = Character->GetSquadId();
+		Squads.FindOrAdd(RoleAgent.SquadId).Members.Add(Character);
+	}
+}
+
+void UAIManager::UnregisterAgent(const AActor* Agent)
+{
+	SpatialHash.Remove(Agent);
+	RemoveRoleAgent(Cast<AAICharacter>(Agent));
+}
+
+void UAIManager::MarkCombatRoleDirty(const AAICharacter* Character)
+{
+	const int32* Index = RoleAgentIndices.Find(Character);
+	if (Index && !RoleAgents[*Index].bQueued)
+	{
+		RoleAgents[*Index].bQueued = true;
+		DirtyRoleAgents.Add(Character);
+	}
+}
+
+bool UAIManager::QuerySquadVisibility(const AFPSCharacter* Target, const AActor* Observer,
+                                      const FVector& ObserverLocation, FVector& OutSeenLocation)
+{
+	ULineOfSightCache* LineOfSightCache = GetWorld()->GetSubsystem<ULineOfSightCache>();
+	if (!LineOfSightCache || !Target)
+	{
+		return false;
+	}
+
+	const AAICharacter* Character = Cast<AAICharacter>(Observer);
+	if (!Character || !CVarAiSquadSightEnabled.GetValueOnGameThread())
+	{
+		return LineOfSightCache->QueryVisibility(Target, Observer, ObserverLocation, OutSeenLocation);
+	}
+
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	TArray<FSightRepresentative, TInlineAllocator<4>>& Representatives = SightRepresentatives.FindOrAdd(Character->GetSquadId());
+
+	// Finding whether we are a representative ourselves, or the closest one we could share with
+	FSightRepresentative* ClosestRepresentative = nullptr;
+	float ClosestDistanceSquared = FMath::Square(CVarAiSquadSightShareRadius.GetValueOnGameThread());
+	for (FSightRepresentative& Representative : Representatives)
+	{
+		if (Representative.Observer == Observer)
+		{
+			Representative.EyeLocation = ObserverLocation;
+			Representative.LastQueryTime = CurrentTime;
+			return LineOfSightCache->QueryVisibility(Target, Observer, ObserverLocation, OutSeenLocation);
+		}
+
+		const float DistanceSquared = FVector::DistSquared(Representative.EyeLocation, ObserverLocation);
+		if (Representative.Observer.IsValid() && DistanceSquared <= ClosestDistanceSquared)
+		{
+			ClosestDistanceSquared = DistanceSquared;
+			ClosestRepresentative = &Representative;
+		}
+	}
+
+	if (ClosestRepresentative)
+	{
+		// The representative's result holds for us too if we see the target from nearly the same direction
+		FVector RepresentativeSeenLocation;
+		const bool bRepresentativeSees = LineOfSightCache->QueryVisibility(Target, ClosestRepresentative->Observer.Get(),
+		                                                                   ClosestRepresentative->EyeLocation, RepresentativeSeenLocation);
+
+		const FVector TargetLocation = bRepresentativeSees ? RepresentativeSeenLocation : Target->GetActorLocation();
+		const FVector RepresentativeDirection = (ClosestRepresentative->EyeLocation - TargetLocation).GetSafeNormal();
+		const FVector Direction = (ObserverLocation - TargetLocation).GetSafeNormal();
+		const float MinAlignment = FMath::Cos(FMath::DegreesToRadians(CVarAiSquadSightMaxShareAngle.GetValueOnGameThread()));
+		if (FVector::DotProduct(RepresentativeDirection, Direction) >= MinAlignment)
+		{
+			OutSeenLocation = RepresentativeSeenLocation;
+			return bRepresentativeSees;
+		}
+	}
+	else if (Representatives.Num() < CVarAiSquadSightMaxRepresentatives.GetValueOnGameThread())
+	{
+		// No one near enough to share with, so we start tracing on behalf of the members around us
+		FSightRepresentative& Representative = Representatives.AddDefaulted_GetRef();
+		Representative.Observer = Observer;
+		Representative.EyeLocation = ObserverLocation;
+		Representative.LastQueryTime = CurrentTime;
+	}
+
+	return LineOfSightCache->QueryVisibility(Target, Observer, ObserverLocation, OutSeenLocation);
+}
+
+void UAIManager::ExpireSightRepresentatives()
+{
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	for (auto It = SightRepresentatives.CreateIterator(); It; ++It)
+	{
+		It->Value.RemoveAllSwap([CurrentTime](const FSightRepresentative& Representative)
+		{
+			return !Representative.Observer.IsValid() || CurrentTime - Representative.LastQueryTime > SightRepresentativeTimeout;
+		});
+
+		if (It->Value.Num() == 0)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void UAIManager::Tick(float DeltaTime)
+{
+	// Only agents that have crossed into a new cell are moved, everyone else just has their location refreshed
+	SpatialHash.Update();
+
+	UpdateCombatRoles();
+
+	ExpireSightRepresentatives();
+
+	// Dropping anyone who has died or been removed since last frame
+	const int32 NumShooters = Shooters.Num();
+	Shooters.RemoveAll([](const FAiShooter& Shooter) { return !Shooter.Character.IsValid(); });
+	bTokensDirty |= Shooters.Num() != NumShooters;
+
+	for (FAiShooter& Shooter : Shooters)
+	{
+		if (!Shooter.bHasToken)
+		{
+			Shooter.TimeWithoutToken += DeltaTime;
+		}
+	}
+
+	TimeSinceTokenRotation += DeltaTime;
+	if (bTokensDirty || TimeSinceTokenRotation >= CVarAiTokenRotationInterval.GetValueOnGameThread())
+	{
+		RotateFiringTokens();
+	}
+
+	FireTokenHolders();
+}
+
+void UAIManager::RotateFiringTokens()
+{
+	TimeSinceTokenRotation = 0.0f;
+	bTokensDirty = false;
+
+	const float WaitWeight = CVarAiTokenWaitWeight.GetValueOnGameThread();
+	int32 NumEligible = 0;
+	for (FAiShooter& Shooter : Shooters)
+	{
+		const AAICharacter* Character = Shooter.Character.Get();
+		AWeaponBase* Weapon = Character->GetCurrentWeapon();
+		const AActor* Target = Character->GetTargetActor();
+		if (!Weapon || !Target)
+		{
+			// AI without a weapon or a target have nothing to shoot at, so never hold a token
+			Shooter.Priority = -1.0f;
+			continue;
+		}
+
+		// Threat is the damage the AI can deal per second, which falls off with distance from their target
+		const FAiWeaponData& AiWeaponData = Weapon->GetStaticWeaponData()->AiWeaponData;
+		const float Threat = AiWeaponData.AiDamage * Weapon->GetPelletsPerShot() * AiWeaponData.AiRateOfFire / 60.0f;
+		const float Distance = FVector::Dist(Character->GetActorLocation(), Target->GetActorLocation());
+		Shooter.Priority = Threat / (1.0f + Distance / 1000.0f) + Shooter.TimeWithoutToken * WaitWeight;
+		NumEligible++;
+	}
+
+	Shooters.Sort([](const FAiShooter& A, const FAiShooter& B) { return A.Priority > B.Priority; });
+
+	const int32 MaxShooters = GlobalCombatParameters.MaxShooters;
+	const int32 NumTokens = MaxShooters > 0 ? FMath::Min(NumEligible, MaxShooters) : NumEligible;
+	for (int32 Index = 0; Index < Shooters.Num(); Index++)
+	{
+		FAiShooter& Shooter = Shooters[Index];
+		const bool bHadToken = Shooter.bHasToken;
+		Shooter.bHasToken = Index < NumTokens;
+
+		if (Shooter.bHasToken && !bHadToken)
+		{
+			// New holders start a fresh burst, so begin at their least accurate
+			Shooter.TimeWithoutToken = 0.0f;
+			Shooter.NextFireTime = FMath::Max(Shooter.NextFireTime, GetWorld()->GetTimeSeconds());
+			if (AWeaponBase* Weapon = Shooter.Character->GetCurrentWeapon())
+			{
+				Weapon->BeginAiFire();
+			}
+		}
+	}
+}
+
+void UAIManager::FireTokenHolders()
+{
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	int32 TraceBudget = CVarAiMaxTracesPerFrame.GetValueOnGameThread();
+
+	// Token holders are sorted by priority, so the first MinShooters of them are the ones exempt from the budget
+	int32 NumHolders = 0;
+	for (int32 Index = 0; Index < Shooters.Num(); Index++)
+	{
+		FAiShooter& Shooter = Shooters[Index];
+		if (!Shooter.bHasToken)
+		{
+			continue;
+		}
+
+		const bool bGuaranteedShot = NumHolders++ < GlobalCombatParameters.MinShooters;
+		AAICharacter* Character = Shooter.Character.Get();
+		AWeaponBase* Weapon = Character ? Character->GetCurrentWeapon() : nullptr;
+		if (!Weapon || Shooter.NextFireTime > CurrentTime)
+		{
+			continue;
+		}
+
+		// Shots that don't fit in the budget stay due, and are taken first thing next frame
+		const int32 Pellets = Weapon->GetPelletsPerShot();
+		if (!bGuaranteedShot && Pellets > TraceBudget)
+		{
+			continue;
+		}
+
+		// Firing an empty weapon plays its empty click and tells the AI to reload, after which it drops out of the
+		// rotation until it asks to fire again
+		const bool bWasEmpty = Weapon->GetRuntimeWeaponData()->ClipSize <= 0;
+		Weapon->Fire();
+		if (bWasEmpty)
+		{
+			Shooter.Character.Reset();
+			bTokensDirty = true;
+			continue;
+		}
+
+		TraceBudget -= Pellets;
+
+		const float RateOfFire = Weapon->GetStaticWeaponData()->AiWeaponData.AiRateOfFire;
+		Shooter.NextFireTime = CurrentTime + (RateOfFire > 0.0f ? 60.0f / RateOfFire : 1.0f);
+	}
+
+	Shooters.RemoveAll([](const FAiShooter& Shooter) { return !Shooter.Character.IsValid(); });
+}
+
+void UAIManager::UpdateCombatRoles()
+{
+	// AI whose situation has changed come first, oldest first
+	const int32 NumUpdates = FMath::Min(DirtyRoleAgents.Num(), CVarAiRoleUpdatesPerFrame.GetValueOnGameThread());
+	for (int32 Index = 0; Index < NumUpdates; Index++)
+	{
+		if (const int32* AgentIndex = RoleAgentIndices.Find(DirtyRoleAgents[Index]))
+		{
+			FRoleAgent& RoleAgent = RoleAgents[*AgentIndex];
+			RoleAgent.bQueued = false;
+			AssignCombatRole(RoleAgent);
+		}
+	}
+	DirtyRoleAgents.RemoveAt(0, NumUpdates, false);
+
+	// Then a few more in turn, which catches changes nobody told us about, like an engager falling out of range
+	const int32 NumChecks = FMath::Min(RoleAgents.Num(), CVarAiRoleChecksPerFrame.GetValueOnGameThread());
+	for (int32 Check = 0; Check < NumChecks; Check++)
+	{
+		NextRoleCheck = NextRoleCheck < RoleAgents.Num() ? NextRoleCheck : 0;
+		AssignCombatRole(RoleAgents[NextRoleCheck++]);
+	}
+}
+
+void UAIManager::AssignCombatRole(FRoleAgent& RoleAgent)
+{
+	AAICharacter* Character = RoleAgent.Character.Get();
+	FCombatSquad* Squad = Squads.Find(RoleAgent.SquadId);
+	if (!Character || !Squad)
+	{
+		return;
+	}
+
+	// Engaging needs the target in sight and within range, the other roles only need a target seen recently
+	const AActor* Target = Character->GetTargetActor();
+	const float EngageRange = GlobalCombatParameters.SnuckAwayDistance;
+	const bool bCanEngage = Target && (EngageRange <= 0.0f ||
+		FVector::DistSquared(Character->GetActorLocation(), Target->GetActorLocation()) <= FMath::Square(EngageRange));
+	const bool bHasTarget = bCanEngage || Character->HasKnownTarget();
+
+	const ECombatRole CurrentRole = RoleAgent.Role;
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+
+	// Trying each role we are eligible for, best first. Our current role counts as free to us, unless the squad has
+	// more of it than it is now allowed
+	for (const ECombatRole Role : {ECombatRole::Engager, ECombatRole::Ambusher, ECombatRole::Searcher})
+	{
+		if ((Role == ECombatRole::Engager && !bCanEngage) || !bHasTarget)
+		{
+			continue;
+		}
+
+		const int32 RoleIndex = static_cast<int32>(Role);
+		if (Role == CurrentRole)
+		{
+			if (Squad->RoleCounts[RoleIndex] <= GetRoleLimit(Role))
+			{
+				return;
+			}
+			continue;
+		}
+
+		const bool bSlotOpen = Squad->RoleCounts[RoleIndex] < GetRoleLimit(Role) &&
+			(Role != ECombatRole::Engager || CurrentTime >= Squad->EngagerReopenTime);
+		if (bSlotOpen)
+		{
+			SetCombatRole(RoleAgent, *Squad, Role);
+			return;
+		}
+	}
+
+	SetCombatRole(RoleAgent, *Squad, ECombatRole::None);
+}
+
+void UAIManager::SetCombatRole(FRoleAgent& RoleAgent, FCombatSquad& Squad, const ECombatRole NewRole)
+{
+	const ECombatRole OldRole = RoleAgent.Role;
+	if (OldRole == NewRole)
+	{
+		return;
+	}
+	RoleAgent.Role = NewRole;
+
+	if (OldRole != ECombatRole::None)
+	{
+		Squad.RoleCounts[static_cast<int32>(OldRole)]--;
+
+		// Engagers that stop engaging are only replaced after a delay
+		if (OldRole == ECombatRole::Engager)
+		{
+			Squad.EngagerReopenTime = GetWorld()->GetTimeSeconds() + GlobalCombatParameters.EngagerReplacementDelay;
+		}
+
+		// Only the squad members holding a lesser role, or none, could take the role given up
+		for (const AAICharacter* Member : Squad.Members)
+		{
+			const FRoleAgent& MemberAgent = RoleAgents[RoleAgentIndices.FindChecked(Member)];
+			if (Member != RoleAgent.Key && (MemberAgent.Role == ECombatRole::None || MemberAgent.Role > OldRole))
+			{
+				MarkCombatRoleDirty(Member);
+			}
+		}
+	}
+
+	if (NewRole != ECombatRole::None)
+	{
+		Squad.RoleCounts[static_cast<int32>(NewRole)]++;
+	}
+
+	if (AAICharacter* Character = RoleAgent.Character.Get())
+	{
+		Character->SetCombatRole(NewRole);
+	}
+}
+
+int32 UAIManager::GetRoleLimit(const ECombatRole Role) const
+{
+	switch (Role)
+	{
+	case ECombatRole::Engager:
+		return GlobalCombatParameters.NumEngagers;
+	case ECombatRole::Ambusher:
+		return GlobalCombatParameters.NumAmbushers;
+	case ECombatRole::Searcher:
+		return GlobalCombatParameters.NumSearchers;
+	default:
+		return 0;
+	}
+}
+
+void UAIManager::RemoveRoleAgent(const AAICharacter* Character)
+{
+	const int32* IndexPtr = RoleAgentIndices.Find(Character);
+	if (!IndexPtr)
+	{
+		return;
+	}
+
+	const int32 Index = *IndexPtr;
+	RoleAgentIndices.Remove(Character);
+
+	// Freeing the role, which lets the rest of the squad take it
+	FRoleAgent& RoleAgent = RoleAgents[Index];
+	if (FCombatSquad* Squad = Squads.Find(RoleAgent.SquadId))
+	{
+		Squad->Members.RemoveSingleSwap(Character, false);
+		SetCombatRole(RoleAgent, *Squad, ECombatRole::None);
+		if (Squad->Members.Num() == 0)
+		{
+			Squads.Remove(RoleAgent.SquadId);
+		}
+	}
+
+	RoleAgents.RemoveAtSwap(Index, 1, false);
+	if (Index < RoleAgents.Num())
+	{
+		RoleAgentIndices.Add(RoleAgents[Index].Key, Index);
+	}
+}
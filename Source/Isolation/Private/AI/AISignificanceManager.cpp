@@ -0,0 +1,211 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/AISignificanceManager.h"
+#include "AI/AICharacter.h"
+#include "AI/LineOfSightCache.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/PlayerController.h"
+
+static TAutoConsoleVariable<int32> CVarAiSignificanceUpdatesPerFrame(
+	TEXT("isolation.AI.Significance.UpdatesPerFrame"),
+	16,
+	TEXT("The number of AI whose significance is re-evaluated each frame, in turn."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAiSignificanceHighDistance(
+	TEXT("isolation.AI.Significance.HighDistance"),
+	1500.0f,
+	TEXT("AI closer than this to the player's view always run at full rate."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAiSignificanceMediumDistance(
+	TEXT("isolation.AI.Significance.MediumDistance"),
+	4000.0f,
+	TEXT("AI further than this from the player's view, and out of sight, run at the lowest rate."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAiSignificanceMediumTickInterval(
+	TEXT("isolation.AI.Significance.MediumTickInterval"),
+	0.1f,
+	TEXT("The tick and line of sight interval, in seconds, of medium significance AI."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarAiSignificanceLowTickInterval(
+	TEXT("isolation.AI.Significance.LowTickInterval"),
+	0.5f,
+	TEXT("The tick and line of sight interval, in seconds, of low significance AI."),
+	ECVF_Default);
+
+void UAISignificanceManager::Deinitialize()
+{
+	Agents.Empty();
+	AgentIndices.Empty();
+
+	Super::Deinitialize();
+}
+
+void UAISignificanceManager::RegisterAgent(AAICharacter* Character)
+{
+	if (!Character || AgentIndices.Contains(Character))
+	{
+		return;
+	}
+
+	AgentIndices.Add(Character, Agents.Num());
+	FAiSignificanceAgent& Agent = Agents.AddDefaulted_GetRef();
+	Agent.Key = Character;
+	Agent.Character = Character;
+	Agent.DefaultActorTickInterval = Character->GetActorTickInterval();
+	Agent.DefaultMovementTickInterval = Character->GetCharacterMovement()->GetComponentTickInterval();
+
+	USkeletalMeshComponent* Mesh = Character->GetMesh();
+	Agent.DefaultMeshTickInterval = Mesh->GetComponentTickInterval();
+	Agent.DefaultAnimTickOption = Mesh->VisibilityBasedAnimTickOption;
+
+	// Letting the engine lower the animation rate of meshes that are small on screen, on top of our own throttling
+	Mesh->bEnableUpdateRateOptimizations = true;
+}
+
+void UAISignificanceManager::UnregisterAgent(AAICharacter* Character)
+{
+	const int32* IndexPtr = AgentIndices.Find(Character);
+	if (!IndexPtr)
+	{
+		return;
+	}
+
+	const int32 Index = *IndexPtr;
+	ApplySignificance(Agents[Index], EAiSignificance::High);
+	AgentIndices.Remove(Character);
+
+	Agents.RemoveAtSwap(Index, 1, false);
+	if (Index < Agents.Num())
+	{
+		AgentIndices.Add(Agents[Index].Key, Index);
+	}
+}
+
+void UAISignificanceManager::PromoteAgent(const AAICharacter* Character)
+{
+	if (const int32* Index = AgentIndices.Find(Character))
+	{
+		ApplySignificance(Agents[*Index], EAiSignificance::High);
+	}
+}
+
+EAiSignificance UAISignificanceManager::GetSignificance(const AAICharacter* Character) const
+{
+	const int32* Index = AgentIndices.Find(Character);
+	return Index ? Agents[*Index].Significance : EAiSignificance::High;
+}
+
+void UAISignificanceManager::GetDormancyCandidates(const float MinLowTime, TArray<AAICharacter*>& OutCandidates) const
+{
+	OutCandidates.Reset();
+
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	for (const FAiSignificanceAgent& Agent : Agents)
+	{
+		AAICharacter* Character = Agent.Character.Get();
+		if (Character && Agent.Significance == EAiSignificance::Low && CurrentTime - Agent.LowSinceTime >= MinLowTime)
+		{
+			OutCandidates.Add(Character);
+		}
+	}
+}
+
+void UAISignificanceManager::Tick(float DeltaTime)
+{
+	const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	if (!PlayerController)
+	{
+		return;
+	}
+
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+	const int32 NumUpdates = FMath::Min(Agents.Num(), CVarAiSignificanceUpdatesPerFrame.GetValueOnGameThread());
+	for (int32 Update = 0; Update < NumUpdates; Update++)
+	{
+		NextAgent = NextAgent < Agents.Num() ? NextAgent : 0;
+		FAiSignificanceAgent& Agent = Agents[NextAgent++];
+		if (const AAICharacter* Character = Agent.Character.Get())
+		{
+			ApplySignificance(Agent, EvaluateSignificance(Character, ViewLocation));
+		}
+	}
+}
+
+EAiSignificance UAISignificanceManager::EvaluateSignificance(const AAICharacter* Character, const FVector& ViewLocation) const
+{
+	const float DistanceSquared = FVector::DistSquared(Character->GetActorLocation(), ViewLocation);
+	const ECombatRole CombatRole = Character->GetCombatRole();
+
+	// Anything fighting, or close enough to start fighting, needs to react at full rate
+	if (CombatRole == ECombatRole::Engager || Character->GetTargetActor() ||
+		DistanceSquared <= FMath::Square(CVarAiSignificanceHighDistance.GetValueOnGameThread()))
+	{
+		return EAiSignificance::High;
+	}
+
+	if (CombatRole != ECombatRole::None || Character->GetMesh()->WasRecentlyRendered(0.25f) ||
+		DistanceSquared <= FMath::Square(CVarAiSignificanceMediumDistance.GetValueOnGameThread()))
+	{
+		return EAiSignificance::Medium;
+	}
+
+	return EAiSignificance::Low;
+}
+
+void UAISignificanceManager::ApplySignificance(FAiSignificanceAgent& Agent, const EAiSignificance NewSignificance)
+{
+	AAICharacter* Character = Agent.Character.Get();
+	if (!Character || Agent.Significance == NewSignificance)
+	{
+		return;
+	}
+	Agent.Significance = NewSignificance;
+	if (NewSignificance == EAiSignificance::Low)
+	{
+		Agent.LowSinceTime = GetWorld()->GetTimeSeconds();
+	}
+
+	float TickInterval = 0.0f;
+	switch (NewSignificance)
+	{
+	case EAiSignificance::Medium:
+		TickInterval = CVarAiSignificanceMediumTickInterval.GetValueOnGameThread();
+		break;
+	case EAiSignificance::Low:
+		TickInterval = CVarAiSignificanceLowTickInterval.GetValueOnGameThread();
+		break;
+	default:
+		break;
+	}
+
+	Character->SetActorTickInterval(FMath::Max(Agent.DefaultActorTickInterval, TickInterval));
+
+	if (AController* Controller = Character->GetController())
+	{
+		const float DefaultControllerTickInterval = Controller->GetClass()->GetDefaultObject<AController>()->GetActorTickInterval();
+		Controller->SetActorTickInterval(FMath::Max(DefaultControllerTickInterval, TickInterval));
+	}
+
+	// Movement and animation are only throttled once the AI is out of sight, where the choppiness can't be seen
+	const bool bLow = NewSignificance == EAiSignificance::Low;
+	const float MediumTickInterval = CVarAiSignificanceMediumTickInterval.GetValueOnGameThread();
+	Character->GetCharacterMovement()->SetComponentTickInterval(bLow ? FMath::Max(Agent.DefaultMovementTickInterval, MediumTickInterval) : Agent.DefaultMovementTickInterval);
+
+	USkeletalMeshComponent* Mesh = Character->GetMesh();
+	Mesh->SetComponentTickInterval(bLow ? FMath::Max(Agent.DefaultMeshTickInterval, TickInterval) : Agent.DefaultMeshTickInterval);
+	Mesh->VisibilityBasedAnimTickOption = bLow ? EVisibilityBasedAnimTickOption::OnlyTickMontagesWhenNotRendered : Agent.DefaultAnimTickOption;
+
+	// Less significant AI look for the player less often
+	if (ULineOfSightCache* LineOfSightCache = GetWorld()->GetSubsystem<ULineOfSightCache>())
+	{
+		LineOfSightCache->SetObserverTraceInterval(Character, TickInterval);
+	}
+}
@@ -0,0 +1,213 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/AgentSpatialHash.h"
+#include "GameFramework/Actor.h"
+
+FAgentSpatialHash::FAgentSpatialHash(const float InCellSize)
+{
+	Reset(InCellSize);
+}
+
+void FAgentSpatialHash::Reset(const float InCellSize)
+{
+	Agents.Empty();
+	AgentIndices.Empty();
+	Cells.Empty();
+
+	CellSize = FMath::Max(InCellSize, 1.0f);
+	InvCellSize = 1.0f / CellSize;
+}
+
+void FAgentSpatialHash::Add(AActor* Actor, const EAgentType Type)
+{
+	if (!Actor || AgentIndices.Contains(Actor))
+	{
+		return;
+	}
+
+	const int32 Index = Agents.Num();
+	FSpatialAgent& Agent = Agents.AddDefaulted_GetRef();
+	Agent.Key = Actor;
+	Agent.Actor = Actor;
+	Agent.Location = Actor->GetActorLocation();
+	Agent.Cell = GetCell(Agent.Location);
+	Agent.Type = Type;
+
+	AgentIndices.Add(Actor, Index);
+	Cells.FindOrAdd(Agent.Cell).Add(Index);
+}
+
+void FAgentSpatialHash::Remove(const AActor* Actor)
+{
+	if (const int32* Index = AgentIndices.Find(Actor))
+	{
+		RemoveAt(*Index);
+	}
+}
+
+void FAgentSpatialHash::Update()
+{
+	for (int32 Index = Agents.Num() - 1; Index >= 0; Index--)
+	{
+		FSpatialAgent& Agent = Agents[Index];
+		const AActor* Actor = Agent.Actor.Get();
+		if (!Actor)
+		{
+			RemoveAt(Index);
+			continue;
+		}
+
+		Agent.Location = Actor->GetActorLocation();
+
+		// Most agents stay within their cell from one frame to the next, and only need their location refreshing
+		const FIntPoint NewCell = GetCell(Agent.Location);
+		if (NewCell != Agent.Cell)
+		{
+			FCellAgents& OldCellAgents = Cells.FindChecked(Agent.Cell);
+			OldCellAgents.RemoveSingleSwap(Index, false);
+			if (OldCellAgents.Num() == 0)
+			{
+				Cells.Remove(Agent.Cell);
+			}
+
+			Cells.FindOrAdd(NewCell).Add(Index);
+			Agent.Cell = NewCell;
+		}
+	}
+}
+
+void FAgentSpatialHash::FindInRadius(const FVector& Center, const float Radius, const EAgentType Types,
+                                     TArray<AActor*>& OutActors, const AActor* IgnoreActor) const
+{
+	OutActors.Reset();
+	ForEachInRadius(Center, Radius, Types, [&OutActors, IgnoreActor](AActor* Actor, float)
+	{
+		if (Actor != IgnoreActor)
+		{
+			OutActors.Add(Actor);
+		}
+	});
+}
+
+void FAgentSpatialHash::FindNearest(const FVector& Center, const float MaxRadius, const int32 MaxResults,
+                                    const EAgentType Types, TArray<FNearestAgent>& OutNearest,
+                                    const AActor* IgnoreActor) const
+{
+	OutNearest.Reset();
+	if (MaxResults <= 0 || Agents.Num() == 0)
+	{
+		return;
+	}
+
+	const float MaxRadiusSquared = FMath::Square(MaxRadius);
+	const FIntPoint CenterCell = GetCell(Center);
+	const int32 MaxRing = FMath::CeilToInt(MaxRadius * InvCellSize);
+
+	for (int32 Ring = 0; Ring <= MaxRing; Ring++)
+	{
+		if (Ring == 0)
+		{
+			GatherNearestInCell(CenterCell, Center, MaxRadiusSquared, MaxResults, Types, OutNearest, IgnoreActor);
+		}
+		else
+		{
+			// Walking the square of cells at this ring's distance from the center cell
+			for (int32 Offset = -Ring; Offset <= Ring; Offset++)
+			{
+				GatherNearestInCell(CenterCell + FIntPoint(Offset, -Ring), Center, MaxRadiusSquared, MaxResults, Types, OutNearest, IgnoreActor);
+				GatherNearestInCell(CenterCell + FIntPoint(Offset, Ring), Center, MaxRadiusSquared, MaxResults, Types, OutNearest, IgnoreActor);
+			}
+			for (int32 Offset = -Ring + 1; Offset <= Ring - 1; Offset++)
+			{
+				GatherNearestInCell(CenterCell + FIntPoint(-Ring, Offset), Center, MaxRadiusSquared, MaxResults, Types, OutNearest, IgnoreActor);
+				GatherNearestInCell(CenterCell + FIntPoint(Ring, Offset), Center, MaxRadiusSquared, MaxResults, Types, OutNearest, IgnoreActor);
+			}
+		}
+
+		// Anything in the next ring is at least as far away as the nearest edge of the cells searched so far, so once
+		// that is further than our furthest result, no further ring can improve on the results
+		if (OutNearest.Num() == MaxResults)
+		{
+			const float MinX = (CenterCell.X - Ring) * CellSize;
+			const float MaxX = (CenterCell.X + Ring + 1) * CellSize;
+			const float MinY = (CenterCell.Y - Ring) * CellSize;
+			const float MaxY = (CenterCell.Y + Ring + 1) * CellSize;
+			const float EdgeDistance = FMath::Min(FMath::Min(Center.X - MinX, MaxX - Center.X), FMath::Min(Center.Y - MinY, MaxY - Center.Y));
+			if (FMath::Square(EdgeDistance) >= OutNearest.Last().DistanceSquared)
+			{
+				return;
+			}
+		}
+	}
+}
+
+void FAgentSpatialHash::RemoveAt(const int32 Index)
+{
+	const FSpatialAgent& Agent = Agents[Index];
+	AgentIndices.Remove(Agent.Key);
+
+	FCellAgents& CellAgents = Cells.FindChecked(Agent.Cell);
+	CellAgents.RemoveSingleSwap(Index, false);
+	if (CellAgents.Num() == 0)
+	{
+		Cells.Remove(Agent.Cell);
+	}
+
+	// The last agent takes the removed agent's place, so its cell and index need pointing at its new index
+	const int32 LastIndex = Agents.Num() - 1;
+	if (Index != LastIndex)
+	{
+		const FSpatialAgent& LastAgent = Agents[LastIndex];
+		FCellAgents& LastCellAgents = Cells.FindChecked(LastAgent.Cell);
+		LastCellAgents[LastCellAgents.IndexOfByKey(LastIndex)] = Index;
+		AgentIndices.Add(LastAgent.Key, Index);
+	}
+
+	Agents.RemoveAtSwap(Index, 1, false);
+}
+
+void FAgentSpatialHash::GatherNearestInCell(const FIntPoint& Cell, const FVector& Center, const float MaxRadiusSquared,
+                                            const int32 MaxResults, const EAgentType Types,
+                                            TArray<FNearestAgent>& OutNearest, const AActor* IgnoreActor) const
+{
+	const FCellAgents* CellAgents = Cells.Find(Cell);
+	if (!CellAgents)
+	{
+		return;
+	}
+
+	for (const int32 AgentIndex : *CellAgents)
+	{
+		const FSpatialAgent& Agent = Agents[AgentIndex];
+		if (!EnumHasAnyFlags(Types, Agent.Type) || Agent.Key == IgnoreActor)
+		{
+			continue;
+		}
+
+		const float DistanceSquared = FVector::DistSquared(Center, Agent.Location);
+		AActor* Actor = Agent.Actor.Get();
+		if (DistanceSquared > MaxRadiusSquared || !Actor)
+		{
+			continue;
+		}
+
+		if (OutNearest.Num() == MaxResults && DistanceSquared >= OutNearest.Last().DistanceSquared)
+		{
+			continue;
+		}
+
+		// Keeping the results sorted by distance, dropping the furthest once we have enough
+		int32 InsertIndex = OutNearest.Num();
+		while (InsertIndex > 0 && OutNearest[InsertIndex - 1].DistanceSquared > DistanceSquared)
+		{
+			InsertIndex--;
+		}
+		OutNearest.Insert(FNearestAgent{Actor, DistanceSquared}, InsertIndex);
+
+		if (OutNearest.Num() > MaxResults)
+		{
+			OutNearest.Pop(false);
+		}
+	}
+}
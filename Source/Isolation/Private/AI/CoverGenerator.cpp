@@ -0,0 +1,220 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/CoverGenerator.h"
+#include "AI/CoverSubsystem.h"
+#include "Engine/World.h"
+
+#if WITH_EDITOR
+#include "Async/ParallelFor.h"
+#include "Misc/PackageName.h"
+#include "NavigationSystem.h"
+#include "NavMesh/RecastNavMesh.h"
+#include "UObject/Package.h"
+#endif
+
+// Sets default values
+ACoverGenerator::ACoverGenerator()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+}
+
+void ACoverGenerator::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (CoverAsset)
+	{
+		if (UCoverSubsystem* CoverSubsystem = GetWorld()->GetSubsystem<UCoverSubsystem>())
+		{
+			CoverSubsystem->AddCoverPoints(CoverAsset);
+		}
+	}
+}
+
+#if WITH_EDITOR
+void ACoverGenerator::GenerateCover()
+{
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return;
+	}
+
+	TArray<FVector> SampleLocations;
+	TArray<FVector> SampleNormals;
+	GatherEdgeSamples(SampleLocations, SampleNormals);
+
+	if (SampleLocations.Num() == 0)
+	{
+		UE_LOG(LogProfilingDebugging, Warning, TEXT("No navmesh edges found to generate cover from, make sure the navmesh has been built."));
+		return;
+	}
+
+	// Each sample can provide cover on either side of its edge, so each gets two result slots which the workers fill
+	// without needing to synchronise
+	TArray<FCoverPoint> Results;
+	Results.SetNum(SampleLocations.Num() * 2);
+
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(CoverGeneration), false);
+	const ECollisionChannel TraceChannel = CoverTraceChannel;
+	const FVector CrouchOffset(0.0f, 0.0f, CrouchCoverHeight);
+	const FVector StandOffset(0.0f, 0.0f, StandCoverHeight);
+	const float ProbeDistance = CoverProbeDistance;
+
+	ParallelFor(SampleLocations.Num(), [&](const int32 SampleIndex)
+	{
+		const FVector& Location = SampleLocations[SampleIndex];
+		for (int32 Side = 0; Side < 2; Side++)
+		{
+			const FVector Direction = Side == 0 ? SampleNormals[SampleIndex] : -SampleNormals[SampleIndex];
+			const FVector Probe = Direction * ProbeDistance;
+
+			// Nothing blocking at crouching height means there is no cover on this side at all
+			if (!World->LineTraceTestByChannel(Location + CrouchOffset, Location + CrouchOffset + Probe, TraceChannel, QueryParams))
+			{
+				continue;
+			}
+
+			FCoverPoint& CoverPoint = Results[SampleIndex * 2 + Side];
+			CoverPoint.Location = Location;
+			CoverPoint.SetDirection(Direction);
+			CoverPoint.Type = ECoverType::Crouch;
+
+			if (World->LineTraceTestByChannel(Location + StandOffset, Location + StandOffset + Probe, TraceChannel, QueryParams))
+			{
+				CoverPoint.Type |= ECoverType::Stand;
+			}
+		}
+	});
+
+	Results.RemoveAllSwap([](const FCoverPoint& CoverPoint) { return CoverPoint.Type == ECoverType::None; }, false);
+	RemoveDuplicatePoints(Results);
+
+	if (!CoverAsset)
+	{
+		Modify();
+		CoverAsset = CreateCoverAsset();
+		if (!CoverAsset)
+		{
+			return;
+		}
+	}
+
+	UE_LOG(LogProfilingDebugging, Log, TEXT("Generated %d cover points from %d navmesh edge samples"), Results.Num(), SampleLocations.Num());
+	CoverAsset->SetCoverPoints(MoveTemp(Results));
+
+	UPackage* Package = CoverAsset->GetOutermost();
+	const FString FileName = FPackageName::LongPackageNameToFilename(Package->GetName(), FPackageName::GetAssetPackageExtension());
+	UPackage::SavePackage(Package, CoverAsset, RF_Public | RF_Standalone, *FileName);
+}
+
+void ACoverGenerator::GatherEdgeSamples(TArray<FVector>& OutLocations, TArray<FVector>& OutNormals) const
+{
+#if WITH_RECAST
+	const UNavigationSystemV1* NavigationSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	const ARecastNavMesh* NavMesh = NavigationSystem ? Cast<ARecastNavMesh>(NavigationSystem->GetDefaultNavDataInstance()) : nullptr;
+	if (!NavMesh)
+	{
+		return;
+	}
+
+	// The debug geometry is the only public route to the navmesh's boundary edges, which it returns as pairs of points
+	FRecastDebugGeometry Geometry;
+	Geometry.bGatherNavMeshEdges = true;
+	NavMesh->GetDebugGeometry(Geometry);
+
+	for (int32 Index = 0; Index + 1 < Geometry.NavMeshEdges.Num(); Index += 2)
+	{
+		const FVector& Start = Geometry.NavMeshEdges[Index];
+		const FVector& End = Geometry.NavMeshEdges[Index + 1];
+		const FVector Edge = End - Start;
+		const float Length = Edge.Size2D();
+		if (Length < KINDA_SMALL_NUMBER)
+		{
+			continue;
+		}
+
+		// Which side of the edge is walkable isn't known, so the traces test both sides of this normal
+		const FVector Normal = FVector(-Edge.Y, Edge.X, 0.0f) / Length;
+		const int32 NumSamples = FMath::Max(1, FMath::FloorToInt(Length / SampleSpacing));
+		for (int32 Sample = 0; Sample < NumSamples; Sample++)
+		{
+			OutLocations.Add(Start + Edge * ((Sample + 0.5f) / NumSamples));
+			OutNormals.Add(Normal);
+		}
+	}
+#endif
+}
+
+void ACoverGenerator::RemoveDuplicatePoints(TArray<FCoverPoint>& CoverPoints) const
+{
+	if (MinPointSpacing <= 0.0f)
+	{
+		return;
+	}
+
+	// Bucketing the kept points so that each point is only compared against its close neighbours. Points facing in
+	// different directions are both kept, as they are cover from different threats
+	const float InvCellSize = 1.0f / MinPointSpacing;
+	const float MinSpacingSquared = FMath::Square(MinPointSpacing);
+	TMap<FIntVector, TArray<int32, TInlineAllocator<4>>> KeptPoints;
+	TArray<FCoverPoint> UniquePoints;
+	UniquePoints.Reserve(CoverPoints.Num());
+
+	for (const FCoverPoint& CoverPoint : CoverPoints)
+	{
+		const FIntVector Cell(FMath::FloorToInt(CoverPoint.Location.X * InvCellSize),
+		                      FMath::FloorToInt(CoverPoint.Location.Y * InvCellSize),
+		                      FMath::FloorToInt(CoverPoint.Location.Z * InvCellSize));
+		const FVector Direction = CoverPoint.GetDirection();
+
+		bool bDuplicate = false;
+		for (int32 X = -1; X <= 1 && !bDuplicate; X++)
+		{
+			for (int32 Y = -1; Y <= 1 && !bDuplicate; Y++)
+			{
+				for (int32 Z = -1; Z <= 1 && !bDuplicate; Z++)
+				{
+					if (const auto* Neighbours = KeptPoints.Find(Cell + FIntVector(X, Y, Z)))
+					{
+						for (const int32 Neighbour : *Neighbours)
+						{
+							const FCoverPoint& Other = UniquePoints[Neighbour];
+							if (FVector::DistSquared(CoverPoint.Location, Other.Location) < MinSpacingSquared &&
+								FVector::DotProduct(Direction, Other.GetDirection()) > 0.7f)
+							{
+								bDuplicate = true;
+								break;
+							}
+						}
+					}
+				}
+			}
+		}
+
+		if (!bDuplicate)
+		{
+			KeptPoints.FindOrAdd(Cell).Add(UniquePoints.Add(CoverPoint));
+		}
+	}
+
+	CoverPoints = MoveTemp(UniquePoints);
+}
+
+UCoverPointAsset* ACoverGenerator::CreateCoverAsset() const
+{
+	const FString LevelName = FPackageName::GetShortName(GetLevel()->GetOutermost()->GetName());
+	const FString PackageName = CoverAssetPath / (LevelName + TEXT("_CoverPoints"));
+	if (!FPackageName::IsValidLongPackageName(PackageName))
+	{
+		UE_LOG(LogProfilingDebugging, Error, TEXT("Cannot create cover asset %s, check the cover asset path"), *PackageName);
+		return nullptr;
+	}
+
+	UPackage* Package = CreatePackage(*PackageName);
+	return NewObject<UCoverPointAsset>(Package, FName(*FPackageName::GetShortName(PackageName)), RF_Public | RF_Standalone);
+}
+#endif
@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/CoverPointAsset.h"
+#include "Serialization/MemoryWriter.h"
+
+/** Bumped whenever the layout of FCoverPoint changes, so that stale bakes are discarded rather than misread */
+static constexpr int32 CoverPointAssetVersion = 1;
+
+void UCoverPointAsset::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	// The points are preceded by their format version and size in bytes, so that a stale bake can be skipped over
+	int32 Version = CoverPointAssetVersion;
+	Ar << Version;
+
+	if (Ar.IsLoading())
+	{
+		int64 DataSize = 0;
+		Ar << DataSize;
+
+		if (Version != CoverPointAssetVersion)
+		{
+			UE_LOG(LogProfilingDebugging, Warning, TEXT("%s was baked with an older cover point format, and needs regenerating"), *GetName());
+			Ar.Seek(Ar.Tell() + DataSize);
+			CoverPoints.Empty();
+			NumCoverPoints = 0;
+			return;
+		}
+
+		Ar << CoverPoints;
+	}
+	else if (Ar.IsSaving())
+	{
+		// Writing the points to a buffer first, so that their real size goes ahead of them in any archive, not just the
+		// ones that can seek back to fill it in
+		TArray<uint8> Data;
+		FMemoryWriter Writer(Data, Ar.IsPersistent());
+		Writer.SetByteSwapping(Ar.IsByteSwapping());
+		Writer << CoverPoints;
+
+		int64 DataSize = Data.Num();
+		Ar << DataSize;
+		Ar.Serialize(Data.GetData(), Data.Num());
+	}
+	else
+	{
+		// Archives that neither load nor save, such as those counting memory, only need to visit the points
+		int64 DataSize = 0;
+		Ar << DataSize;
+		Ar << CoverPoints;
+	}
+}
+
+void UCoverPointAsset::SetCoverPoints(TArray<FCoverPoint>&& NewCoverPoints)
+{
+	CoverPoints = MoveTemp(NewCoverPoints);
+	NumCoverPoints = CoverPoints.Num();
+	MarkPackageDirty();
+}
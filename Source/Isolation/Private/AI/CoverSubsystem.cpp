@@ -0,0 +1,169 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/CoverSubsystem.h"
+
+static TAutoConsoleVariable<float> CVarCoverMaxAngle(
+	TEXT("isolation.AI.CoverMaxAngle"),
+	60.0f,
+	TEXT("The largest angle, in degrees, between the direction a cover point protects from and the threat for it to count as cover."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarCoverMinThreatDistance(
+	TEXT("isolation.AI.CoverMinThreatDistance"),
+	300.0f,
+	TEXT("Cover closer than this to the threat is ignored, as the threat could simply walk around it."),
+	ECVF_Default);
+
+void UCoverSubsystem::Deinitialize()
+{
+	CoverPoints.Empty();
+	Claimants.Empty();
+	ClaimedCover.Empty();
+	Cells.Empty();
+
+	Super::Deinitialize();
+}
+
+void UCoverSubsystem::AddCoverPoints(const UCoverPointAsset* CoverAsset)
+{
+	if (!CoverAsset)
+	{
+		return;
+	}
+
+	const TArray<FCoverPoint>& NewCoverPoints = CoverAsset->GetCoverPoints();
+	CoverPoints.Reserve(CoverPoints.Num() + NewCoverPoints.Num());
+	for (const FCoverPoint& CoverPoint : NewCoverPoints)
+	{
+		Cells.FindOrAdd(GetCell(CoverPoint.Location)).Add(CoverPoints.Add(CoverPoint));
+	}
+
+	Claimants.SetNum(CoverPoints.Num());
+}
+
+int32 UCoverSubsystem::FindBestCover(const FVector& ThreatLocation, const FVector& Origin, const float Radius,
+                                     const ECoverType RequiredType, const AActor* Querier) const
+{
+	const float RadiusSquared = FMath::Square(Radius);
+	const float MinFacing = FMath::Cos(FMath::DegreesToRadians(CVarCoverMaxAngle.GetValueOnGameThread()));
+	const float MinThreatDistanceSquared = FMath::Square(CVarCoverMinThreatDistance.GetValueOnGameThread());
+
+	int32 BestIndex = INDEX_NONE;
+	float BestScore = -MAX_FLT;
+
+	const FIntPoint MinCell = GetCell(Origin - FVector(Radius));
+	const FIntPoint MaxCell = GetCell(Origin + FVector(Radius));
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			const TArray<int32>* CellPoints = Cells.Find(FIntPoint(X, Y));
+			if (!CellPoints)
+			{
+				continue;
+			}
+
+			for (const int32 Index : *CellPoints)
+			{
+				const FCoverPoint& CoverPoint = CoverPoints[Index];
+				if (!EnumHasAnyFlags(CoverPoint.Type, RequiredType))
+				{
+					continue;
+				}
+
+				const float DistanceSquared = FVector::DistSquared(Origin, CoverPoint.Location);
+				if (DistanceSquared > RadiusSquared)
+				{
+					continue;
+				}
+
+				const FVector ToThreat = (ThreatLocation - CoverPoint.Location) * FVector(1.0f, 1.0f, 0.0f);
+				if (ToThreat.SizeSquared() < MinThreatDistanceSquared)
+				{
+					continue;
+				}
+
+				// The cover has to be between the point and the threat
+				const float Facing = FVector::DotProduct(CoverPoint.GetDirection(), ToThreat.GetSafeNormal());
+				if (Facing < MinFacing)
+				{
+					continue;
+				}
+
+				const AActor* Claimant = Claimants[Index].Get();
+				if (Claimant && Claimant != Querier)
+				{
+					continue;
+				}
+
+				// Favouring cover that faces the threat squarely, covers a standing AI and is close by
+				const float StandBonus = EnumHasAnyFlags(CoverPoint.Type, ECoverType::Stand) ? 0.5f : 0.0f;
+				const float Score = Facing + StandBonus - FMath::Sqrt(DistanceSquared) / Radius;
+				if (Score > BestScore)
+				{
+					BestScore = Score;
+					BestIndex = Index;
+				}
+			}
+		}
+	}
+
+	return BestIndex;
+}
+
+void UCoverSubsystem::GetCoverPointsInBox(const FBox& Box, TArray<FCoverPoint>& OutCoverPoints) const
+{
+	OutCoverPoints.Reset();
+
+	const FIntPoint MinCell = GetCell(Box.Min);
+	const FIntPoint MaxCell = GetCell(Box.Max);
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			if (const TArray<int32>* CellPoints = Cells.Find(FIntPoint(X, Y)))
+			{
+				for (const int32 Index : *CellPoints)
+				{
+					if (Box.IsInsideOrOn(CoverPoints[Index].Location))
+					{
+						OutCoverPoints.Add(CoverPoints[Index]);
+					}
+				}
+			}
+		}
+	}
+}
+
+bool UCoverSubsystem::ClaimCover(const int32 Index, const AActor* Claimant)
+{
+	if (!Claimants.IsValidIndex(Index) || !Claimant)
+	{
+		return false;
+	}
+
+	const AActor* CurrentClaimant = Claimants[Index].Get();
+	if (CurrentClaimant == Claimant)
+	{
+		return true;
+	}
+	if (CurrentClaimant)
+	{
+		return false;
+	}
+
+	ReleaseCover(Claimant);
+	Claimants[Index] = Claimant;
+	ClaimedCover.Add(Claimant, Index);
+	return true;
+}
+
+void UCoverSubsystem::ReleaseCover(const AActor* Claimant)
+{
+	int32 Index;
+	if (ClaimedCover.RemoveAndCopyValue(Claimant, Index))
+	{
+		Claimants[Index].Reset();
+	}
+}
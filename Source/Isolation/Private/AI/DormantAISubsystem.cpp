@@ -0,0 +1,275 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/DormantAISubsystem.h"
+#include "AI/AICharacter.h"
+#include "AI/AISignificanceManager.h"
+#include "Async/ParallelFor.h"
+#include "Components/HealthComponent.h"
+#include "GameFramework/PlayerController.h"
+
+static TAutoConsoleVariable<int32> CVarDormancyEnabled(
+	TEXT("isolation.AI.Dormancy.Enabled"),
+	1,
+	TEXT("Whether distant idle AI are dehydrated into dormant data."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDormancyHydrateDistance(
+	TEXT("isolation.AI.Dormancy.HydrateDistance"),
+	4500.0f,
+	TEXT("Dormant AI closer than this to the player's view are hydrated back into actors."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDormancyDehydrateDistance(
+	TEXT("isolation.AI.Dormancy.DehydrateDistance"),
+	6000.0f,
+	TEXT("AI further than this from the player's view may be dehydrated. Kept above HydrateDistance so AI don't flicker between the two."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDormancyDehydrateDelay(
+	TEXT("isolation.AI.Dormancy.DehydrateDelay"),
+	5.0f,
+	TEXT("How long, in seconds, an AI has to have been low significance before it may be dehydrated."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarDormancyHydrationsPerFrame(
+	TEXT("isolation.AI.Dormancy.HydrationsPerFrame"),
+	2,
+	TEXT("The most dormant AI hydrated in a single frame."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarDormancyDehydrationsPerCheck(
+	TEXT("isolation.AI.Dormancy.DehydrationsPerCheck"),
+	4,
+	TEXT("The most AI dehydrated each time idle AI are looked for."),
+	ECVF_Default);
+
+/** How often, in seconds, idle AI are looked for to be dehydrated */
+static constexpr float DehydrateCheckInterval = 0.5f;
+
+/** The number of dormant AI checked by each worker in the parallel pass */
+static constexpr int32 HydrationBatchSize = 64;
+
+void FDormantAIPopulation::Add(const FVector& Location, const float Yaw, const int32 ClassIndex, const int32 SquadId,
+                               const int32 LoadoutSeed, const float Health)
+{
+	Locations.Add(Location);
+	Yaws.Add(Yaw);
+	ClassIndices.Add(ClassIndex);
+	SquadIds.Add(SquadId);
+	LoadoutSeeds.Add(LoadoutSeed);
+	Healths.Add(Health);
+	WantsHydration.Add(false);
+}
+
+void FDormantAIPopulation::RemoveAtSwap(const int32 Index)
+{
+	Locations.RemoveAtSwap(Index, 1, false);
+	Yaws.RemoveAtSwap(Index, 1, false);
+	ClassIndices.RemoveAtSwap(Index, 1, false);
+	SquadIds.RemoveAtSwap(Index, 1, false);
+	LoadoutSeeds.RemoveAtSwap(Index, 1, false);
+	Healths.RemoveAtSwap(Index, 1, false);
+	WantsHydration.RemoveAtSwap(Index, 1, false);
+}
+
+void FDormantAIPopulation::Empty()
+{
+	Locations.Empty();
+	Yaws.Empty();
+	ClassIndices.Empty();
+	SquadIds.Empty();
+	LoadoutSeeds.Empty();
+	Healths.Empty();
+	WantsHydration.Empty();
+}
+
+void UDormantAISubsystem::Deinitialize()
+{
+	Population.Empty();
+	DormantClasses.Empty();
+	DehydrationCandidates.Empty();
+
+	Super::Deinitialize();
+}
+
+void UDormantAISubsystem::AddDormantAI(const TSubclassOf<AAICharacter> CharacterClass, const FTransform& Transform,
+                                       const int32 SquadId, const int32 LoadoutSeed, const float Health)
+{
+	if (!CharacterClass)
+	{
+		return;
+	}
+
+	Population.Add(Transform.GetLocation(), Transform.Rotator().Yaw, FindOrAddClass(CharacterClass), SquadId,
+	               LoadoutSeed != 0 ? LoadoutSeed : FMath::RandRange(1, MAX_int32), Health);
+}
+
+bool UDormantAISubsystem::DehydrateAI(AAICharacter* Character)
+{
+	if (!Character || Character->IsPendingKill())
+	{
+		return false;
+	}
+
+	// AI in a fight have to stay as actors, as the rest of their squad is relying on them
+	if (Character->GetCombatRole() != ECombatRole::None || Character->HasKnownTarget())
+	{
+		return false;
+	}
+
+	const UHealthComponent* HealthComponent = Character->FindComponentByClass<UHealthComponent>();
+	const float Health = HealthComponent ? HealthComponent->GetHealth() : 100.0f;
+	if (Health <= 0.0f)
+	{
+		return false;
+	}
+
+	Population.Add(Character->GetActorLocation(), Character->GetActorRotation().Yaw, FindOrAddClass(Character->GetClass()),
+	               Character->GetSquadId(), Character->GetLoadoutSeed(), Health);
+
+	// The weapon goes back to the pool rather than being destroyed with us
+	Character->ReleaseWeapon();
+
+	AController* Controller = Character->GetController();
+	Character->Destroy();
+	if (Controller)
+	{
+		Controller->Destroy();
+	}
+
+	return true;
+}
+
+void UDormantAISubsystem::Tick(float DeltaTime)
+{
+	if (!CVarDormancyEnabled.GetValueOnGameThread())
+	{
+		return;
+	}
+
+	const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	if (!PlayerController)
+	{
+		return;
+	}
+
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+	const int32 NumDormant = Population.Num();
+	if (NumDormant > 0)
+	{
+		// Checking the whole population in batches across the workers, as only the flags are written
+		const float HydrateDistanceSquared = FMath::Square(CVarDormancyHydrateDistance.GetValueOnGameThread());
+		const int32 NumBatches = FMath::DivideAndRoundUp(NumDormant, HydrationBatchSize);
+		ParallelFor(NumBatches, [this, &ViewLocation, HydrateDistanceSquared, NumDormant](const int32 Batch)
+		{
+			const int32 End = FMath::Min((Batch + 1) * HydrationBatchSize, NumDormant);
+			for (int32 Index = Batch * HydrationBatchSize; Index < End; Index++)
+			{
+				Population.WantsHydration[Index] = FVector::DistSquared(Population.Locations[Index], ViewLocation) <= HydrateDistanceSquared;
+			}
+		});
+
+		// Walking backwards, so removing a hydrated AI only swaps in one that has already been looked at
+		int32 HydrationsLeft = CVarDormancyHydrationsPerFrame.GetValueOnGameThread();
+		for (int32 Index = NumDormant - 1; Index >= 0 && HydrationsLeft > 0; Index--)
+		{
+			if (Population.WantsHydration[Index])
+			{
+				HydrateAI(Index);
+				HydrationsLeft--;
+			}
+		}
+	}
+
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	if (CurrentTime - LastDehydrateCheckTime >= DehydrateCheckInterval)
+	{
+		LastDehydrateCheckTime = CurrentTime;
+		DehydrateIdleAI(ViewLocation);
+	}
+}
+
+bool UDormantAISubsystem::IsTickable() const
+{
+	if (Population.Num() > 0)
+	{
+		return true;
+	}
+
+	// Awake AI are registered with the significance manager, which is what tells us they have been idle long enough
+	const UWorld* World = GetWorld();
+	const UAISignificanceManager* SignificanceManager = World ? World->GetSubsystem<UAISignificanceManager>() : nullptr;
+	return SignificanceManager && SignificanceManager->GetNumAgents() > 0;
+}
+
+AAICharacter* UDormantAISubsystem::HydrateAI(const int32 Index)
+{
+	UClass* CharacterClass = DormantClasses[Population.ClassIndices[Index]];
+	const FTransform Transform(FRotator(0.0f, Population.Yaws[Index], 0.0f), Population.Locations[Index]);
+	const int32 SquadId = Population.SquadIds[Index];
+	const int32 LoadoutSeed = Population.LoadoutSeeds[Index];
+	const float Health = Population.Healths[Index];
+	Population.RemoveAtSwap(Index);
+
+	// Spawning deferred, so that the squad and loadout are in place before BeginPlay registers us and draws the weapon
+	AAICharacter* Character = GetWorld()->SpawnActorDeferred<AAICharacter>(CharacterClass, Transform, nullptr, nullptr,
+	                                                                        ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn);
+	if (!Character)
+	{
+		UE_LOG(LogProfilingDebugging, Warning, TEXT("Failed to hydrate a dormant %s"), *GetNameSafe(CharacterClass));
+		return nullptr;
+	}
+
+	Character->SetSquadId(SquadId);
+	Character->SetLoadoutSeed(LoadoutSeed);
+	Character->FinishSpawning(Transform);
+
+	if (!Character->GetController())
+	{
+		Character->SpawnDefaultController();
+	}
+
+	if (UHealthComponent* HealthComponent = Character->FindComponentByClass<UHealthComponent>())
+	{
+		HealthComponent->SetHealth(Health);
+	}
+
+	return Character;
+}
+
+void UDormantAISubsystem::DehydrateIdleAI(const FVector& ViewLocation)
+{
+	const UAISignificanceManager* SignificanceManager = GetWorld()->GetSubsystem<UAISignificanceManager>();
+	if (!SignificanceManager)
+	{
+		return;
+	}
+
+	SignificanceManager->GetDormancyCandidates(CVarDormancyDehydrateDelay.GetValueOnGameThread(), DehydrationCandidates);
+
+	const float DehydrateDistanceSquared = FMath::Square(CVarDormancyDehydrateDistance.GetValueOnGameThread());
+	int32 DehydrationsLeft = CVarDormancyDehydrationsPerCheck.GetValueOnGameThread();
+	for (AAICharacter* Character : DehydrationCandidates)
+	{
+		if (DehydrationsLeft <= 0)
+		{
+			break;
+		}
+
+		if (FVector::DistSquared(Character->GetActorLocation(), ViewLocation) > DehydrateDistanceSquared && DehydrateAI(Character))
+		{
+			DehydrationsLeft--;
+		}
+	}
+
+	DehydrationCandidates.Reset();
+}
+
+int32 UDormantAISubsystem::FindOrAddClass(UClass* CharacterClass)
+{
+	return DormantClasses.AddUnique(CharacterClass);
+}
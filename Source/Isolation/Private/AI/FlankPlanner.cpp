@@ -0,0 +1,348 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/FlankPlanner.h"
+#include "AI/AICharacter.h"
+#include "AI/AIManager.h"
+#include "AI/CoverSubsystem.h"
+#include "Async/Async.h"
+#include "NavigationSystem.h"
+
+static TAutoConsoleVariable<int32> CVarFlankQueriesPerFrame(
+	TEXT("isolation.AI.FlankQueriesPerFrame"),
+	4,
+	TEXT("The maximum number of flank path queries submitted to the navigation system in a single frame."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarFlankCacheCellSize(
+	TEXT("isolation.AI.FlankCacheCellSize"),
+	400.0f,
+	TEXT("The size of the cells flank path ratings are cached by. Paths starting, ending and targeting the same cells share a rating."),
+	ECVF_Default);
+
+/** The angles, either side of the line from the target to the AI, at which flank goals are proposed */
+static const float FlankGoalAngles[] = { -110.0f, -70.0f, 70.0f, 110.0f };
+
+/** The distance, along the path, between the samples used to rate it */
+static constexpr float FlankRatingSampleSpacing = 100.0f;
+
+/** How close cover has to be to the path to count as cover along it */
+static constexpr float FlankCoverRadius = 150.0f;
+
+/** Beyond this distance from the target, the path is no longer considered exposed */
+static constexpr float FlankExposureRange = 3000.0f;
+
+void UFlankPlanner::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	PathFoundDelegate.BindUObject(this, &UFlankPlanner::HandlePathFound);
+}
+
+void UFlankPlanner::Deinitialize()
+{
+	// FindPathAsync copies the delegate into each query, so queries still in flight will call back regardless. The weak
+	// binding drops those callbacks once we have been collected, and until then their IDs are no longer in InFlightQueries
+	PathFoundDelegate.Unbind();
+
+	if (UNavigationSystemV1* NavigationSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+	{
+		NavigationSystem->OnNavigationGenerationFinishedDelegate.RemoveDynamic(this, &UFlankPlanner::HandleNavigationGenerated);
+	}
+
+	Requests.Empty();
+	QueuedQueries.Empty();
+	InFlightQueries.Empty();
+	PathsToRate.Empty();
+	PendingPaths.Empty();
+	Ratings.Empty();
+	LastRequestTimes.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UFlankPlanner::RequestFlank(AAICharacter* Character, const AActor* Target, FFlankPlannedDelegate OnPlanned)
+{
+	UWorld* World = GetWorld();
+	UNavigationSystemV1* NavigationSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+	const UAIManager* AIManager = World->GetSubsystem<UAIManager>();
+	if (!Character || !Target || !NavigationSystem || !AIManager)
+	{
+		return false;
+	}
+
+	const float CurrentTime = World->GetTimeSeconds();
+	const float* LastRequestTime = LastRequestTimes.Find(Character);
+	if (LastRequestTime && CurrentTime - *LastRequestTime < AIManager->GetGlobalCombatParameters().WaitToFlankTime)
+	{
+		return false;
+	}
+	LastRequestTimes.Add(Character, CurrentTime);
+
+	// The navmesh may not exist when we are initialised, so we start listening for rebuilds on the first request
+	if (!bBoundToNavigation)
+	{
+		NavigationSystem->OnNavigationGenerationFinishedDelegate.AddDynamic(this, &UFlankPlanner::HandleNavigationGenerated);
+		bBoundToNavigation = true;
+	}
+
+	Requests.RemoveAll([Character](const FFlankRequest& Request) { return Request.Character == Character; });
+
+	FFlankRequest& Request = Requests.AddDefaulted_GetRef();
+	Request.Character = Character;
+	Request.OnPlanned = MoveTemp(OnPlanned);
+
+	const FVector Start = Character->GetActorLocation();
+	const FVector TargetLocation = Target->GetActorLocation();
+	const FVector TargetForward = Target->GetActorForwardVector();
+	const FVector FromTarget = (Start - TargetLocation) * FVector(1.0f, 1.0f, 0.0f);
+	const float FlankDistance = FMath::Clamp(FromTarget.Size(), 500.0f, 1500.0f);
+	const FVector FlankDirection = FromTarget.GetSafeNormal();
+
+	for (const float Angle : FlankGoalAngles)
+	{
+		FNavLocation Goal;
+		const FVector ProposedGoal = TargetLocation + FlankDirection.RotateAngleAxis(Angle, FVector::UpVector) * FlankDistance;
+		if (!NavigationSystem->ProjectPointToNavigation(ProposedGoal, Goal))
+		{
+			continue;
+		}
+
+		FFlankCandidate& Candidate = Request.Candidates.AddDefaulted_GetRef();
+		Candidate.Goal = Goal.Location;
+		Candidate.Key.StartCell = GetCell(Start);
+		Candidate.Key.GoalCell = GetCell(Goal.Location);
+		Candidate.Key.TargetCell = GetCell(TargetLocation);
+
+		// Paths already rated, or on their way to being rated, are shared rather than queried again
+		if (const float* CachedRating = Ratings.Find(Candidate.Key))
+		{
+			Candidate.Rating = *CachedRating;
+		}
+		else if (!PendingPaths.Contains(Candidate.Key))
+		{
+			PendingPaths.Add(Candidate.Key);
+
+			FFlankPathQuery& Query = QueuedQueries.AddDefaulted_GetRef();
+			Query.Key = Candidate.Key;
+			Query.Start = Start;
+			Query.Goal = Goal.Location;
+			Query.TargetLocation = TargetLocation;
+			Query.TargetForward = TargetForward;
+			Query.NavGeneration = NavGeneration;
+		}
+	}
+
+	CompleteRequests();
+	return true;
+}
+
+void UFlankPlanner::Tick(float DeltaTime)
+{
+	UWorld* World = GetWorld();
+	UNavigationSystemV1* NavigationSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+	const ANavigationData* NavData = NavigationSystem ? NavigationSystem->GetDefaultNavDataInstance() : nullptr;
+
+	// Submitting this frame's batch of path queries
+	const int32 NumQueries = NavData ? FMath::Min(QueuedQueries.Num(), CVarFlankQueriesPerFrame.GetValueOnGameThread()) : 0;
+	for (int32 Index = 0; Index < NumQueries; Index++)
+	{
+		const FFlankPathQuery& Query = QueuedQueries[Index];
+		FPathFindingQuery PathQuery(this, *NavData, Query.Start, Query.Goal);
+		const uint32 QueryId = NavigationSystem->FindPathAsync(NavData->GetConfig(), PathQuery, PathFoundDelegate, EPathFindingMode::Regular);
+		InFlightQueries.Add(QueryId, Query);
+	}
+	QueuedQueries.RemoveAt(0, NumQueries, false);
+
+	// Rating every path found since last frame in a single worker task, which reports back to the game thread
+	if (PathsToRate.Num() > 0)
+	{
+		TWeakObjectPtr<UFlankPlanner> WeakThis(this);
+		AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [WeakThis, Paths = MoveTemp(PathsToRate)]() mutable
+		{
+			TArray<float> PathRatings;
+			PathRatings.Reserve(Paths.Num());
+			for (const FFlankPathToRate& Path : Paths)
+			{
+				PathRatings.Add(RateFlankPath(Path));
+			}
+
+			AsyncTask(ENamedThreads::GameThread, [WeakThis, Paths = MoveTemp(Paths), PathRatings = MoveTemp(PathRatings)]()
+			{
+				if (UFlankPlanner* FlankPlanner = WeakThis.Get())
+				{
+					for (int32 Index = 0; Index < Paths.Num(); Index++)
+					{
+						FlankPlanner->StoreRating(Paths[Index].Query.Key, PathRatings[Index], Paths[Index].Query.NavGeneration);
+					}
+				}
+			});
+		});
+		PathsToRate.Reset();
+	}
+
+	// Dropping requests from AI that have gone
+	Requests.RemoveAll([](const FFlankRequest& Request) { return !Request.Character.IsValid(); });
+}
+
+FIntVector UFlankPlanner::GetCell(const FVector& Location) const
+{
+	const float CellSize = FMath::Max(CVarFlankCacheCellSize.GetValueOnGameThread(), 1.0f);
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize),
+	                  FMath::FloorToInt(Location.Z / CellSize));
+}
+
+void UFlankPlanner::HandlePathFound(const uint32 QueryId, const ENavigationQueryResult::Type Result, FNavPathSharedPtr Path)
+{
+	FFlankPathQuery Query;
+	if (!InFlightQueries.RemoveAndCopyValue(QueryId, Query))
+	{
+		return;
+	}
+
+	// Failed queries are rated straight away, as there is nothing to rate
+	if (Result != ENavigationQueryResult::Success || !Path.IsValid() || Path->IsPartial())
+	{
+		StoreRating(Query.Key, -1.0f, Query.NavGeneration);
+		return;
+	}
+
+	FFlankPathToRate& PathToRate = PathsToRate.AddDefaulted_GetRef();
+	PathToRate.Query = Query;
+
+	FBox PathBounds(ForceInit);
+	for (const FNavPathPoint& PathPoint : Path->GetPathPoints())
+	{
+		PathToRate.PathPoints.Add(PathPoint.Location);
+		PathBounds += PathPoint.Location;
+	}
+
+	if (const UCoverSubsystem* CoverSubsystem = GetWorld()->GetSubsystem<UCoverSubsystem>())
+	{
+		CoverSubsystem->GetCoverPointsInBox(PathBounds.ExpandBy(FlankCoverRadius), PathToRate.NearbyCover);
+	}
+}
+
+float UFlankPlanner::RateFlankPath(const FFlankPathToRate& Path)
+{
+	const TArray<FVector>& Points = Path.PathPoints;
+	if (Points.Num() < 2)
+	{
+		return 0.0f;
+	}
+
+	const FVector& TargetLocation = Path.Query.TargetLocation;
+	const FVector& TargetForward = Path.Query.TargetForward;
+	const float CoverRadiusSquared = FMath::Square(FlankCoverRadius);
+
+	float PathLength = 0.0f;
+	float TotalExposure = 0.0f;
+	int32 NumCovered = 0;
+	int32 NumSamples = 0;
+
+	for (int32 Index = 1; Index < Points.Num(); Index++)
+	{
+		const FVector Segment = Points[Index] - Points[Index - 1];
+		const float SegmentLength = Segment.Size();
+		PathLength += SegmentLength;
+
+		const int32 SegmentSamples = FMath::Max(1, FMath::CeilToInt(SegmentLength / FlankRatingSampleSpacing));
+		for (int32 Sample = 0; Sample < SegmentSamples; Sample++)
+		{
+			const FVector Location = Points[Index - 1] + Segment * (static_cast<float>(Sample) / SegmentSamples);
+			const FVector ToSample = Location - TargetLocation;
+			const float Distance = ToSample.Size();
+			NumSamples++;
+
+			// Being close to the target and in front of them is the most exposed a flank can be
+			const float Facing = FMath::Max(0.0f, FVector::DotProduct(TargetForward, ToSample / FMath::Max(Distance, 1.0f)));
+			const float Proximity = 1.0f - FMath::Min(Distance / FlankExposureRange, 1.0f);
+
+			// Cover facing the target shields that part of the path
+			const FVector ToTarget = (-ToSample).GetSafeNormal2D();
+			const bool bCovered = Path.NearbyCover.ContainsByPredicate([&Location, &ToTarget, CoverRadiusSquared](const FCoverPoint& CoverPoint)
+			{
+				return FVector::DistSquared(CoverPoint.Location, Location) <= CoverRadiusSquared &&
+					FVector::DotProduct(CoverPoint.GetDirection(), ToTarget) > 0.5f;
+			});
+
+			if (bCovered)
+			{
+				NumCovered++;
+			}
+			else
+			{
+				TotalExposure += Facing * Proximity;
+			}
+		}
+	}
+
+	const float Exposure = TotalExposure / NumSamples;
+	const float CoverFraction = static_cast<float>(NumCovered) / NumSamples;
+	const float Directness = PathLength > 0.0f ? FVector::Dist(Points[0], Points.Last()) / PathLength : 1.0f;
+
+	return 0.4f * (1.0f - Exposure) + 0.3f * CoverFraction + 0.3f * Directness;
+}
+
+void UFlankPlanner::StoreRating(const FFlankPathKey& Key, const float Rating, const int32 RatingNavGeneration)
+{
+	PendingPaths.Remove(Key);
+
+	// Ratings made against an old navmesh still answer the requests waiting on them, but aren't kept
+	if (RatingNavGeneration == NavGeneration)
+	{
+		Ratings.Add(Key, Rating);
+	}
+
+	for (FFlankRequest& Request : Requests)
+	{
+		for (FFlankCandidate& Candidate : Request.Candidates)
+		{
+			if (Candidate.Key == Key && !Candidate.Rating.IsSet())
+			{
+				Candidate.Rating = Rating;
+			}
+		}
+	}
+
+	CompleteRequests();
+}
+
+void UFlankPlanner::CompleteRequests()
+{
+	const UAIManager* AIManager = GetWorld()->GetSubsystem<UAIManager>();
+	const float MinRating = AIManager ? AIManager->GetGlobalCombatParameters().MinFlankPathRating : 0.0f;
+
+	for (int32 Index = Requests.Num() - 1; Index >= 0; Index--)
+	{
+		const FFlankRequest& Request = Requests[Index];
+		if (Request.Candidates.ContainsByPredicate([](const FFlankCandidate& Candidate) { return !Candidate.Rating.IsSet(); }))
+		{
+			continue;
+		}
+
+		const FFlankCandidate* BestCandidate = nullptr;
+		for (const FFlankCandidate& Candidate : Request.Candidates)
+		{
+			if (Candidate.Rating.GetValue() >= MinRating && (!BestCandidate || Candidate.Rating.GetValue() > BestCandidate->Rating.GetValue()))
+			{
+				BestCandidate = &Candidate;
+			}
+		}
+
+		// The request is removed before its delegate runs, as the delegate may well request another flank
+		const FFlankPlannedDelegate OnPlanned = Request.OnPlanned;
+		const FVector FlankLocation = BestCandidate ? BestCandidate->Goal : FVector::ZeroVector;
+		const bool bFound = BestCandidate != nullptr && Request.Character.IsValid();
+		Requests.RemoveAt(Index, 1, false);
+
+		OnPlanned.ExecuteIfBound(bFound, FlankLocation);
+		Index = FMath::Min(Index, Requests.Num());
+	}
+}
+
+void UFlankPlanner::HandleNavigationGenerated(ANavigationData* NavData)
+{
+	NavGeneration++;
+	Ratings.Empty();
+}
@@ -0,0 +1,164 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/HearingSubsystem.h"
+#include "AI/AICharacterController.h"
+#include "AI/AIManager.h"
+#include "AI/InfluenceMapSubsystem.h"
+
+static TAutoConsoleVariable<int32> CVarHearingBufferSize(
+	TEXT("isolation.AI.Hearing.BufferSize"),
+	256,
+	TEXT("The most noises that can be waiting to be routed to AI at once. Takes effect when the next level loads."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarHearingGunshotRadius(
+	TEXT("isolation.AI.Hearing.GunshotRadius"),
+	4000.0f,
+	TEXT("The distance an unsilenced gunshot can be heard from."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarHearingImpactRadius(
+	TEXT("isolation.AI.Hearing.ImpactRadius"),
+	1000.0f,
+	TEXT("The distance a bullet impact can be heard from."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarHearingFootstepRadius(
+	TEXT("isolation.AI.Hearing.FootstepRadius"),
+	500.0f,
+	TEXT("The distance a footstep can be heard from."),
+	ECVF_Default);
+
+void UHearingSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	NoiseBuffer.SetNum(FMath::Max(CVarHearingBufferSize.GetValueOnGameThread(), 1));
+}
+
+void UHearingSubsystem::Deinitialize()
+{
+	NoiseBuffer.Empty();
+	FirstPendingNoise = 0;
+	NumPendingNoises = 0;
+	HeardNoises.Empty();
+	HeardNoiseIndices.Empty();
+
+	Super::Deinitialize();
+}
+
+void UHearingSubsystem::PostNoise(const ENoiseType Type, const FVector& Location, AActor* Instigator,
+                                  const float LoudnessScale)
+{
+	const float Radius = GetNoiseRadius(Type) * LoudnessScale;
+	if (Radius <= 0.0f || NoiseBuffer.Num() == 0)
+	{
+		return;
+	}
+
+	// Overwriting the oldest noise once the buffer is full, as a burst of newer noises says more about the fight
+	const int32 BufferSize = NoiseBuffer.Num();
+	if (NumPendingNoises == BufferSize)
+	{
+		FirstPendingNoise = (FirstPendingNoise + 1) % BufferSize;
+		NumPendingNoises--;
+	}
+
+	FNoiseEvent& Noise = NoiseBuffer[(FirstPendingNoise + NumPendingNoises) % BufferSize];
+	Noise.Location = Location;
+	Noise.Radius = Radius;
+	Noise.Type = Type;
+	Noise.Instigator = Instigator;
+	NumPendingNoises++;
+}
+
+void UHearingSubsystem::Tick(float DeltaTime)
+{
+	const UAIManager* AIManager = GetWorld()->GetSubsystem<UAIManager>();
+	if (!AIManager)
+	{
+		NumPendingNoises = 0;
+		return;
+	}
+
+	UInfluenceMapSubsystem* InfluenceMap = GetWorld()->GetSubsystem<UInfluenceMapSubsystem>();
+
+	// Finding the loudest noise each AI heard, visiting only the AI in the cells each noise reaches
+	const int32 BufferSize = NoiseBuffer.Num();
+	for (int32 Pending = 0; Pending < NumPendingNoises; Pending++)
+	{
+		const int32 NoiseIndex = (FirstPendingNoise + Pending) % BufferSize;
+		const FNoiseEvent& Noise = NoiseBuffer[NoiseIndex];
+		const AActor* Instigator = Noise.Instigator.Get();
+
+		// Shots also mark the influence map, so that AI can tell where fighting has been without having heard it
+		if (InfluenceMap && Noise.Type == ENoiseType::Gunshot)
+		{
+			InfluenceMap->AddGunfire(Noise.Location);
+		}
+
+		AIManager->GetSpatialHash().ForEachInRadius(Noise.Location, Noise.Radius, EAgentType::AI,
+			[this, &Noise, Instigator, NoiseIndex](AActor* Agent, const float DistanceSquared)
+			{
+				const APawn* Pawn = Cast<APawn>(Agent);
+				AAICharacterController* Listener = Pawn ? Cast<AAICharacterController>(Pawn->GetController()) : nullptr;
+				if (!Listener || Agent == Instigator)
+				{
+					return;
+				}
+
+				// AI don't react to the noises their own side makes
+				if (Instigator && Listener->GetTeamAttitudeTowards(*Instigator) == ETeamAttitude::Friendly)
+				{
+					return;
+				}
+
+				const float Strength = 1.0f - FMath::Sqrt(DistanceSquared) / Noise.Radius;
+				if (const int32* HeardIndex = HeardNoiseIndices.Find(Listener))
+				{
+					FHeardNoise& HeardNoise = HeardNoises[*HeardIndex];
+					if (Strength > HeardNoise.Strength)
+					{
+						HeardNoise.NoiseIndex = NoiseIndex;
+						HeardNoise.Strength = Strength;
+					}
+					return;
+				}
+
+				HeardNoiseIndices.Add(Listener, HeardNoises.Num());
+				FHeardNoise& HeardNoise = HeardNoises.AddDefaulted_GetRef();
+				HeardNoise.Listener = Listener;
+				HeardNoise.NoiseIndex = NoiseIndex;
+				HeardNoise.Strength = Strength;
+			});
+	}
+
+	for (const FHeardNoise& HeardNoise : HeardNoises)
+	{
+		if (AAICharacterController* Listener = HeardNoise.Listener.Get())
+		{
+			Listener->HearNoise(NoiseBuffer[HeardNoise.NoiseIndex], HeardNoise.Strength);
+		}
+	}
+
+	FirstPendingNoise = 0;
+	NumPendingNoises = 0;
+	HeardNoises.Reset();
+	HeardNoiseIndices.Reset();
+}
+
+float UHearingSubsystem::GetNoiseRadius(const ENoiseType Type)
+{
+	switch (Type)
+	{
+	case ENoiseType::Gunshot:
+		return CVarHearingGunshotRadius.GetValueOnGameThread();
+	case ENoiseType::Impact:
+		return CVarHearingImpactRadius.GetValueOnGameThread();
+	case ENoiseType::Footstep:
+		return CVarHearingFootstepRadius.GetValueOnGameThread();
+	default:
+		return 0.0f;
+	}
+}
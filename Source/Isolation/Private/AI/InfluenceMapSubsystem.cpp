@@ -0,0 +1,360 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/InfluenceMapSubsystem.h"
+#include "AI/AIManager.h"
+#include "Async/Async.h"
+#include "NavigationSystem.h"
+
+static TAutoConsoleVariable<int32> CVarInfluenceMapEnabled(
+	TEXT("isolation.AI.InfluenceMap.Enabled"),
+	1,
+	TEXT("Whether the AI influence map is updated."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarInfluenceMapCellSize(
+	TEXT("isolation.AI.InfluenceMap.CellSize"),
+	200.0f,
+	TEXT("The width of each influence map cell. Takes effect when the next level loads."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarInfluenceMapUpdateInterval(
+	TEXT("isolation.AI.InfluenceMap.UpdateInterval"),
+	0.1f,
+	TEXT("How often, in seconds, the influence map is updated."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarInfluenceMapThreatRadius(
+	TEXT("isolation.AI.InfluenceMap.ThreatRadius"),
+	1500.0f,
+	TEXT("The distance around each player stamped into the threat layer."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarInfluenceMapGunfireRadius(
+	TEXT("isolation.AI.InfluenceMap.GunfireRadius"),
+	800.0f,
+	TEXT("The distance around each shot stamped into the gunfire layer."),
+	ECVF_Default);
+
+/** The distance around each AI stamped into the occupancy layer */
+static constexpr float OccupancyRadius = 200.0f;
+
+/** The most cells along each side of the grid, so that huge levels get coarser cells rather than huge grids */
+static constexpr int32 MaxInfluenceMapSize = 512;
+
+/** The time, in seconds, between attempts to size the grid while the navigation system has no bounds */
+static constexpr float GridRetryInterval = 5.0f;
+
+/** How each layer changes between updates */
+struct FInfluenceLayerSettings
+{
+	/** The time for the layer's influence to halve */
+	float HalfLife;
+
+	/** How much of each cell's influence is replaced by its neighbours' each update, from 0 to 1 */
+	float Spread;
+};
+
+/** Threat spreads to where the players could move to, gunfire lingers and occupancy is only ever where the AI are */
+static constexpr FInfluenceLayerSettings InfluenceLayerSettings[NumInfluenceLayers] =
+{
+	{ 2.0f, 0.5f },
+	{ 4.0f, 0.2f },
+	{ 0.1f, 0.0f }
+};
+
+void UInfluenceMapSubsystem::Deinitialize()
+{
+	// A worker still writing the grids keeps them alive through its own reference
+	Buffers.Reset();
+	PendingGunfire.Empty();
+	Width = 0;
+	Height = 0;
+
+	Super::Deinitialize();
+}
+
+void UInfluenceMapSubsystem::AddGunfire(const FVector& Location)
+{
+	if (Width > 0)
+	{
+		PendingGunfire.Add(Location);
+	}
+}
+
+float UInfluenceMapSubsystem::GetInfluence(const EInfluenceLayer Layer, const FVector& Location) const
+{
+	if (Width == 0 || Layer == EInfluenceLayer::Count)
+	{
+		return 0.0f;
+	}
+
+	const FVector2D Cell = GetCellCoordinates(Location);
+	const int32 X = FMath::FloorToInt(Cell.X);
+	const int32 Y = FMath::FloorToInt(Cell.Y);
+	if (X < 0 || Y < 0 || X >= Width || Y >= Height)
+	{
+		return 0.0f;
+	}
+
+	return Buffers->Layers[Buffers->ReadIndex][static_cast<int32>(Layer)][Y * Width + X];
+}
+
+bool UInfluenceMapSubsystem::FindLowestInfluence(const EInfluenceLayer Layer, const FVector& Center, const float Radius,
+                                                 FVector& OutLocation) const
+{
+	if (Width == 0 || Layer == EInfluenceLayer::Count)
+	{
+		return false;
+	}
+
+	const TArray<float>& Values = Buffers->Layers[Buffers->ReadIndex][static_cast<int32>(Layer)];
+	const FVector2D CenterCell = GetCellCoordinates(Center);
+	const float RadiusCells = Radius / CellSize;
+	const float RadiusCellsSquared = FMath::Square(RadiusCells);
+
+	const int32 MinX = FMath::Max(FMath::FloorToInt(CenterCell.X - RadiusCells), 0);
+	const int32 MaxX = FMath::Min(FMath::FloorToInt(CenterCell.X + RadiusCells), Width - 1);
+	const int32 MinY = FMath::Max(FMath::FloorToInt(CenterCell.Y - RadiusCells), 0);
+	const int32 MaxY = FMath::Min(FMath::FloorToInt(CenterCell.Y + RadiusCells), Height - 1);
+
+	int32 BestX = INDEX_NONE;
+	int32 BestY = INDEX_NONE;
+	float BestValue = MAX_FLT;
+	for (int32 Y = MinY; Y <= MaxY; Y++)
+	{
+		for (int32 X = MinX; X <= MaxX; X++)
+		{
+			const float Value = Values[Y * Width + X];
+			if (Value < BestValue && FVector2D::DistSquared(FVector2D(X + 0.5f, Y + 0.5f), CenterCell) <= RadiusCellsSquared)
+			{
+				BestValue = Value;
+				BestX = X;
+				BestY = Y;
+			}
+		}
+	}
+
+	if (BestX == INDEX_NONE)
+	{
+		return false;
+	}
+
+	OutLocation = FVector(Origin.X + (BestX + 0.5f) * CellSize, Origin.Y + (BestY + 0.5f) * CellSize, Center.Z);
+	return true;
+}
+
+void UInfluenceMapSubsystem::Tick(float DeltaTime)
+{
+	if (!CVarInfluenceMapEnabled.GetValueOnGameThread())
+	{
+		return;
+	}
+
+	// Navigation bounds can arrive with a streamed level, so we keep trying to size the grid, just not every frame
+	if (Width == 0)
+	{
+		const float CurrentTime = GetWorld()->GetTimeSeconds();
+		if (CurrentTime < NextGridAttemptTime)
+		{
+			return;
+		}
+
+		if (!InitialiseGrid())
+		{
+			NextGridAttemptTime = CurrentTime + GridRetryInterval;
+			return;
+		}
+	}
+
+	// Publishing the update the worker has finished, which readers pick up from here on
+	if (bUpdateStarted && !Buffers->bUpdateInFlight)
+	{
+		Buffers->ReadIndex = 1 - Buffers->ReadIndex;
+		bUpdateStarted = false;
+	}
+
+	TimeSinceUpdate += DeltaTime;
+	if (bUpdateStarted || TimeSinceUpdate < CVarInfluenceMapUpdateInterval.GetValueOnGameThread())
+	{
+		return;
+	}
+
+	// Gathering the stamps on the game thread, as the worker can't touch actors
+	TArray<FInfluenceStamp> Stamps;
+	if (const UAIManager* AIManager = GetWorld()->GetSubsystem<UAIManager>())
+	{
+		const float ThreatRadius = CVarInfluenceMapThreatRadius.GetValueOnGameThread() / CellSize;
+		const TArray<FSpatialAgent>& Agents = AIManager->GetSpatialHash().GetAgents();
+		Stamps.Reserve(Agents.Num() + PendingGunfire.Num());
+		for (const FSpatialAgent& Agent : Agents)
+		{
+			FInfluenceStamp& Stamp = Stamps.AddDefaulted_GetRef();
+			Stamp.Cell = GetCellCoordinates(Agent.Location);
+			if (Agent.Type == EAgentType::Player)
+			{
+				Stamp.Layer = EInfluenceLayer::Threat;
+				Stamp.Radius = ThreatRadius;
+			}
+			else
+			{
+				Stamp.Layer = EInfluenceLayer::Occupancy;
+				Stamp.Radius = OccupancyRadius / CellSize;
+			}
+		}
+	}
+
+	const float GunfireRadius = CVarInfluenceMapGunfireRadius.GetValueOnGameThread() / CellSize;
+	for (const FVector& Location : PendingGunfire)
+	{
+		FInfluenceStamp& Stamp = Stamps.AddDefaulted_GetRef();
+		Stamp.Layer = EInfluenceLayer::Gunfire;
+		Stamp.Cell = GetCellCoordinates(Location);
+		Stamp.Radius = GunfireRadius;
+	}
+	PendingGunfire.Reset();
+
+	// How much of each layer survives the time since the last update
+	float Keep[NumInfluenceLayers];
+	for (int32 Layer = 0; Layer < NumInfluenceLayers; Layer++)
+	{
+		Keep[Layer] = FMath::Exp2(-TimeSinceUpdate / InfluenceLayerSettings[Layer].HalfLife);
+	}
+
+	Buffers->bUpdateInFlight = true;
+	bUpdateStarted = true;
+	TimeSinceUpdate = 0.0f;
+
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask,
+		[SharedBuffers = Buffers, Stamps = MoveTemp(Stamps), KeepLayers = TArray<float>(Keep, NumInfluenceLayers),
+		 GridWidth = Width, GridHeight = Height]()
+	{
+		// Reading the published copy, which readers share, and writing the other
+		const int32 ReadIndex = SharedBuffers->ReadIndex;
+		const int32 WriteIndex = 1 - ReadIndex;
+		for (int32 Layer = 0; Layer < NumInfluenceLayers; Layer++)
+		{
+			PropagateLayer(SharedBuffers->Layers[ReadIndex][Layer].GetData(), SharedBuffers->Layers[WriteIndex][Layer].GetData(),
+			               GridWidth, GridHeight, KeepLayers[Layer], InfluenceLayerSettings[Layer].Spread);
+		}
+
+		for (const FInfluenceStamp& Stamp : Stamps)
+		{
+			ApplyStamp(Stamp, SharedBuffers->Layers[WriteIndex][static_cast<int32>(Stamp.Layer)].GetData(), GridWidth, GridHeight);
+		}
+
+		SharedBuffers->bUpdateInFlight = false;
+	});
+}
+
+bool UInfluenceMapSubsystem::InitialiseGrid()
+{
+	// A world without a navigation system won't gain one, so there is nothing to wait for
+	const UNavigationSystemV1* NavigationSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (!NavigationSystem)
+	{
+		bHasNavigation = false;
+		return false;
+	}
+
+	FBox Bounds(ForceInit);
+	for (const FNavigationBounds& NavigationBounds : NavigationSystem->GetNavigationBounds())
+	{
+		Bounds += NavigationBounds.AreaBox;
+	}
+
+	if (!Bounds.IsValid)
+	{
+		return false;
+	}
+
+	// Cells are widened if needed to keep the grid within its largest size
+	const FVector Size = Bounds.GetSize();
+	CellSize = FMath::Max3(CVarInfluenceMapCellSize.GetValueOnGameThread(), Size.X / MaxInfluenceMapSize, Size.Y / MaxInfluenceMapSize);
+	CellSize = FMath::Max(CellSize, 1.0f);
+	Origin = FVector2D(Bounds.Min.X, Bounds.Min.Y);
+	Width = FMath::Max(FMath::CeilToInt(Size.X / CellSize), 1);
+	Height = FMath::Max(FMath::CeilToInt(Size.Y / CellSize), 1);
+
+	Buffers = MakeShared<FInfluenceMapBuffers, ESPMode::ThreadSafe>();
+	for (int32 Copy = 0; Copy < 2; Copy++)
+	{
+		for (int32 Layer = 0; Layer < NumInfluenceLayers; Layer++)
+		{
+			Buffers->Layers[Copy][Layer].SetNumZeroed(Width * Height);
+		}
+	}
+
+	UE_LOG(LogProfilingDebugging, Log, TEXT("Influence map covering %s with %d x %d cells of %.0f"), *Bounds.ToString(),
+	       Width, Height, CellSize);
+	return true;
+}
+
+void UInfluenceMapSubsystem::PropagateLayer(const float* Source, float* Dest, const int32 Width, const int32 Height,
+                                            const float Keep, const float Spread)
+{
+	// Each cell moves towards the average of its four neighbours, then decays. Cells on the edge of the grid stand in
+	// for their missing neighbours
+	const float CentreWeight = (1.0f - Spread) * Keep;
+	const float NeighbourWeight = 0.25f * Spread * Keep;
+	const VectorRegister CentreWeights = VectorSetFloat1(CentreWeight);
+	const VectorRegister NeighbourWeights = VectorSetFloat1(NeighbourWeight);
+
+	for (int32 Y = 0; Y < Height; Y++)
+	{
+		const float* Row = Source + Y * Width;
+		const float* Up = Y > 0 ? Row - Width : Row;
+		const float* Down = Y < Height - 1 ? Row + Width : Row;
+		float* Out = Dest + Y * Width;
+
+		const auto PropagateCell = [Row, Up, Down, Out, Width, CentreWeight, NeighbourWeight](const int32 X)
+		{
+			const float Left = X > 0 ? Row[X - 1] : Row[X];
+			const float Right = X < Width - 1 ? Row[X + 1] : Row[X];
+			Out[X] = Row[X] * CentreWeight + (Left + Right + Up[X] + Down[X]) * NeighbourWeight;
+		};
+
+		PropagateCell(0);
+
+		// Four cells at a time through the middle of the row, where every neighbour exists
+		int32 X = 1;
+		for (; X + 4 < Width; X += 4)
+		{
+			const VectorRegister Neighbours = VectorAdd(VectorAdd(VectorLoad(Row + X - 1), VectorLoad(Row + X + 1)),
+			                                            VectorAdd(VectorLoad(Up + X), VectorLoad(Down + X)));
+			const VectorRegister Result = VectorMultiplyAdd(Neighbours, NeighbourWeights, VectorMultiply(VectorLoad(Row + X), CentreWeights));
+			VectorStore(Result, Out + X);
+		}
+
+		for (; X < Width; X++)
+		{
+			PropagateCell(X);
+		}
+	}
+}
+
+void UInfluenceMapSubsystem::ApplyStamp(const FInfluenceStamp& Stamp, float* Layer, const int32 Width, const int32 Height)
+{
+	if (Stamp.Radius <= 0.0f)
+	{
+		return;
+	}
+
+	const int32 MinX = FMath::Max(FMath::FloorToInt(Stamp.Cell.X - Stamp.Radius), 0);
+	const int32 MaxX = FMath::Min(FMath::FloorToInt(Stamp.Cell.X + Stamp.Radius), Width - 1);
+	const int32 MinY = FMath::Max(FMath::FloorToInt(Stamp.Cell.Y - Stamp.Radius), 0);
+	const int32 MaxY = FMath::Min(FMath::FloorToInt(Stamp.Cell.Y + Stamp.Radius), Height - 1);
+	const float InvRadius = 1.0f / Stamp.Radius;
+
+	for (int32 Y = MinY; Y <= MaxY; Y++)
+	{
+		const float DeltaYSquared = FMath::Square(Y + 0.5f - Stamp.Cell.Y);
+		float* Row = Layer + Y * Width;
+		for (int32 X = MinX; X <= MaxX; X++)
+		{
+			const float Distance = FMath::Sqrt(FMath::Square(X + 0.5f - Stamp.Cell.X) + DeltaYSquared);
+			const float Influence = Stamp.Strength * (1.0f - Distance * InvRadius);
+			Row[X] = FMath::Max(Row[X], Influence);
+		}
+	}
+}
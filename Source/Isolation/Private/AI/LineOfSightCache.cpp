@@ -0,0 +1,267 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/LineOfSightCache.h"
+#include "FPSCharacter.h"
+#include "Engine/World.h"
+
+static TAutoConsoleVariable<int32> CVarLineOfSightTracesPerFrame(
+	TEXT("isolation.AI.LineOfSightTracesPerFrame"),
+	16,
+	TEXT("The maximum number of AI line of sight traces submitted in a single frame."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarLineOfSightValidity(
+	TEXT("isolation.AI.LineOfSightValidity"),
+	0.25f,
+	TEXT("How long, in seconds, a line of sight result is trusted for before it has to be traced again."),
+	ECVF_Default);
+
+/** Entries that haven't been queried for this long are dropped */
+static constexpr float LineOfSightEntryTimeout = 2.0f;
+
+void ULineOfSightCache::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	static const FName NAME_AILineOfSight = FName(TEXT("TestPawnLineOfSight"));
+	QueryParams = FCollisionQueryParams(NAME_AILineOfSight, true);
+
+	TraceCompletedDelegate.BindUObject(this, &ULineOfSightCache::HandleTraceCompleted);
+}
+
+void ULineOfSightCache::Deinitialize()
+{
+	// Unbinding doesn't reach traces already queued, as each holds a copy of the delegate. Their callbacks are dropped by
+	// the weak binding once we have been collected, and before that find no in flight traces to apply
+	TraceCompletedDelegate.Unbind();
+	Entries.Empty();
+	EntryIndices.Empty();
+	ObserverTraceIntervals.Empty();
+	InFlightTraces.Empty();
+	OutstandingTraces = 0;
+
+	Super::Deinitialize();
+}
+
+bool ULineOfSightCache::QueryVisibility(const AFPSCharacter* Target, const AActor* Observer,
+                                        const FVector& ObserverLocation, FVector& OutSeenLocation)
+{
+	const FLineOfSightKey Key(Observer, Target);
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+
+	FLineOfSightEntry* Entry;
+	if (const int32* ExistingIndex = EntryIndices.Find(Key))
+	{
+		Entry = &Entries[*ExistingIndex];
+	}
+	else
+	{
+		EntryIndices.Add(Key, Entries.Num());
+		Entry = &Entries.AddDefaulted_GetRef();
+		Entry->Key = Key;
+		Entry->Observer = Observer;
+		Entry->Target = Target;
+		Entry->PointResultTimes.Init(-1.0f, Target->GetNumDetectionPoints());
+		Entry->PointVisible.Init(false, Target->GetNumDetectionPoints());
+		Entry->TraceInterval = ObserverTraceIntervals.FindRef(Observer);
+	}
+
+	Entry->ObserverLocation = ObserverLocation;
+	Entry->LastQueryTime = CurrentTime;
+
+	// We are visible if any point was seen within the validity window, checking the last point seen first
+	const float ValidityWindow = CVarLineOfSightValidity.GetValueOnGameThread() + Entry->TraceInterval;
+	const auto IsFreshlyVisible = [Entry, CurrentTime, ValidityWindow](const int32 Point)
+	{
+		return Entry->PointVisible[Point] && CurrentTime - Entry->PointResultTimes[Point] <= ValidityWindow;
+	};
+
+	if (Entry->LastVisiblePoint != INDEX_NONE && IsFreshlyVisible(Entry->LastVisiblePoint))
+	{
+		OutSeenLocation = Target->GetDetectionPointLocation(Entry->LastVisiblePoint);
+		return true;
+	}
+
+	for (int32 Point = 0; Point < Entry->PointVisible.Num(); Point++)
+	{
+		if (IsFreshlyVisible(Point))
+		{
+			OutSeenLocation = Target->GetDetectionPointLocation(Point);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ULineOfSightCache::SetObserverTraceInterval(const AActor* Observer, const float Interval)
+{
+	if (Interval > 0.0f)
+	{
+		ObserverTraceIntervals.Add(Observer, Interval);
+	}
+	else
+	{
+		ObserverTraceIntervals.Remove(Observer);
+	}
+
+	for (FLineOfSightEntry& Entry : Entries)
+	{
+		if (Entry.Key.Key == Observer)
+		{
+			Entry.TraceInterval = FMath::Max(Interval, 0.0f);
+		}
+	}
+}
+
+void ULineOfSightCache::Tick(float DeltaTime)
+{
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return;
+	}
+
+	const float CurrentTime = World->GetTimeSeconds();
+
+	// Dropping pairs that have stopped being asked about, or whose actors have gone
+	for (int32 Index = Entries.Num() - 1; Index >= 0; Index--)
+	{
+		const FLineOfSightEntry& Entry = Entries[Index];
+		if (!Entry.Observer.IsValid() || !Entry.Target.IsValid() || CurrentTime - Entry.LastQueryTime > LineOfSightEntryTimeout)
+		{
+			RemoveEntryAt(Index);
+		}
+	}
+
+	// Once every trace from the previous frame has returned we can reuse the in flight array from the start
+	if (OutstandingTraces == 0)
+	{
+		InFlightTraces.Reset();
+	}
+
+	const int32 NumEntries = Entries.Num();
+	if (NumEntries == 0)
+	{
+		return;
+	}
+
+	const float ValidityWindow = CVarLineOfSightValidity.GetValueOnGameThread();
+	const FCollisionObjectQueryParams ObjectQueryParams(ECC_TO_BITFIELD(ECC_WorldStatic) | ECC_TO_BITFIELD(ECC_WorldDynamic));
+	int32 TraceBudget = CVarLineOfSightTracesPerFrame.GetValueOnGameThread();
+
+	// Giving each entry at most one trace per frame, starting where last frame's budget ran out
+	const int32 FirstEntry = NextEntry % NumEntries;
+	int32 Offset = 0;
+	for (; Offset < NumEntries && TraceBudget > 0; Offset++)
+	{
+		FLineOfSightEntry& Entry = Entries[(FirstEntry + Offset) % NumEntries];
+		if (Entry.bTracePending || CurrentTime - Entry.LastTraceTime < Entry.TraceInterval)
+		{
+			continue;
+		}
+
+		const int32 Point = GetPointToTrace(Entry, CurrentTime, ValidityWindow + Entry.TraceInterval);
+		if (Point == INDEX_NONE)
+		{
+			continue;
+		}
+
+		FLineOfSightTrace& Trace = InFlightTraces.AddDefaulted_GetRef();
+		Trace.Key = Entry.Key;
+		Trace.PointIndex = Point;
+
+		QueryParams.ClearIgnoredActors();
+		QueryParams.AddIgnoredActor(Entry.Observer.Get());
+		World->AsyncLineTraceByObjectType(EAsyncTraceType::Single, Entry.ObserverLocation,
+		                                  Entry.Target->GetDetectionPointLocation(Point), ObjectQueryParams,
+		                                  QueryParams, &TraceCompletedDelegate, InFlightTraces.Num() - 1);
+
+		Entry.bTracePending = true;
+		Entry.LastTraceTime = CurrentTime;
+		OutstandingTraces++;
+		TraceBudget--;
+	}
+
+	NextEntry = FirstEntry + Offset;
+}
+
+int32 ULineOfSightCache::GetPointToTrace(const FLineOfSightEntry& Entry, const float CurrentTime, const float ValidityWindow)
+{
+	// While a point is visible we only keep that one fresh, re-checking it before it expires
+	if (Entry.LastVisiblePoint != INDEX_NONE)
+	{
+		const float Age = CurrentTime - Entry.PointResultTimes[Entry.LastVisiblePoint];
+		return Age >= ValidityWindow * 0.5f ? Entry.LastVisiblePoint : INDEX_NONE;
+	}
+
+	// Otherwise we keep cycling through the points until one of them is seen
+	return Entry.NextPoint;
+}
+
+void ULineOfSightCache::RemoveEntryAt(const int32 Index)
+{
+	EntryIndices.Remove(Entries[Index].Key);
+
+	Entries.RemoveAtSwap(Index, 1, false);
+	if (Index < Entries.Num())
+	{
+		EntryIndices.Add(Entries[Index].Key, Index);
+	}
+}
+
+void ULineOfSightCache::HandleTraceCompleted(const FTraceHandle& Handle, FTraceDatum& Data)
+{
+	OutstandingTraces--;
+
+	if (!InFlightTraces.IsValidIndex(Data.UserData))
+	{
+		return;
+	}
+
+	const FLineOfSightTrace& Trace = InFlightTraces[Data.UserData];
+	const int32* EntryIndex = EntryIndices.Find(Trace.Key);
+	if (!EntryIndex)
+	{
+		// The pair was dropped while its trace was in flight
+		return;
+	}
+
+	FLineOfSightEntry& Entry = Entries[*EntryIndex];
+	Entry.bTracePending = false;
+
+	const AFPSCharacter* Target = Entry.Target.Get();
+	if (!Target || !Entry.PointVisible.IsValidIndex(Trace.PointIndex))
+	{
+		return;
+	}
+
+	// Nothing in the way, or only something belonging to the target
+	bool bVisible = true;
+	for (const FHitResult& Hit : Data.OutHits)
+	{
+		if (Hit.bBlockingHit && !(Hit.Actor.IsValid() && Hit.Actor->IsOwnedBy(Target)))
+		{
+			bVisible = false;
+			break;
+		}
+	}
+
+	Entry.PointVisible[Trace.PointIndex] = bVisible;
+	Entry.PointResultTimes[Trace.PointIndex] = GetWorld()->GetTimeSeconds();
+
+	if (bVisible)
+	{
+		Entry.LastVisiblePoint = Trace.PointIndex;
+	}
+	else
+	{
+		if (Entry.LastVisiblePoint == Trace.PointIndex)
+		{
+			// Lost sight of our last point, so we go back to cycling through all of them, starting with the next
+			Entry.LastVisiblePoint = INDEX_NONE;
+		}
+		Entry.NextPoint = (Trace.PointIndex + 1) % Entry.PointVisible.Num();
+	}
+}
@@ -0,0 +1,324 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AI/UtilityAISubsystem.h"
+#include "AI/AICharacter.h"
+#include "AI/AICharacterController.h"
+#include "AI/CoverSubsystem.h"
+#include "AI/InfluenceMapSubsystem.h"
+#include "Async/ParallelFor.h"
+
+static TAutoConsoleVariable<float> CVarUtilityEvaluationInterval(
+	TEXT("isolation.AI.Utility.EvaluationInterval"),
+	0.25f,
+	TEXT("How often, in seconds, every AI's action is re-chosen."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarUtilityCoverSearchRadius(
+	TEXT("isolation.AI.Utility.CoverSearchRadius"),
+	1000.0f,
+	TEXT("How far from an AI cover is looked for when deciding whether it can take cover."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarUtilityFlankStalemateTime(
+	TEXT("isolation.AI.Utility.FlankStalemateTime"),
+	8.0f,
+	TEXT("How long, in seconds, an aggressive AI engages a target from the same position before flanking it beats engaging."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarUtilityActionMomentum(
+	TEXT("isolation.AI.Utility.ActionMomentum"),
+	0.1f,
+	TEXT("The score added to an AI's current action, so that it doesn't switch between actions that score about the same."),
+	ECVF_Default);
+
+/** The number of agents scored by each worker */
+static constexpr int32 UtilityBatchSize = 32;
+
+/** The score of doing nothing, which any other action has to beat */
+static constexpr float IdleScore = 0.05f;
+
+/** Maps a value onto 0 to 1 as it goes from Low to High, clamping either side */
+static float LinearResponse(const float Value, const float Low, const float High)
+{
+	return FMath::Clamp((Value - Low) / FMath::Max(High - Low, KINDA_SMALL_NUMBER), 0.0f, 1.0f);
+}
+
+void FUtilityConsiderations::SetNum(const int32 Num)
+{
+	TargetDistances.SetNumUninitialized(Num, false);
+	MinCombatDistances.SetNumUninitialized(Num, false);
+	MaxCombatDistances.SetNumUninitialized(Num, false);
+	AmmoFractions.SetNumUninitialized(Num, false);
+	WeaponHealthFractions.SetNumUninitialized(Num, false);
+	CoverAvailability.SetNumUninitialized(Num, false);
+	Aggression.SetNumUninitialized(Num, false);
+	Threats.SetNumUninitialized(Num, false);
+	EngagedTimes.SetNumUninitialized(Num, false);
+	LostTargets.SetNumUninitialized(Num, false);
+	AmbushAllowed.SetNumUninitialized(Num, false);
+	CurrentActions.SetNumUninitialized(Num, false);
+}
+
+void UUtilityAISubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+#if !UE_BUILD_SHIPPING
+	CheckArchetypeChoices();
+#endif
+}
+
+void UUtilityAISubsystem::Deinitialize()
+{
+	Agents.Empty();
+	AgentIndices.Empty();
+	Considerations.SetNum(0);
+	ChosenActions.Empty();
+
+	Super::Deinitialize();
+}
+
+void UUtilityAISubsystem::RegisterAgent(AAICharacterController* Controller)
+{
+	if (!Controller || AgentIndices.Contains(Controller))
+	{
+		return;
+	}
+
+	AgentIndices.Add(Controller, Agents.Num());
+	FUtilityAgent& Agent = Agents.AddDefaulted_GetRef();
+	Agent.Key = Controller;
+	Agent.Controller = Controller;
+}
+
+void UUtilityAISubsystem::UnregisterAgent(const AAICharacterController* Controller)
+{
+	int32 Index;
+	if (!AgentIndices.RemoveAndCopyValue(Controller, Index))
+	{
+		return;
+	}
+
+	Agents.RemoveAtSwap(Index, 1, false);
+	if (Index < Agents.Num())
+	{
+		AgentIndices.Add(Agents[Index].Key, Index);
+	}
+}
+
+void UUtilityAISubsystem::Tick(float DeltaTime)
+{
+	TimeSinceEvaluation += DeltaTime;
+	if (TimeSinceEvaluation < CVarUtilityEvaluationInterval.GetValueOnGameThread())
+	{
+		return;
+	}
+	const float TimeElapsed = TimeSinceEvaluation;
+	TimeSinceEvaluation = 0.0f;
+
+	GatherConsiderations();
+
+	// Scoring is pure arithmetic over the gathered arrays, so the agents are split between the workers in batches
+	const int32 NumAgents = Agents.Num();
+	ChosenActions.SetNumUninitialized(NumAgents, false);
+	const int32 NumBatches = FMath::DivideAndRoundUp(NumAgents, UtilityBatchSize);
+	ParallelFor(NumBatches, [this, NumAgents](const int32 Batch)
+	{
+		const int32 End = FMath::Min((Batch + 1) * UtilityBatchSize, NumAgents);
+		for (int32 Index = Batch * UtilityBatchSize; Index < End; Index++)
+		{
+			ChosenActions[Index] = ChooseAction(Considerations, Index);
+		}
+	});
+
+	for (int32 Index = 0; Index < NumAgents; Index++)
+	{
+		// Anything other than engaging ends the standoff, including the flank it leads to
+		FUtilityAgent& Agent = Agents[Index];
+		Agent.TimeEngaged = ChosenActions[Index] == EUtilityAction::Engage ? Agent.TimeEngaged + TimeElapsed : 0.0f;
+
+		if (AAICharacterController* Controller = Agent.Controller.Get())
+		{
+			Controller->SetUtilityAction(ChosenActions[Index]);
+		}
+	}
+}
+
+void UUtilityAISubsystem::GatherConsiderations()
+{
+	const UCoverSubsystem* CoverSubsystem = GetWorld()->GetSubsystem<UCoverSubsystem>();
+	const UInfluenceMapSubsystem* InfluenceMap = GetWorld()->GetSubsystem<UInfluenceMapSubsystem>();
+	const float CoverSearchRadius = CVarUtilityCoverSearchRadius.GetValueOnGameThread();
+
+	Considerations.SetNum(Agents.Num());
+	for (int32 Index = 0; Index < Agents.Num(); Index++)
+	{
+		const AAICharacterController* Controller = Agents[Index].Controller.Get();
+		const AAICharacter* Character = Controller ? Cast<AAICharacter>(Controller->GetPawn()) : nullptr;
+		const AActor* Target = Controller ? Controller->GetTargetActor() : nullptr;
+
+		Considerations.TargetDistances[Index] = -1.0f;
+		Considerations.MinCombatDistances[Index] = Controller ? Controller->GetCombatMinDistance() : 0.0f;
+		Considerations.MaxCombatDistances[Index] = Controller ? Controller->GetCombatMaxDistance() : 0.0f;
+		Considerations.AmmoFractions[Index] = 1.0f;
+		Considerations.WeaponHealthFractions[Index] = 1.0f;
+		Considerations.CoverAvailability[Index] = 0.0f;
+		Considerations.Aggression[Index] = Controller && Controller->IsAggressive() ? 1.0f : 0.0f;
+		Considerations.Threats[Index] = 0.0f;
+		Considerations.EngagedTimes[Index] = Agents[Index].TimeEngaged;
+		Considerations.LostTargets[Index] = 0.0f;
+		Considerations.AmbushAllowed[Index] = Controller && Controller->CanAmbush() ? 1.0f : 0.0f;
+		Considerations.CurrentActions[Index] = Controller ? Controller->GetUtilityAction() : EUtilityAction::None;
+
+		// AI without a pawn or weapon are left looking fully armed, so that they never decide to reload
+		if (!Character)
+		{
+			continue;
+		}
+
+		const FVector Location = Character->GetActorLocation();
+		if (Target)
+		{
+			Considerations.TargetDistances[Index] = FVector::Dist(Location, Target->GetActorLocation());
+
+			if (CoverSubsystem && Controller->CanTakeCover() &&
+				CoverSubsystem->FindBestCover(Target->GetActorLocation(), Location, CoverSearchRadius, ECoverType::Crouch, Character) != INDEX_NONE)
+			{
+				Considerations.CoverAvailability[Index] = 1.0f;
+			}
+		}
+		else if (Character->HasKnownTarget())
+		{
+			Considerations.LostTargets[Index] = 1.0f;
+		}
+
+		if (AWeaponBase* Weapon = Character->GetCurrentWeapon())
+		{
+			const FRuntimeWeaponData* WeaponData = Weapon->GetRuntimeWeaponData();
+			Considerations.AmmoFractions[Index] = WeaponData->ClipCapacity > 0 ? static_cast<float>(WeaponData->ClipSize) / WeaponData->ClipCapacity : 1.0f;
+			Considerations.WeaponHealthFractions[Index] = FMath::Clamp(WeaponData->WeaponHealth / 100.0f, 0.0f, 1.0f);
+		}
+
+		if (InfluenceMap)
+		{
+			Considerations.Threats[Index] = InfluenceMap->GetInfluence(EInfluenceLayer::Threat, Location);
+		}
+	}
+}
+
+EUtilityAction UUtilityAISubsystem::ChooseAction(const FUtilityConsiderations& AgentConsiderations, const int32 Index)
+{
+	const float Distance = AgentConsiderations.TargetDistances[Index];
+	const float MinDistance = AgentConsiderations.MinCombatDistances[Index];
+	const float MaxDistance = AgentConsiderations.MaxCombatDistances[Index];
+	const float Ammo = AgentConsiderations.AmmoFractions[Index];
+	const float WeaponHealth = AgentConsiderations.WeaponHealthFractions[Index];
+	const float Cover = AgentConsiderations.CoverAvailability[Index];
+	const float Aggression = AgentConsiderations.Aggression[Index];
+	const float Threat = FMath::Clamp(AgentConsiderations.Threats[Index], 0.0f, 1.0f);
+	const float Stalemate = LinearResponse(AgentConsiderations.EngagedTimes[Index], 0.0f, CVarUtilityFlankStalemateTime.GetValueOnAnyThread());
+
+	const float HasTarget = Distance >= 0.0f ? 1.0f : 0.0f;
+	const float HasAmmo = Ammo > 0.0f ? 1.0f : 0.0f;
+
+	// How well the target sits within our combat range, fading out over a fifth of the range either side
+	const float Margin = FMath::Max((MaxDistance - MinDistance) * 0.2f, 1.0f);
+	const float TooFar = LinearResponse(Distance, MaxDistance, MaxDistance + Margin);
+	const float TooClose = 1.0f - LinearResponse(Distance, MinDistance - Margin, MinDistance);
+	const float InRange = HasTarget * (1.0f - FMath::Max(TooFar, TooClose));
+
+	float Scores[static_cast<int32>(EUtilityAction::Count)];
+	Scores[static_cast<int32>(EUtilityAction::None)] = IdleScore;
+	Scores[static_cast<int32>(EUtilityAction::Engage)] = InRange * HasAmmo * LinearResponse(Ammo, 0.0f, 0.3f) * (0.6f + 0.4f * Aggression);
+	Scores[static_cast<int32>(EUtilityAction::Advance)] = HasTarget * HasAmmo * TooFar * (0.5f + 0.5f * Aggression);
+	Scores[static_cast<int32>(EUtilityAction::Retreat)] = HasTarget * TooClose * (1.0f - 0.5f * Aggression);
+	Scores[static_cast<int32>(EUtilityAction::TakeCover)] = HasTarget * Cover * (0.4f * (1.0f - WeaponHealth) + 0.3f * Threat + 0.3f * (1.0f - Aggression));
+	// Flanking grows with a standoff until it can beat engaging, so an aggressive AI that has traded fire from one spot for
+	// long enough works around the target's side, unless it is pinned down. Defensive AI stay short of engaging, and
+	// nobody sets off round the side without most of a clip
+	Scores[static_cast<int32>(EUtilityAction::Flank)] = InRange * HasAmmo * LinearResponse(Ammo, 0.2f, 0.5f) * (0.2f + 1.2f * Stalemate) *
+		(0.4f + 0.6f * Aggression) * (1.0f - 0.3f * Threat);
+	Scores[static_cast<int32>(EUtilityAction::Reload)] = (1.0f - LinearResponse(Ammo, 0.0f, 0.25f)) * (1.0f - 0.2f * HasTarget);
+	Scores[static_cast<int32>(EUtilityAction::Ambush)] = AgentConsiderations.LostTargets[Index] * AgentConsiderations.AmbushAllowed[Index] * (0.5f + 0.4f * (1.0f - Aggression));
+
+	// Favouring what we are already doing, so that near ties don't flip the action every evaluation
+	Scores[static_cast<int32>(AgentConsiderations.CurrentActions[Index])] += CVarUtilityActionMomentum.GetValueOnAnyThread();
+
+	EUtilityAction BestAction = EUtilityAction::None;
+	float BestScore = -MAX_FLT;
+	for (int32 Action = 0; Action < static_cast<int32>(EUtilityAction::Count); Action++)
+	{
+		if (Scores[Action] > BestScore)
+		{
+			BestScore = Scores[Action];
+			BestAction = static_cast<EUtilityAction>(Action);
+		}
+	}
+
+	return BestAction;
+}
+
+#if !UE_BUILD_SHIPPING
+void UUtilityAISubsystem::CheckArchetypeChoices()
+{
+	// A typical situation, and the action an AI of the given attitude should choose in it
+	struct FArchetypeCase
+	{
+		const TCHAR* Description;
+		float Aggression;
+		float EngagedTime;
+		float Ammo;
+		float WeaponHealth;
+		float Cover;
+		float Threat;
+		EUtilityAction CurrentAction;
+		EUtilityAction Expected;
+	};
+
+	const float StalemateTime = CVarUtilityFlankStalemateTime.GetValueOnGameThread();
+	const FArchetypeCase Cases[] =
+	{
+		{ TEXT("Aggressive, target just found"), 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, EUtilityAction::None, EUtilityAction::Engage },
+		{ TEXT("Aggressive, standoff"), 1.0f, StalemateTime, 1.0f, 1.0f, 0.0f, 0.0f, EUtilityAction::Engage, EUtilityAction::Flank },
+		{ TEXT("Aggressive, standoff under some threat"), 1.0f, StalemateTime, 1.0f, 1.0f, 1.0f, 0.5f, EUtilityAction::Engage, EUtilityAction::Flank },
+		{ TEXT("Aggressive, low ammo"), 1.0f, StalemateTime, 0.1f, 1.0f, 0.0f, 0.0f, EUtilityAction::Engage, EUtilityAction::Reload },
+		{ TEXT("Defensive, target just found"), 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, EUtilityAction::None, EUtilityAction::Engage },
+		{ TEXT("Defensive, standoff"), 0.0f, StalemateTime, 1.0f, 1.0f, 0.0f, 0.0f, EUtilityAction::Engage, EUtilityAction::Engage },
+		{ TEXT("Defensive, damaged and threatened near cover"), 0.0f, 0.0f, 1.0f, 0.2f, 1.0f, 0.5f, EUtilityAction::None, EUtilityAction::TakeCover },
+	};
+
+	// Every case has a target in the middle of its combat range
+	const int32 NumCases = UE_ARRAY_COUNT(Cases);
+	FUtilityConsiderations CaseConsiderations;
+	CaseConsiderations.SetNum(NumCases);
+	for (int32 Index = 0; Index < NumCases; Index++)
+	{
+		const FArchetypeCase& Case = Cases[Index];
+		CaseConsiderations.TargetDistances[Index] = 1000.0f;
+		CaseConsiderations.MinCombatDistances[Index] = 500.0f;
+		CaseConsiderations.MaxCombatDistances[Index] = 2000.0f;
+		CaseConsiderations.AmmoFractions[Index] = Case.Ammo;
+		CaseConsiderations.WeaponHealthFractions[Index] = Case.WeaponHealth;
+		CaseConsiderations.CoverAvailability[Index] = Case.Cover;
+		CaseConsiderations.Aggression[Index] = Case.Aggression;
+		CaseConsiderations.Threats[Index] = Case.Threat;
+		CaseConsiderations.EngagedTimes[Index] = Case.EngagedTime;
+		CaseConsiderations.LostTargets[Index] = 0.0f;
+		CaseConsiderations.AmbushAllowed[Index] = 0.0f;
+		CaseConsiderations.CurrentActions[Index] = Case.CurrentAction;
+	}
+
+	const UEnum* ActionEnum = StaticEnum<EUtilityAction>();
+	for (int32 Index = 0; Index < NumCases; Index++)
+	{
+		const EUtilityAction Chosen = ChooseAction(CaseConsiderations, Index);
+		if (Chosen != Cases[Index].Expected)
+		{
+			UE_LOG(LogProfilingDebugging, Warning, TEXT("Utility AI chose %s instead of %s for \"%s\", check the action curves and isolation.AI.Utility settings"),
+			       *ActionEnum->GetNameStringByValue(static_cast<int64>(Chosen)),
+			       *ActionEnum->GetNameStringByValue(static_cast<int64>(Cases[Index].Expected)), Cases[Index].Description);
+		}
+	}
+}
+#endif
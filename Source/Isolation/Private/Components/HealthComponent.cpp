@@ -29,12 +29,15 @@ void UHealthComponent::HandleTakeAnyDamage(AActor* DamagedActor, float Damage,
 	if (Damage <= 0.0f)
 	{
 		// Health is already at most 0, so no need to perform any calculations
+		LastDamageHits.Reset();
 		return;
 	}
 
 	// Updating health, clamped between 0 and 100
 	Health = FMath::Clamp(Health - Damage, 0.0f, 100.0f);
 
-	// Broadcasting our new health
+	// Broadcasting our new health. Batched damage arrives here once per frame for each instigator, with the hits that
+	// made it up available through GetLastDamageHits until the broadcast is over
 	OnHealthChanged.Broadcast(this, Health, Damage, DamageType, InstigatedBy, DamageCauser);
+	LastDamageHits.Reset();
 }
@@ -9,6 +9,7 @@
 #include "NiagaraSystem.h"
 #include "WeaponBase.h"
 #include "Interactables/WeaponPickup.h"
+#include "Weapons/WeaponPoolSubsystem.h"
 #include "Camera/CameraComponent.h"
 #include "Engine/StaticMeshActor.h"
 
@@ -86,17 +87,14 @@ void UInventoryComponent::SwapWeapon(const int SlotId)
 	// Disabling the currently equipped weapon, if it exists
     if (CurrentWeapon)
     {
-        CurrentWeapon->PrimaryActorTick.bCanEverTick = false;
-        CurrentWeapon->SetActorHiddenInGame(true);
-        CurrentWeapon->StopFire();
+        CurrentWeapon->SetWeaponActive(false);
     }
 
 	// Swapping to the new weapon, enabling it and playing it's equip animation
     CurrentWeapon = EquippedWeapons[SlotId];
     if (CurrentWeapon)
     {
-        CurrentWeapon->PrimaryActorTick.bCanEverTick = true;
-        CurrentWeapon->SetActorHiddenInGame(false);
+        CurrentWeapon->SetWeaponActive(true);
         if (CurrentWeapon->GetStaticWeaponData()->WeaponEquip)
         {
         	if (const AFPSCharacter* FPSCharacter = Cast<AFPSCharacter>(GetOwner()))
@@ -111,16 +109,30 @@ void UInventoryComponent::DestroyCurrentWeapon()
 {
 	const int* CurrentWeaponId = EquippedWeapons.FindKey(CurrentWeapon);
 	EquippedWeapons.Remove(*CurrentWeaponId);
-	CurrentWeapon->Destroy();
+
+	// Broken weapons are repaired when they are reset, so they can go back into the pool like any other
+	if (UWeaponPoolSubsystem* WeaponPool = GetWorld()->GetSubsystem<UWeaponPoolSubsystem>())
+	{
+		WeaponPool->ReleaseWeapon(CurrentWeapon);
+	}
+	else
+	{
+		CurrentWeapon->Destroy();
+	}
+	CurrentWeapon = nullptr;
 }
 
 // Spawns a new weapon (either from weapon swap or picking up a new weapon)
 void UInventoryComponent::UpdateWeapon(const TSubclassOf<AWeaponBase> NewWeapon, const int InventoryPosition, const bool bSpawnPickup,
                                        const bool bStatic, const FTransform PickupTransform, const FRuntimeWeaponData DataStruct)
 {
-    // Determining spawn parameters (forcing the weapon to spawn at all times)
-    FActorSpawnParameters SpawnParameters;
-    SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+    // Weapons and pickups are recycled through the pool rather than spawned and destroyed on every swap
+    UWeaponPoolSubsystem* WeaponPool = GetWorld()->GetSubsystem<UWeaponPoolSubsystem>();
+    if (!WeaponPool)
+    {
+        return;
+    }
+
     if (InventoryPosition == CurrentWeaponSlot && EquippedWeapons.Contains(InventoryPosition))
     {
         if (bSpawnPickup)
@@ -137,25 +149,31 @@ void UInventoryComponent::UpdateWeapon(const TSubclassOf<AWeaponBase> NewWeapon,
             const FVector TraceDirection = TraceStartRotation.Vector();
             const FVector TraceEnd = TraceStart + TraceDirection * WeaponSpawnDistance;
 
-            // Spawning the new pickup
-            AWeaponPickup* NewPickup = GetWorld()->SpawnActor<AWeaponPickup>(CurrentWeapon->GetStaticWeaponData()->PickupReference, TraceEnd, FRotator::ZeroRotator, SpawnParameters);
-            if (bStatic)
+            // Placing the new pickup, which stays hidden until its data has been applied
+            AWeaponPickup* NewPickup = WeaponPool->AcquirePickup(CurrentWeapon->GetStaticWeaponData()->PickupReference,
+                                                                 bStatic ? PickupTransform : FTransform(TraceEnd));
+            if (NewPickup)
+            {
+                // Applying the current weapon data to the pickup
+                NewPickup->SetStatic(bStatic);
+                NewPickup->SetRuntimeSpawned(true);
+                NewPickup->SetWeaponReference(EquippedWeapons[InventoryPosition]->GetClass());
+                NewPickup->SetCacheDataStruct(EquippedWeapons[InventoryPosition]->GetRuntimeWeaponData());
+                NewPickup->SpawnAttachmentMesh();
+                NewPickup->SetPickupActive(true);
+            }
+
+            // The replaced weapon is no longer current once the new one is equipped below
+            if (CurrentWeapon == EquippedWeapons[InventoryPosition])
             {
-                NewPickup->GetMainMesh()->SetSimulatePhysics(false);
-                NewPickup->SetActorTransform(PickupTransform);
+                CurrentWeapon = nullptr;
             }
-            // Applying the current weapon data to the pickup
-            NewPickup->SetStatic(bStatic);
-            NewPickup->SetRuntimeSpawned(true);
-            NewPickup->SetWeaponReference(EquippedWeapons[InventoryPosition]->GetClass());
-            NewPickup->SetCacheDataStruct(EquippedWeapons[InventoryPosition]->GetRuntimeWeaponData());
-            NewPickup->SpawnAttachmentMesh();
-            EquippedWeapons[InventoryPosition]->Destroy();
+            WeaponPool->ReleaseWeapon(EquippedWeapons[InventoryPosition]);
         }
     }
 
-    // Spawns the new weapon and sets the player as it's owner
-    AWeaponBase* SpawnedWeapon = GetWorld()->SpawnActor<AWeaponBase>(NewWeapon, FVector::ZeroVector, FRotator::ZeroRotator, SpawnParameters);
+    // Acquires the new weapon and sets the player as it's owner
+    AWeaponBase* SpawnedWeapon = WeaponPool->AcquireWeapon(NewWeapon);
     if (SpawnedWeapon)
     {
     	// Placing the new weapon at the correct location and finishing up it's initialisation
@@ -171,9 +189,7 @@ void UInventoryComponent::UpdateWeapon(const TSubclassOf<AWeaponBase> NewWeapon,
 		// Disabling the currently equipped weapon, if it exists
         if (CurrentWeapon)
         {
-            CurrentWeapon->PrimaryActorTick.bCanEverTick = false;
-            CurrentWeapon->SetActorHiddenInGame(true);
-        	CurrentWeapon->StopFire();
+            CurrentWeapon->SetWeaponActive(false);
         }
     	
     	// Swapping to the new weapon, enabling it and playing it's equip animation
@@ -182,8 +198,7 @@ void UInventoryComponent::UpdateWeapon(const TSubclassOf<AWeaponBase> NewWeapon,
         
         if (CurrentWeapon)
         {
-            CurrentWeapon->PrimaryActorTick.bCanEverTick = true;
-            CurrentWeapon->SetActorHiddenInGame(false);
+            CurrentWeapon->SetWeaponActive(true);
             if (CurrentWeapon->GetStaticWeaponData()->WeaponEquip)
             {
             	if (const AFPSCharacter* FPSCharacter = Cast<AFPSCharacter>(GetOwner()))
@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Components/TargetSelectionComponent.h"
+#include "Perception/AIPerceptionComponent.h"
+#include "Perception/AISense_Sight.h"
+
+// Sets default values for this component's properties
+UTargetSelectionComponent::UTargetSelectionComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UTargetSelectionComponent::UpdateTargets(const UAIPerceptionComponent* PerceptionComponent)
+{
+	RankedTargets.Reset();
+	if (!PerceptionComponent || MaxRankedTargets <= 0)
+	{
+		return;
+	}
+
+	DecayDamage();
+
+	const AActor* Owner = GetOwner();
+	const AController* OwnerController = Cast<AController>(Owner);
+	const AActor* ViewActor = OwnerController && OwnerController->GetPawn() ? OwnerController->GetPawn() : Owner;
+	const FVector ViewLocation = ViewActor->GetActorLocation();
+
+	const FAISenseID SightSenseId = UAISense::GetSenseID<UAISense_Sight>();
+	const float MaxDistanceSquared = FMath::Square(MaxTargetDistance);
+
+	for (UAIPerceptionComponent::TActorPerceptionContainer::TConstIterator It = PerceptionComponent->GetPerceptualDataConstIterator(); It; ++It)
+	{
+		const FActorPerceptionInfo& PerceptionInfo = It->Value;
+		AActor* Actor = PerceptionInfo.Target.Get();
+		if (!Actor || !PerceptionInfo.LastSensedStimuli.IsValidIndex(SightSenseId))
+		{
+			continue;
+		}
+
+		// Skipping anything we've never seen, or haven't seen for too long
+		const FAIStimulus& SightStimulus = PerceptionInfo.LastSensedStimuli[SightSenseId];
+		const bool bVisible = SightStimulus.WasSuccessfullySensed() && !SightStimulus.IsExpired();
+		const float VisibilityAge = bVisible ? 0.0f : SightStimulus.GetAge();
+		if (SightStimulus.GetAge() == FAIStimulus::NeverHappenedAge || VisibilityAge > VisibilityMemory)
+		{
+			continue;
+		}
+
+		FTargetScore Candidate;
+		Candidate.Actor = Actor;
+		Candidate.bVisible = bVisible;
+		Candidate.VisibilityAge = VisibilityAge;
+		Candidate.DistanceSquared = FVector::DistSquared(ViewLocation, Actor->GetActorLocation());
+		const float* Damage = DamageReceived.Find(Actor);
+		Candidate.DamageReceived = Damage ? *Damage : 0.0f;
+
+		// Each term is normalised to [0, 1] before being weighted
+		const float DistanceScore = 1.0f - FMath::Min(Candidate.DistanceSquared / MaxDistanceSquared, 1.0f);
+		const float VisibilityScore = 1.0f - FMath::Min(VisibilityAge / VisibilityMemory, 1.0f);
+		const float DamageScore = Candidate.DamageReceived / (Candidate.DamageReceived + DamageHalfScore);
+		Candidate.Score = DistanceScore * DistanceWeight + VisibilityScore * VisibilityWeight + DamageScore * DamageWeight;
+
+		// Keeping only the best few, in order. Candidates that can't make the list are rejected with one comparison
+		if (RankedTargets.Num() == MaxRankedTargets && Candidate.Score <= RankedTargets.Last().Score)
+		{
+			continue;
+		}
+
+		int32 InsertIndex = RankedTargets.Num();
+		while (InsertIndex > 0 && RankedTargets[InsertIndex - 1].Score < Candidate.Score)
+		{
+			InsertIndex--;
+		}
+		RankedTargets.Insert(Candidate, InsertIndex);
+
+		if (RankedTargets.Num() > MaxRankedTargets)
+		{
+			RankedTargets.Pop(false);
+		}
+	}
+}
+
+void UTargetSelectionComponent::ReportDamage(AActor* Source, const float Damage)
+{
+	if (!Source || Damage <= 0.0f)
+	{
+		return;
+	}
+
+	DecayDamage();
+	DamageReceived.FindOrAdd(Source) += Damage;
+}
+
+AActor* UTargetSelectionComponent::GetBestVisibleTarget() const
+{
+	for (const FTargetScore& Target : RankedTargets)
+	{
+		if (Target.bVisible && IsValid(Target.Actor))
+		{
+			return Target.Actor;
+		}
+	}
+	return nullptr;
+}
+
+void UTargetSelectionComponent::DecayDamage()
+{
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	const float ElapsedTime = CurrentTime - LastDamageDecayTime;
+	LastDamageDecayTime = CurrentTime;
+
+	if (DamageReceived.Num() == 0 || ElapsedTime <= 0.0f)
+	{
+		return;
+	}
+
+	const float DecayFactor = DamageHalfLife > 0.0f ? FMath::Pow(0.5f, ElapsedTime / DamageHalfLife) : 0.0f;
+	for (auto It = DamageReceived.CreateIterator(); It; ++It)
+	{
+		It.Value() *= DecayFactor;
+
+		// Forgetting anyone who has gone, or whose damage has all but decayed
+		if (!It.Key().IsValid() || It.Value() < KINDA_SMALL_NUMBER)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
@@ -7,6 +7,7 @@
 #include "FPSCharacterController.h"
 #include "WeaponBase.h"
 #include "AI/AIManager.h"
+#include "AI/HearingSubsystem.h"
 #include "Blueprint/UserWidget.h"
 #include "Camera/CameraComponent.h"
 #include "Components/ArrowComponent.h"
@@ -67,31 +68,14 @@ bool AFPSCharacter::CanBeSeenFrom(const FVector& ObserverLocation, FVector& OutS
     int32& NumberOfLoSChecksPerformed, float& OutSightStrength, const AActor* IgnoreActor, const bool* bWasVisible,
     int32* UserData) const
 {
-
-    static const FName NAME_AILineOfSight = FName(TEXT("TestPawnLineOfSight"));
-    FHitResult HitResult;
-
-
-    for (const FName BoneName : DetectionSocketBoneNames)
-    {
-        const FVector SocketLocation = HandsMeshComp->GetSocketLocation(BoneName);
-        
-        const bool bHitSocket = GetWorld()->LineTraceSingleByObjectType(HitResult, ObserverLocation, SocketLocation, FCollisionObjectQueryParams(ECC_TO_BITFIELD(ECC_WorldStatic) | ECC_TO_BITFIELD(ECC_WorldDynamic)), FCollisionQueryParams(NAME_AILineOfSight, true, IgnoreActor));
-        NumberOfLoSChecksPerformed++;
-
-        if (bHitSocket == false || (HitResult.Actor.IsValid() && HitResult.Actor->IsOwnedBy(this)))
-        {
-            OutSeenLocation = SocketLocation;
-            OutSightStrength = 1;
-            return true;
-        }
-    }
-
-    const bool bHit = GetWorld()->LineTraceSingleByObjectType(HitResult, ObserverLocation, GetActorLocation(), FCollisionObjectQueryParams(ECC_TO_BITFIELD(ECC_WorldStatic) | ECC_TO_BITFIELD(ECC_WorldDynamic)), FCollisionQueryParams(NAME_AILineOfSight, true, IgnoreActor));
+    // The traces themselves are made asynchronously by the cache, within its own per-frame budget, so each query only
+    // counts as a single check against the sight sense's budget
     NumberOfLoSChecksPerformed++;
-    if (bHit == false || (HitResult.Actor.IsValid() && HitResult.Actor->IsOwnedBy(this)))
+
+    // AI share their sight traces with nearby members of their squad through the AI manager
+    UAIManager* AIManagerSubsystem = GetWorld()->GetSubsystem<UAIManager>();
+    if (AIManagerSubsystem && AIManagerSubsystem->QuerySquadVisibility(this, IgnoreActor, ObserverLocation, OutSeenLocation))
     {
-        OutSeenLocation = GetActorLocation();
         OutSightStrength = 1;
         return true;
     }
@@ -123,12 +107,21 @@ void AFPSCharacter::BeginPlay()
         InventoryComponent->GetEquippedWeapons().Reserve(InventoryComponent->GetNumberOfWeaponSlots());
     }
 
-    UAIManager* AIManagerSubsystem = GetWorld()->GetSubsystem<UAIManager>();
-    if (AIManagerSubsystem)
+    // Registering with the AI manager so that squad logic can find us through its neighbour queries
+    if (UAIManager* AIManagerSubsystem = GetWorld()->GetSubsystem<UAIManager>())
+    {
+        AIManagerSubsystem->RegisterAgent(this, IsAiWeaponOwner() ? EAgentType::AI : EAgentType::Player);
+    }
+}
+
+void AFPSCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    if (UAIManager* AIManagerSubsystem = GetWorld()->GetSubsystem<UAIManager>())
     {
-        GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, TEXT("Grabbed AI Subsystem"));
-        GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Orange, AIManagerSubsystem->GetName());
+        AIManagerSubsystem->UnregisterAgent(this);
     }
+
+    Super::EndPlay(EndPlayReason);
 }
 
 void AFPSCharacter::PawnClientRestart()
@@ -212,6 +205,11 @@ void AFPSCharacter::FootstepSounds()
     }
 
     FootstepAudioComp->Play();
+
+    if (UHearingSubsystem* HearingSubsystem = GetWorld()->GetSubsystem<UHearingSubsystem>())
+    {
+        HearingSubsystem->PostNoise(ENoiseType::Footstep, GetActorLocation(), this);
+    }
 }
 
 void AFPSCharacter::Move(const FInputActionValue& Value)
@@ -243,8 +241,7 @@ void AFPSCharacter::Look(const FInputActionValue& Value)
         if (Value.GetMagnitude() != 0.0f && InventoryComponent->GetCurrentWeapon())
         {
             // If movement is detected and we have a current weapon, make sure we don't recover the recoil
-            InventoryComponent->GetCurrentWeapon()->SetShouldRecover(false);
-            InventoryComponent->GetCurrentWeapon()->GetRecoilRecoveryTimeline()->Stop();
+            InventoryComponent->GetCurrentWeapon()->StopRecoilRecovery();
         }
     }
 }
@@ -745,6 +742,22 @@ void AFPSCharacter::PlayFlybySounds(FHitResult Hit)
     GEngine->AddOnScreenDebugMessage(-1, 1.0f, FColor::Orange, "Playing flyby sounds");
 }
 
+bool AFPSCharacter::GetShotAim(const AWeaponBase* Weapon, FVector& OutOrigin, FRotator& OutAimRotation) const
+{
+    OutOrigin = CameraComp->GetComponentLocation();
+    OutAimRotation = CameraComp->GetComponentRotation();
+    return true;
+}
+
+void AFPSCharacter::OnWeaponBroken(AWeaponBase* Weapon)
+{
+    if (InventoryComponent)
+    {
+        const FStaticWeaponData* BrokenWeaponData = Weapon->GetStaticWeaponData();
+        InventoryComponent->BeginDestroyCurrentWeapon(BrokenWeaponData->WeaponDestroyedHandsAnim, BrokenWeaponData->WeaponDestroyedParticleSystem);
+    }
+}
+
 // Called to bind functionality to input
 void AFPSCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
 {
@@ -4,6 +4,8 @@
 #include "Interactables/WeaponPickup.h"
 #include "FPSCharacter.h"
 #include "WeaponBase.h"
+#include "Weapons/WeaponPoolSubsystem.h"
+#include "Weapons/WeaponStatsCache.h"
 #include "Kismet/GameplayStatics.h"
 
 // Sets default values
@@ -82,64 +84,31 @@ void AWeaponPickup::OnConstruction(const FTransform& Transform)
 
 void AWeaponPickup::SpawnAttachmentMesh()
 {
-	// Getting a reference to our Weapon Data table in order to see if we have attachments
+	// Getting the resolved stats for our weapon and attachments, which tell us if the weapon has attachments
 	const AWeaponBase* WeaponBaseReference =  WeaponReference.GetDefaultObject();
-	if (const FStaticWeaponData* WeaponData = WeaponDataTable->FindRow<FStaticWeaponData>(FName(WeaponBaseReference->GetDataTableNameRef()), FString(WeaponBaseReference->GetDataTableNameRef()), true))
+	const TSharedPtr<const FResolvedWeaponStats> Stats = UWeaponStatsCache::GetStats(this, WeaponDataTable, FName(WeaponBaseReference->GetDataTableNameRef()), DataStruct.WeaponAttachments);
+	if (!Stats.IsValid())
 	{
-		// Spawning attachments if the weapon has them and the attachments table exists
-		if (WeaponData->bHasAttachments && AttachmentsDataTable)
-		{
-			// Iterating through all the attachments in AttachmentArray
-			for (FName RowName : DataStruct.WeaponAttachments)
-			{
-				// Searching the data table for the attachment
-				const FAttachmentData* AttachmentData = AttachmentsDataTable->FindRow<FAttachmentData>(RowName, RowName.ToString(), true);
-
-				// Applying the effects of the attachment
-				if (AttachmentData)
-				{
-					if (AttachmentData->AttachmentType == EAttachmentType::Barrel)
-					{
-						BarrelAttachment->SetStaticMesh(AttachmentData->PickupMesh);
-					}
-					else if (AttachmentData->AttachmentType == EAttachmentType::Magazine)
-					{
-						MagazineAttachment->SetStaticMesh(AttachmentData->PickupMesh);
-						// Pulling default values from the Magazine attachment type
-						if (!bRuntimeSpawned)
-						{
-							DataStruct.AmmoType = AttachmentData->AmmoToUse;
-							DataStruct.ClipCapacity = AttachmentData->ClipCapacity;
-							DataStruct.ClipSize = AttachmentData->ClipSize;
-							DataStruct.WeaponHealth = 100.0f;
-						}
-					}
-					else if (AttachmentData->AttachmentType == EAttachmentType::Sights)
-					{
-						SightsAttachment->SetStaticMesh(AttachmentData->PickupMesh);
-					}
-					else if (AttachmentData->AttachmentType == EAttachmentType::Stock)
-					{
-						StockAttachment->SetStaticMesh(AttachmentData->PickupMesh);
-					}
-					else if (AttachmentData->AttachmentType == EAttachmentType::Grip)
-					{
-						GripAttachment->SetStaticMesh(AttachmentData->PickupMesh);
-					}
-				}
-			}
-		}
-		else
-		{
-			// Applying default values if the weapon doesn't use attachments
-			if (!bRuntimeSpawned)
-			{
-				DataStruct.AmmoType = WeaponData->AmmoToUse;
-				DataStruct.ClipCapacity = WeaponData->ClipCapacity;
-				DataStruct.ClipSize = WeaponData->ClipSize;
-				DataStruct.WeaponHealth = 100.0f;
-			}
-		}
+		return;
+	}
+
+	// Spawning attachments if the weapon has them and the attachments table exists
+	if (Stats->WeaponData.bHasAttachments && AttachmentsDataTable)
+	{
+		BarrelAttachment->SetStaticMesh(Stats->GetSlot(EAttachmentType::Barrel).PickupMesh);
+		MagazineAttachment->SetStaticMesh(Stats->GetSlot(EAttachmentType::Magazine).PickupMesh);
+		SightsAttachment->SetStaticMesh(Stats->GetSlot(EAttachmentType::Sights).PickupMesh);
+		StockAttachment->SetStaticMesh(Stats->GetSlot(EAttachmentType::Stock).PickupMesh);
+		GripAttachment->SetStaticMesh(Stats->GetSlot(EAttachmentType::Grip).PickupMesh);
+	}
+
+	// Pulling default values from the magazine attachment, or the weapon itself if it doesn't use attachments
+	if (!bRuntimeSpawned && (Stats->bHasMagazine || !Stats->WeaponData.bHasAttachments || !AttachmentsDataTable))
+	{
+		DataStruct.AmmoType = Stats->AmmoType;
+		DataStruct.ClipCapacity = Stats->ClipCapacity;
+		DataStruct.ClipSize = Stats->ClipSize;
+		DataStruct.WeaponHealth = 100.0f;
 	}
 }
 
@@ -169,7 +138,27 @@ void AWeaponPickup::Interact(AActor* InteractionDelegate)
 		// Spawning the new weapon in the player's inventory component
 		PlayerCharacter->GetInventoryComponent()->UpdateWeapon(WeaponReference, InventoryPosition, SpawnPickup, bStatic, GetActorTransform(),  DataStruct);
 	
-		// Destroying the pickup
-		Destroy();
+		// Returning the pickup to the pool, so that the next weapon dropped can reuse it
+		if (UWeaponPoolSubsystem* WeaponPool = GetWorld()->GetSubsystem<UWeaponPoolSubsystem>())
+		{
+			WeaponPool->ReleasePickup(this);
+		}
+		else
+		{
+			Destroy();
+		}
+	}
+}
+
+void AWeaponPickup::SetPickupActive(const bool bActive)
+{
+	SetActorHiddenInGame(!bActive);
+	SetActorEnableCollision(bActive);
+
+	// Pooled pickups are moved by teleporting, so we make sure they don't carry any velocity back into the world
+	MainMesh->SetSimulatePhysics(false);
+	if (bActive && !bStatic)
+	{
+		MainMesh->SetSimulatePhysics(true);
 	}
 }
\ No newline at end of file
@@ -9,59 +9,36 @@
 #include "Math/UnrealMathUtility.h"
 #include "FPSCharacterController.h"
 #include "FPSCharacter.h"
-#include "AI/AICharacter.h"
-#include "AI/AICharacterController.h"
 #include "Camera/CameraComponent.h"
 #include "Components/SceneCaptureComponent2D.h"
 #include "Isolation/Isolation.h"
-#include "Kismet/KismetMathLibrary.h"
+#include "AI/HearingSubsystem.h"
 #include "Particles/ParticleSystem.h"
+#include "Weapons/DamageBatchSubsystem.h"
+#include "Weapons/ImpactEffectSubsystem.h"
+#include "Weapons/ProjectileSubsystem.h"
+#include "Weapons/ScopeCaptureManager.h"
+#include "Weapons/ShotBatchSubsystem.h"
+#include "Weapons/WeaponAnimationTicker.h"
+#include "Weapons/WeaponStatsCache.h"
 
 void AWeaponBase::SetWeaponDestroyed()
 {
 
     MeshComp->SetSkeletalMesh(WeaponData.DestroyedMesh);
     
-    if (WeaponData.bHasAttachments)
+    if (WeaponData.bHasAttachments && ResolvedStats.IsValid())
     {
-        for (FName RowName : RuntimeWeaponData.WeaponAttachments)
-        {
-            // Going through each of our attachments and updating our static weapon data accordingly
-            AttachmentData = WeaponData.AttachmentsDataTable->FindRow<FAttachmentData>(
-                RowName, RowName.ToString(), true);
-
-            if (AttachmentData)
-            {
-                if (AttachmentData->AttachmentType == EAttachmentType::Barrel)
-                {
-                    BarrelAttachment->SetSkeletalMesh(AttachmentData->AttachmentBrokenMesh);
-                }
-                else if (AttachmentData->AttachmentType == EAttachmentType::Magazine)
-                {
-                    MagazineAttachment->SetSkeletalMesh(AttachmentData->AttachmentBrokenMesh);
-                }
-                else if (AttachmentData->AttachmentType == EAttachmentType::Sights)
-                {
-                    SightsAttachment->SetSkeletalMesh(AttachmentData->AttachmentBrokenMesh);
-                }
-                else if (AttachmentData->AttachmentType == EAttachmentType::Stock)
-                {
-                    StockAttachment->SetSkeletalMesh(AttachmentData->AttachmentBrokenMesh);
-                }
-                else if (AttachmentData->AttachmentType == EAttachmentType::Grip)
-                {
-                    GripAttachment->SetSkeletalMesh(AttachmentData->AttachmentBrokenMesh);
-                }
-            }
-        }
+        // Swapping each of our attachments to its broken mesh
+        ApplyAttachmentMeshes(true);
     }
 }
 
 // Sets default values
 AWeaponBase::AWeaponBase()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+ 	// Recoil is updated by UWeaponAnimationTicker while it is active, so weapons never need to tick themselves
+	PrimaryActorTick.bCanEverTick = false;
 
     // Creating our weapon's skeletal mesh, telling it to not cast shadows and finally setting it as the root of the actor
     MeshComp = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("MeshComp"));
@@ -117,6 +94,14 @@ void AWeaponBase::BeginPlay()
     // Making sure you can't see barrel tips in the scope
     ScopeCaptureComponent->HiddenActors.Add(this);
     
+    // Caching the subsystems that every shot goes through
+    ShotBatchSubsystem = GetWorld()->GetSubsystem<UShotBatchSubsystem>();
+    ProjectileSubsystem = GetWorld()->GetSubsystem<UProjectileSubsystem>();
+    ImpactEffectSubsystem = GetWorld()->GetSubsystem<UImpactEffectSubsystem>();
+    DamageBatchSubsystem = GetWorld()->GetSubsystem<UDamageBatchSubsystem>();
+    AnimationTicker = GetWorld()->GetSubsystem<UWeaponAnimationTicker>();
+    HearingSubsystem = GetWorld()->GetSubsystem<UHearingSubsystem>();
+
     //Sets the default values for our trace query
 	QueryParams.AddIgnoredActor(this);
 	QueryParams.bTraceComplex = true;
@@ -136,10 +121,6 @@ void AWeaponBase::BeginPlay()
             }
             ScopeCaptureComponent->FOVAngle = FOVFromMagnification();
         }
-        if (WeaponData.bIsScope)
-        {
-            GetWorldTimerManager().SetTimer(ScopeRenderTimer, this, &AWeaponBase::RenderScope, 1.0f/ScopeFrameRate, true, 0.0f);
-        }
     }
     
     // Setting our default animation values
@@ -171,136 +152,110 @@ void AWeaponBase::BeginPlay()
     }
 
 
-    // Setting our recoil & recovery curves
-    if (VerticalRecoilCurve)
+    // Baking our recovery curve. The recoil curves depend on our attachments, so are baked with the resolved stats
+    RecoveryTable.Bake(RecoveryCurve);
+}
+
+
+
+void AWeaponBase::SetOwner(AActor* NewOwner)
+{
+    Super::SetOwner(NewOwner);
+
+    // Caching our owner's interface here means that firing never needs to cast to the player or AI
+    WeaponOwner = Cast<IWeaponOwner>(NewOwner);
+}
+
+void AWeaponBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    if (UScopeCaptureManager* ScopeCaptureManager = GetWorld()->GetSubsystem<UScopeCaptureManager>())
     {
-        FOnTimelineFloat VerticalRecoilProgressFunction;
-        VerticalRecoilProgressFunction.BindUFunction(this, FName("HandleVerticalRecoilProgress"));
-        VerticalRecoilTimeline.AddInterpFloat(VerticalRecoilCurve, VerticalRecoilProgressFunction);
+        ScopeCaptureManager->ClearActiveScope(this);
     }
 
-    if (HorizontalRecoilCurve)
+    if (AnimationTicker)
     {
-        FOnTimelineFloat HorizontalRecoilProgressFunction;
-        HorizontalRecoilProgressFunction.BindUFunction(this, FName("HandleHorizontalRecoilProgress"));
-        HorizontalRecoilTimeline.AddInterpFloat(HorizontalRecoilCurve, HorizontalRecoilProgressFunction);
+        AnimationTicker->UnregisterWeapon(this);
     }
 
-    if (RecoveryCurve)
+    Super::EndPlay(EndPlayReason);
+}
+
+void AWeaponBase::SpawnAttachments()
+{
+    ISOLATION_WEAPON_SCOPE(STAT_WeaponSpawnAttachments);
+
+    // Getting the stats for this weapon and attachment combination. These are shared with every other weapon, pickup
+    // and AI using the same attachments, and only resolved from the data tables the first time they are requested
+    ResolvedStats = UWeaponStatsCache::GetStats(this, WeaponDataTable, FName(DataTableNameRef), RuntimeWeaponData.WeaponAttachments);
+    if (!ResolvedStats.IsValid())
     {
-        FOnTimelineFloat RecoveryProgressFunction;
-        RecoveryProgressFunction.BindUFunction(this, FName("HandleRecoveryProgress"));
-        RecoilRecoveryTimeline.AddInterpFloat(RecoveryCurve, RecoveryProgressFunction);
+        return;
     }
-}
 
+    const FResolvedWeaponStats& Stats = *ResolvedStats;
 
+    WeaponData = Stats.WeaponData;
+    DamageModifier = Stats.DamageModifier;
+    WeaponPitchModifier = Stats.WeaponPitchModifier;
+    WeaponYawModifier = Stats.WeaponYawModifier;
+    HorizontalRecoilModifier = Stats.HorizontalRecoilModifier;
+    VerticalRecoilModifier = Stats.VerticalRecoilModifier;
 
-void AWeaponBase::SpawnAttachments()
-{
-    if (WeaponData.bHasAttachments)
+    // Pre-warming our impact effects so that the first shots don't have to create their components
+    if (ImpactEffectSubsystem)
     {
-        for (FName RowName : RuntimeWeaponData.WeaponAttachments)
+        ImpactEffectSubsystem->WarmPool(WeaponData.DefaultHitEffect);
+        for (const TPair<const UPhysicalMaterial*, UNiagaraSystem*>& SurfaceEffect : Stats.ImpactEffects)
         {
-            // Going through each of our attachments and updating our static weapon data accordingly
-            AttachmentData = WeaponData.AttachmentsDataTable->FindRow<FAttachmentData>(RowName, RowName.ToString(), true);
+            ImpactEffectSubsystem->WarmPool(SurfaceEffect.Value);
+        }
+    }
 
-            if (AttachmentData)
-            {
-                DamageModifier += AttachmentData->BaseDamageImpact;
-                WeaponPitchModifier += AttachmentData->WeaponPitchVariationImpact;
-                WeaponYawModifier += AttachmentData->WeaponYawVariationImpact;
-                HorizontalRecoilModifier += AttachmentData->HorizontalRecoilMultiplier;
-                VerticalRecoilModifier += AttachmentData->VerticalRecoilMultiplier;
+    // Only overriding the animations the row or its attachments supply, so the class defaults remain as a fallback
+    if (Stats.WeaponEquip)
+    {
+        WeaponEquip = Stats.WeaponEquip;
+    }
+    if (Stats.WalkBlendSpace)
+    {
+        WalkBlendSpace = Stats.WalkBlendSpace;
+    }
+    if (Stats.ADSWalkBlendSpace)
+    {
+        ADSWalkBlendSpace = Stats.ADSWalkBlendSpace;
+    }
+    if (Stats.Anim_Idle)
+    {
+        Anim_Idle = Stats.Anim_Idle;
+    }
+    if (Stats.Anim_Sprint)
+    {
+        Anim_Sprint = Stats.Anim_Sprint;
+    }
+    if (Stats.Anim_ADS_Idle)
+    {
+        Anim_ADS_Idle = Stats.Anim_ADS_Idle;
+    }
 
-                if (AttachmentData->AttachmentType == EAttachmentType::Barrel)
-                {
+    if (WeaponData.bHasAttachments)
+    {
+        ApplyAttachmentMeshes(false);
 
-                    BarrelAttachment->SetSkeletalMesh(AttachmentData->AttachmentMesh);
-                    WeaponData.MuzzleLocation = AttachmentData->MuzzleLocationOverride;
-                    WeaponData.ParticleSpawnLocation = AttachmentData->ParticleSpawnLocationOverride;
-                    WeaponData.bSilenced = AttachmentData->bSilenced;
-                }
-                else if (AttachmentData->AttachmentType == EAttachmentType::Magazine)
-                {
-                    MagazineAttachment->SetSkeletalMesh(AttachmentData->AttachmentMesh);
-                    WeaponData.FireSound = AttachmentData->FiringSoundOverride;
-                    WeaponData.SilencedSound = AttachmentData->SilencedFiringSoundOverride;
-                    WeaponData.RateOfFire = AttachmentData->FireRate;
-                    WeaponData.bAutomaticFire = AttachmentData->AutomaticFire;
-                    WeaponData.PerShotDegradation = AttachmentData->PerShotDegradation;
-                    WeaponData.VerticalRecoilCurve = AttachmentData->VerticalRecoilCurve;
-                    WeaponData.HorizontalRecoilCurve = AttachmentData->HorizontalRecoilCurve;
-                    WeaponData.RecoilCameraShake = AttachmentData->RecoilCameraShake;
-                    WeaponData.bIsShotgun = AttachmentData->bIsShotgun;
-                    WeaponData.ShotgunRange = AttachmentData->ShotgunRange;
-                    WeaponData.ShotgunPellets = AttachmentData->ShotgunPellets;
-                    WeaponData.EmptyWeaponReload = AttachmentData->EmptyWeaponReload;
-                    WeaponData.WeaponReload = AttachmentData->WeaponReload;
-                    WeaponData.EmptyPlayerReload = AttachmentData->EmptyPlayerReload;
-                    WeaponData.PlayerReload = AttachmentData->PlayerReload;
-                    WeaponData.Gun_Shot = AttachmentData->Gun_Shot;
-                    WeaponData.WeaponDestroyedHandsAnim = AttachmentData->WeaponDestroyedHandsAnim;
-                    WeaponData.WeaponDestroyedParticleSystem = AttachmentData->WeaponDestroyedParticleSystem;
-                    WeaponData.AccuracyDebuff = AttachmentData->AccuracyDebuff;
-                    WeaponData.AiWeaponData = AttachmentData->AiWeaponData;
-                    RuntimeWeaponData.ClipSize = AttachmentData->ClipSize;
-                }
-                else if (AttachmentData->AttachmentType == EAttachmentType::Sights)
-                {
-                    SightsAttachment->SetSkeletalMesh(AttachmentData->AttachmentMesh);
-                    VerticalCameraOffset = AttachmentData->VerticalCameraOffset;
-                    WeaponData.bAimingFOV = AttachmentData->bAimingFOV;
-                    WeaponData.AimingFOVChange = AttachmentData->AimingFOVChange;
-                    WeaponData.bIsScope = AttachmentData->bIsScope;
-                    WeaponData.ScopeMagnification = AttachmentData->ScopeMagnification;
-                    WeaponData.UnmagnifiedLFoV = AttachmentData->UnmagnifiedLFoV;
-                    if (WeaponData.bIsScope)
-                    {
-                        if (bShowDebug)
-                        {
-                            GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, FString::SanitizeFloat(FOVFromMagnification()));
-                        }
-                        ScopeCaptureComponent->FOVAngle = FOVFromMagnification();
-                    }
-                    if (WeaponData.bIsScope)
-                    {
-                        GetWorldTimerManager().SetTimer(ScopeRenderTimer, this, &AWeaponBase::RenderScope, 1.0f/ScopeFrameRate, true, 0.0f);
-                    }
-                }
-                else if (AttachmentData->AttachmentType == EAttachmentType::Stock)
-                {
-                    StockAttachment->SetSkeletalMesh(AttachmentData->AttachmentMesh);
-                }
-                else if (AttachmentData->AttachmentType == EAttachmentType::Grip)
-                {
-                    GripAttachment->SetSkeletalMesh(AttachmentData->AttachmentMesh);
-                    if (AttachmentData->WeaponEquip)
-                    {
-                        WeaponEquip = AttachmentData->WeaponEquip;
-                    }
-                    if (AttachmentData->BS_Walk)
-                    {
-                        WalkBlendSpace = AttachmentData->BS_Walk;
-                    }
-                    if (AttachmentData->BS_Ads_Walk)
-                    {
-                        ADSWalkBlendSpace = AttachmentData->BS_Ads_Walk;
-                    }
-                    if (AttachmentData->Anim_Idle)
-                    {
-                        Anim_Idle = AttachmentData->Anim_Idle;
-                    }
-                    if (AttachmentData->Anim_Sprint)
-                    {
-                        Anim_Sprint = AttachmentData->Anim_Sprint;
-                    }
-                    if (AttachmentData->Anim_Ads_Idle)
-                    {
-                        Anim_ADS_Idle = AttachmentData->Anim_Ads_Idle;
-                    }
-                }
+        VerticalCameraOffset = Stats.VerticalCameraOffset;
+
+        if (Stats.bHasMagazine)
+        {
+            RuntimeWeaponData.ClipSize = Stats.ClipSize;
+        }
+
+        if (WeaponData.bIsScope)
+        {
+            if (bShowDebug)
+            {
+                GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, FString::SanitizeFloat(FOVFromMagnification()));
             }
+            ScopeCaptureComponent->FOVAngle = FOVFromMagnification();
         }
     }
 }
@@ -323,36 +278,32 @@ void AWeaponBase::StartFire()
     
 }
 
-void AWeaponBase::ScheduleAiFire()
+void AWeaponBase::BeginAiFire()
 {
-    if (bCanFire)
-    {
-        // sets a timer for firing the weapon - if bAutomaticFire is true then this timer will repeat until cleared by StopFire(), leading to fully automatic fire
-        GetWorldTimerManager().SetTimer(ShotDelay, this, &AWeaponBase::AiFire, 60/WeaponData.AiWeaponData.AiRateOfFire, true, 0.0f);
-
-        WeaponData.AiWeaponData.AiPitchVariation = WeaponData.AiWeaponData.MaxAiPitchVariation;
-        WeaponData.AiWeaponData.AiYawVariation = WeaponData.AiWeaponData.MaxAiYawVariation;
+    // AI accuracy improves the longer they fire, so each new burst starts from the least accurate
+    WeaponData.AiWeaponData.AiPitchVariation = WeaponData.AiWeaponData.MaxAiPitchVariation;
+    WeaponData.AiWeaponData.AiYawVariation = WeaponData.AiWeaponData.MaxAiYawVariation;
 
-        if (bShowDebug)
-        {
-            GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Orange, TEXT("Started firing timer"));
-        }
+    if (bShowDebug)
+    {
+        GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Orange, TEXT("Began AI fire"));
     }
 }
 
 void AWeaponBase::StartRecoil()
 {
-    const AFPSCharacter* PlayerCharacter = Cast<AFPSCharacter>(UGameplayStatics::GetPlayerCharacter(GetWorld(), 0));
-    const AFPSCharacterController* CharacterController = Cast<AFPSCharacterController>(PlayerCharacter->GetController());
+    // Caching the controller of the player holding us, so that we don't have to find it for every shot
+    const APawn* OwnerPawn = Cast<APawn>(GetOwner());
+    RecoilController = OwnerPawn ? Cast<AFPSCharacterController>(OwnerPawn->GetController()) : nullptr;
 
     ShotsFired = 0;
     
-    if (bCanFire && RuntimeWeaponData.ClipSize > 0 && !bIsReloading && CharacterController)
+    if (bCanFire && RuntimeWeaponData.ClipSize > 0 && !bIsReloading && RecoilController.IsValid())
     {
-        // Plays the recoil timelines and saves the current control rotation in order to recover to it
-        VerticalRecoilTimeline.PlayFromStart();
-        HorizontalRecoilTimeline.PlayFromStart();
-        ControlRotation = CharacterController->GetControlRotation();
+        // Starts indexing the recoil tables and saves the current control rotation in order to recover to it
+        SetRecoilState(EWeaponRecoilState::Firing);
+        RecoilTime = 0.0f;
+        ControlRotation = RecoilController->GetControlRotation();
         bShouldRecover = true;
     }
 }
@@ -367,447 +318,478 @@ void AWeaponBase::StopFire()
 {
     // Stops the gun firing (for automatic fire)
     GetWorldTimerManager().ClearTimer(ShotDelay);
-    VerticalRecoilTimeline.Stop();
-    HorizontalRecoilTimeline.Stop();
     RecoilRecovery();
 }
 
 void AWeaponBase::Fire()
-{    
-    // Casting to the game instance (which stores all the ammunition and health variables)
-    const AFPSCharacter* PlayerCharacter = Cast<AFPSCharacter>(UGameplayStatics::GetPlayerCharacter(GetWorld(), 0));
-    
+{
+    ISOLATION_WEAPON_SCOPE(STAT_WeaponFire);
+
+    // Our owner's interface is cached when our owner is set, so firing never has to look for the player or the AI
+    if (!WeaponOwner || !IsValid(GetOwner()))
+    {
+        GetWorldTimerManager().ClearTimer(ShotDelay);
+        return;
+    }
+
     // Allowing the gun to fire if it has ammunition, is not reloading and the bCanFire variable is true
-    if(bCanFire && RuntimeWeaponData.ClipSize > 0 && !bIsReloading)
+    if (bCanFire && RuntimeWeaponData.ClipSize > 0 && !bIsReloading)
     {
+        // Gathering the aim and spread for this shot from our owner, AI won't fire without a target
+        FShotRequest Request;
+        if (!BuildShotRequest(Request))
+        {
+            return;
+        }
+
         // Printing debug strings
-        if(bShowDebug)
+        if (bShowDebug)
         {
-            GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, "Fire", true);
-            GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Green, FString::FromInt(RuntimeWeaponData.ClipSize > 0 && !bIsReloading), true);
+            GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, Request.bAiShot ? "Ai Fire" : "Fire", true);
         }
-        
+
+        ISOLATION_WEAPON_COUNTER(STAT_WeaponShots, 1);
+        ISOLATION_WEAPON_COUNTER(STAT_WeaponPellets, Request.NumPellets);
 
         // Subtracting from the ammunition count of the weapon
         RuntimeWeaponData.ClipSize -= 1;
 
-        const int NumberOfShots = WeaponData.bIsShotgun? WeaponData.ShotgunPellets : 1;
-        // We run this for the number of bullets/projectiles per shot, in order to support shotguns
-        for (int i = 0; i < NumberOfShots; i++)
+        // Playing an animation on the weapon mesh
+        if (WeaponData.Gun_Shot)
         {
-            // Calculating the start and end points of our line trace, and applying randomised variation
-            TraceStart = PlayerCharacter->GetCameraComponent()->GetComponentLocation();
-            TraceStartRotation = PlayerCharacter->GetCameraComponent()->GetComponentRotation();
-
-            float AccuracyMultiplier = 1.0f;
-            if (!PlayerCharacter->IsPlayerAiming())
-            {
-                AccuracyMultiplier = WeaponData.AccuracyDebuff;
-            }
-            
-            TraceStartRotation.Pitch += FMath::FRandRange(
-                -((WeaponData.WeaponPitchVariation + WeaponPitchModifier) * AccuracyMultiplier),
-                (WeaponData.WeaponPitchVariation + WeaponPitchModifier) * AccuracyMultiplier);
-            TraceStartRotation.Yaw += FMath::FRandRange(
-                -((WeaponData.WeaponYawVariation + WeaponYawModifier) * AccuracyMultiplier),
-                (WeaponData.WeaponYawVariation + WeaponYawModifier) * AccuracyMultiplier);
-            TraceDirection = TraceStartRotation.Vector();
-            TraceEnd = TraceStart + (TraceDirection * (WeaponData.bIsShotgun
-                                                           ? WeaponData.ShotgunRange
-                                                           : WeaponData.LengthMultiplier));
-            
+            MeshComp->PlayAnimation(WeaponData.Gun_Shot, false);
+        }
 
-            // Applying Recoil to the weapon
+        // We run this for the number of bullets/projectiles per shot, in order to support shotguns
+        for (int32 PelletIndex = 0; PelletIndex < Request.NumPellets; PelletIndex++)
+        {
+            // Applying Recoil to the weapon (only the player's controller is cached for recoil)
             Recoil();
 
-            // Playing an animation on the weapon mesh
-            if (WeaponData.Gun_Shot)
-            {
-                MeshComp->PlayAnimation(WeaponData.Gun_Shot, false);
-            }
-
-            FVector EndPoint = TraceEnd;
-
-            // Drawing a line trace based on the parameters calculated previously 
-            if(GetWorld()->LineTraceSingleByChannel(Hit, TraceStart, TraceEnd, WEAPON_TRACE, QueryParams))
-            {                
-                // Drawing debug line trace
-                if (bShowDebug)
-                {
-                    DrawDebugLine(
-                        GetWorld(), (WeaponData.bHasAttachments
-                                         ? BarrelAttachment->GetSocketLocation(WeaponData.MuzzleLocation)
-                                         : MeshComp->GetSocketLocation(WeaponData.MuzzleLocation)), Hit.Location,
-                        FColor::Red, false, 10.0f, 0.0f, 2.0f);
-                }
-                
-                // Resetting finalDamage
-                FinalDamage = 0.0f;
-
-                // Setting finalDamage based on the type of surface hit
-                FinalDamage = (WeaponData.BaseDamage + DamageModifier);
-                
-                if (Hit.PhysMaterial.Get() == WeaponData.HeadshotDamageSurface)
-                {
-                    FinalDamage = (WeaponData.BaseDamage + DamageModifier) * WeaponData.HeadshotMultiplier;
-                }
-
-                AActor* HitActor = Hit.GetActor();
-
-                // Applying the previously set damage to the hit actor
-                UGameplayStatics::ApplyPointDamage(HitActor, FinalDamage, TraceDirection, Hit,
-                                                   GetInstigatorController(), this, DamageType);
-
-                EndPoint = Hit.Location;
-            }
-            else
-            {
-                // Drawing debug line trace
-                if (bShowDebug)
-                {
-                    DrawDebugLine(
-                        GetWorld(), (WeaponData.bHasAttachments
-                                         ? BarrelAttachment->GetSocketLocation(WeaponData.MuzzleLocation)
-                                         : MeshComp->GetSocketLocation(WeaponData.MuzzleLocation)), TraceEnd,
-                        FColor::Red, false, 10.0f, 0.0f, 2.0f);
-                }
-            }
-
-            const FRotator ParticleRotation = (EndPoint - (WeaponData.bHasAttachments
-                                                               ? BarrelAttachment->GetSocketLocation(
-                                                                   WeaponData.MuzzleLocation)
-                                                               : MeshComp->GetSocketLocation(
-                                                                   WeaponData.MuzzleLocation))).Rotation();
-            
-            // Spawning the bullet trace particle effect
-            if (WeaponData.bHasAttachments)
-            {
-                UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), WeaponData.BulletTrace,
-                                                         BarrelAttachment->GetSocketLocation(
-                                                             WeaponData.ParticleSpawnLocation), ParticleRotation);
-            }
-            else
-            {
-                UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), WeaponData.BulletTrace,
-                                                         MeshComp->GetSocketLocation(WeaponData.ParticleSpawnLocation),
-                                                         ParticleRotation);
-            }
-
-            // Selecting the hit effect based on the hit physical surface material (hit.PhysMaterial.Get()) and spawning it (Niagara)
-
-            if (Hit.PhysMaterial.Get() == WeaponData.NormalDamageSurface || Hit.PhysMaterial.Get() == WeaponData.HeadshotDamageSurface)
-            {
-                UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), WeaponData.EnemyHitEffect, Hit.ImpactPoint,
-                                                               Hit.ImpactNormal.Rotation());
-            }
-            else if (Hit.PhysMaterial.Get() == WeaponData.GroundSurface)
-            {
-                UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), WeaponData.GroundHitEffect, Hit.ImpactPoint,
-                                                               Hit.ImpactNormal.Rotation());
-            }
-            else if (Hit.PhysMaterial.Get() == WeaponData.RockSurface)
-            {
-                UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), WeaponData.RockHitEffect, Hit.ImpactPoint,
-                                                               Hit.ImpactNormal.Rotation());
-            }
-            else
-            {
-                UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), WeaponData.DefaultHitEffect, Hit.ImpactPoint,
-                                                               Hit.ImpactNormal.Rotation());
-            }
+            TraceShot(ApplySpread(Request));
         }
 
-        // Spawning the muzzle flash particle
-        if (WeaponData.bHasAttachments)
-        {
-            UGameplayStatics::SpawnEmitterAttached(WeaponData.MuzzleFlash, BarrelAttachment,
-                                                   WeaponData.ParticleSpawnLocation, FVector::ZeroVector,
-                                                   BarrelAttachment->
-                                                   GetSocketRotation(WeaponData.ParticleSpawnLocation),
-                                                   FVector::OneVector);
-        }
-        else
-        {
-            UGameplayStatics::SpawnEmitterAttached(WeaponData.MuzzleFlash, MeshComp, WeaponData.ParticleSpawnLocation,
-                                                   FVector::ZeroVector,
-                                                   MeshComp->GetSocketRotation(WeaponData.ParticleSpawnLocation),
-                                                   FVector::OneVector);
-        }
+        PlayFireEffects(Request);
 
-        // Spawning the firing sound
-        if(WeaponData.bSilenced)
+        if (Request.bAiShot)
         {
-            UGameplayStatics::PlaySoundAtLocation(GetWorld(), WeaponData.SilencedSound, TraceStart);
+            // Updating Ai Accuracy
+            WeaponData.AiWeaponData.AiPitchVariation = FMath::Clamp(WeaponData.AiWeaponData.AiPitchVariation - WeaponData.AiWeaponData.PerShotAccuracyImprovement, WeaponData.AiWeaponData.MinAiPitchVariation, WeaponData.AiWeaponData.MaxAiPitchVariation);
+            WeaponData.AiWeaponData.AiYawVariation = FMath::Clamp(WeaponData.AiWeaponData.AiYawVariation - WeaponData.AiWeaponData.PerShotAccuracyImprovement, WeaponData.AiWeaponData.MinAiYawVariation, WeaponData.AiWeaponData.MaxAiYawVariation);
         }
-        else
-        {
-            UGameplayStatics::PlaySoundAtLocation(GetWorld(), WeaponData.FireSound, TraceStart);
-        }
-
-
-        // Spawning the ejection bullets
-        FRotator EjectionSpawnVector = FRotator::ZeroRotator;
-        EjectionSpawnVector.Yaw = 270.0f;
-        UNiagaraFunctionLibrary::SpawnSystemAttached(EjectedCasing, MagazineAttachment, FName("ejection_port"),
-                                                     FVector::ZeroVector, EjectionSpawnVector,
-                                                     EAttachLocation::SnapToTarget, true, true);
 
-        // Stopping the recoil timelines if we don't have automatic fire
+        // Stopping the recoil if we don't have automatic fire
         if (!WeaponData.bAutomaticFire)
         {
-            VerticalRecoilTimeline.Stop();
-            HorizontalRecoilTimeline.Stop();
             RecoilRecovery();
         }
 
         // Applying weapon damage
-        RuntimeWeaponData.WeaponHealth -= WeaponData.PerShotDegradation;
-        if (RuntimeWeaponData.WeaponHealth <= 0)
+        if (!Request.bAiShot)
         {
-           PlayerCharacter->GetInventoryComponent()->BeginDestroyCurrentWeapon(WeaponData.WeaponDestroyedHandsAnim, WeaponData.WeaponDestroyedParticleSystem); 
+            RuntimeWeaponData.WeaponHealth -= WeaponData.PerShotDegradation;
+            if (RuntimeWeaponData.WeaponHealth <= 0)
+            {
+                WeaponOwner->OnWeaponBroken(this);
+            }
         }
     }
     else if (bCanFire && !bIsReloading)
     {
-        UGameplayStatics::PlaySoundAtLocation(GetWorld(), WeaponData.EmptyFireSound, MeshComp->GetSocketLocation(WeaponData.MuzzleLocation));
+        UGameplayStatics::PlaySoundAtLocation(GetWorld(), WeaponData.EmptyFireSound, GetMuzzleLocation());
+        if (WeaponOwner->IsAiWeaponOwner())
+        {
+            WeaponIsEmpty();
+        }
         // Clearing the ShotDelay timer so that we don't have a constant ticking when the player has no ammo, just a single click
         GetWorldTimerManager().ClearTimer(ShotDelay);
 
         RecoilRecovery();
     }
-    
 }
 
-void AWeaponBase::AiFire()
+bool AWeaponBase::BuildShotRequest(FShotRequest& OutRequest) const
 {
-    GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Orange, TEXT("Called Ai fire in WeaponBase"));
-    
-    // Casting to the game instance (which stores all the ammunition and health variables)
-    AActor* TargetActor = Cast<AAICharacterController>(Cast<AAICharacter>(GetOwner())->GetController())->GetTargetActor();
-    AAICharacter* OwnerCharacter = Cast<AAICharacter>(GetOwner());
+    if (!WeaponOwner->GetShotAim(this, OutRequest.Origin, OutRequest.AimRotation))
+    {
+        return false;
+    }
 
-    GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, FString::FromInt(RuntimeWeaponData.ClipSize));
-    
-    // Allowing the gun to fire if it has ammunition, is not reloading and the bCanFire variable is true
-    if(!bIsReloading && IsValid(TargetActor) && IsValid(OwnerCharacter) && RuntimeWeaponData.ClipSize > 0)
-    {        
-        // Printing debug strings
-        if(bShowDebug)
-        {
-            GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, "Ai Fire", true);
-        }
+    OutRequest.bAiShot = WeaponOwner->IsAiWeaponOwner();
+    OutRequest.NumPellets = GetPelletsPerShot();
+    OutRequest.Range = WeaponData.bIsShotgun ? WeaponData.ShotgunRange : WeaponData.LengthMultiplier;
 
-        RuntimeWeaponData.ClipSize -= 1;
+    if (OutRequest.bAiShot)
+    {
+        // AI accuracy improves the longer they fire, see AiWeaponData
+        OutRequest.SpreadPitch = WeaponData.AiWeaponData.AiPitchVariation + WeaponPitchModifier;
+        OutRequest.SpreadYaw = WeaponData.AiWeaponData.AiYawVariation + WeaponYawModifier;
+        OutRequest.TraceChannel = ENEMYWEAPON_TRACE;
+    }
+    else
+    {
+        // The player is less accurate when they aren't aiming down the sights
+        const float AccuracyMultiplier = WeaponOwner->IsAimingWeapon() ? 1.0f : WeaponData.AccuracyDebuff;
+        OutRequest.SpreadPitch = (WeaponData.WeaponPitchVariation + WeaponPitchModifier) * AccuracyMultiplier;
+        OutRequest.SpreadYaw = (WeaponData.WeaponYawVariation + WeaponYawModifier) * AccuracyMultiplier;
+        OutRequest.TraceChannel = WEAPON_TRACE;
+    }
 
-        const int NumberOfShots = WeaponData.bIsShotgun? WeaponData.ShotgunPellets : 1;
-        // We run this for the number of bullets/projectiles per shot, in order to support shotguns
-        for (int i = 0; i < NumberOfShots; i++)
-        {
-            // Calculating the start and end points of our line trace, and applying randomised variation
-            TraceStart = WeaponData.bHasAttachments? BarrelAttachment->GetSocketLocation(WeaponData.MuzzleLocation) : MeshComp->GetSocketLocation(WeaponData.MuzzleLocation); 
-            TraceStartRotation = UKismetMathLibrary::FindLookAtRotation(MeshComp->GetSocketLocation(WeaponData.MuzzleLocation), TargetActor->GetActorLocation()); 
-
-            TraceStartRotation.Pitch += FMath::FRandRange(
-                -((WeaponData.AiWeaponData.AiPitchVariation + WeaponPitchModifier)),
-                (WeaponData.AiWeaponData.AiPitchVariation + WeaponPitchModifier));
-            TraceStartRotation.Yaw += FMath::FRandRange(
-                -((WeaponData.AiWeaponData.AiYawVariation + WeaponYawModifier)),
-                (WeaponData.AiWeaponData.AiYawVariation + WeaponYawModifier));
-            TraceDirection = TraceStartRotation.Vector();
-            TraceEnd = TraceStart + (TraceDirection * (WeaponData.bIsShotgun
-                                                           ? WeaponData.ShotgunRange
-                                                           : WeaponData.LengthMultiplier));
-            
+    return true;
+}
 
-            // Playing an animation on the weapon mesh
-            if (WeaponData.Gun_Shot)
-            {
-                MeshComp->PlayAnimation(WeaponData.Gun_Shot, false);
-            }
+FQueuedShot AWeaponBase::ApplySpread(const FShotRequest& Request)
+{
+    // Applying randomised variation to the aim direction and calculating the end point of the pellet's trace
+    FRotator PelletRotation = Request.AimRotation;
+    PelletRotation.Pitch += FMath::FRandRange(-Request.SpreadPitch, Request.SpreadPitch);
+    PelletRotation.Yaw += FMath::FRandRange(-Request.SpreadYaw, Request.SpreadYaw);
+
+    FQueuedShot Shot;
+    Shot.Weapon = this;
+    Shot.TraceStart = Request.Origin;
+    Shot.TraceDirection = PelletRotation.Vector();
+    Shot.TraceEnd = Request.Origin + Shot.TraceDirection * Request.Range;
+    Shot.TraceChannel = Request.TraceChannel;
+    Shot.bAiShot = Request.bAiShot;
+    // AI shots return overlaps along their path, so that we can play flyby sounds to the player
+    Shot.bMultiTrace = Request.bAiShot;
+    return Shot;
+}
 
-            FVector EndPoint = TraceEnd;
-            
-            // Drawing a line trace based on the parameters calculated previously 
-            GetWorld()->LineTraceMultiByChannel(AiHitResults, TraceStart, TraceEnd, ENEMYWEAPON_TRACE, QueryParams);
-            
-            for (FHitResult AiHit : AiHitResults)
-            {
-                if (AiHit.bBlockingHit)
-                {
-                    // Drawing debug line trace
-                    if (bShowDebug)
-                    {
-                        DrawDebugLine(
-                            GetWorld(), (WeaponData.bHasAttachments
-                                             ? BarrelAttachment->GetSocketLocation(WeaponData.MuzzleLocation)
-                                             : MeshComp->GetSocketLocation(WeaponData.MuzzleLocation)), AiHit.Location,
-                            FColor::Red, false, 10.0f, 0.0f, 2.0f);
-                    }
-            
-                    if (AiHit.PhysMaterial.Get() == WeaponData.HeadshotDamageSurface)
-                    {
-                        FinalDamage = (WeaponData.BaseDamage + DamageModifier) * WeaponData.HeadshotMultiplier;
-                    }
+void AWeaponBase::TraceShot(const FQueuedShot& Shot)
+{
+    // Projectile weapons hand the shot to the projectile simulation, which resolves it once the round hits
+    if (WeaponData.bUseProjectiles && ProjectileSubsystem)
+    {
+        FireProjectile(Shot);
+        return;
+    }
 
-                    AActor* HitActor = AiHit.GetActor();
+    // AI shots are always batched, while player shots are traced immediately by default so that hit feedback isn't
+    // delayed by a frame
+    if (ShotBatchSubsystem && (Shot.bAiShot || !bSynchronousPlayerTraces))
+    {
+        ShotBatchSubsystem->QueueShot(Shot);
+        return;
+    }
 
-                    // Applying the previously set damage to the hit actor
-                    UGameplayStatics::ApplyPointDamage(HitActor, WeaponData.AiWeaponData.AiDamage, TraceDirection, AiHit,
-                                                       GetInstigatorController(), this, DamageType);
+    ISOLATION_WEAPON_SCOPE(STAT_WeaponTrace);
+    ISOLATION_WEAPON_COUNTER(STAT_WeaponTraces, 1);
 
-                    EndPoint = AiHit.Location;
-                }
-                else
-                {
-                    Cast<AFPSCharacter>(AiHit.Actor)->PlayFlybySounds(AiHit);
-                    // Drawing debug line trace
-                    if (bShowDebug)
-                    {
-                        DrawDebugLine(
-                            GetWorld(), (WeaponData.bHasAttachments
-                                             ? BarrelAttachment->GetSocketLocation(WeaponData.MuzzleLocation)
-                                             : MeshComp->GetSocketLocation(WeaponData.MuzzleLocation)), TraceEnd,
-                            FColor::Red, false, 10.0f, 0.0f, 2.0f);
-                    }
-                }
-            }
-            
+    TraceHitResults.Reset();
+    if (Shot.bMultiTrace)
+    {
+        GetWorld()->LineTraceMultiByChannel(TraceHitResults, Shot.TraceStart, Shot.TraceEnd, Shot.TraceChannel, QueryParams);
+    }
+    else if (GetWorld()->LineTraceSingleByChannel(Hit, Shot.TraceStart, Shot.TraceEnd, Shot.TraceChannel, QueryParams))
+    {
+        TraceHitResults.Add(Hit);
+    }
+    ResolveShot(Shot, TraceHitResults);
+}
 
-            const FRotator ParticleRotation = (EndPoint - (WeaponData.bHasAttachments
-                                                               ? BarrelAttachment->GetSocketLocation(
-                                                                   WeaponData.MuzzleLocation)
-                                                               : MeshComp->GetSocketLocation(
-                                                                   WeaponData.MuzzleLocation))).Rotation();
-            
-            // Spawning the bullet trace particle effect
-            if (WeaponData.bHasAttachments)
-            {
-                UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), WeaponData.BulletTrace,
-                                                         BarrelAttachment->GetSocketLocation(
-                                                             WeaponData.ParticleSpawnLocation), ParticleRotation);
-            }
-            else
-            {
-                UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), WeaponData.BulletTrace,
-                                                         MeshComp->GetSocketLocation(WeaponData.ParticleSpawnLocation),
-                                                         ParticleRotation);
-            }
+void AWeaponBase::PlayFireEffects(const FShotRequest& Request)
+{
+    ISOLATION_WEAPON_SCOPE(STAT_WeaponVFX);
 
-            // Selecting the hit effect based on the hit physical surface material (hit.PhysMaterial.Get()) and spawning it (Niagara)
+    // Spawning the muzzle flash particle
+    if (WeaponData.bHasAttachments)
+    {
+        UGameplayStatics::SpawnEmitterAttached(WeaponData.MuzzleFlash, GetBarrelComponent(),
+                                               WeaponData.ParticleSpawnLocation, FVector::ZeroVector,
+                                               GetBarrelComponent()->
+                                               GetSocketRotation(WeaponData.ParticleSpawnLocation),
+                                               FVector::OneVector);
+    }
+    else
+    {
+        UGameplayStatics::SpawnEmitterAttached(WeaponData.MuzzleFlash, MeshComp, WeaponData.ParticleSpawnLocation,
+                                               FVector::ZeroVector,
+                                               MeshComp->GetSocketRotation(WeaponData.ParticleSpawnLocation),
+                                               FVector::OneVector);
+    }
+
+    // Spawning the firing sound
+    {
+        ISOLATION_WEAPON_SCOPE(STAT_WeaponAudio);
+        UGameplayStatics::PlaySoundAtLocation(GetWorld(), WeaponData.bSilenced ? WeaponData.SilencedSound : WeaponData.FireSound,
+                                              Request.Origin);
+    }
+
+    // Letting nearby AI hear the shot. Silenced weapons carry a quarter of the distance
+    if (HearingSubsystem)
+    {
+        HearingSubsystem->PostNoise(ENoiseType::Gunshot, Request.Origin, GetOwner(), WeaponData.bSilenced ? 0.25f : 1.0f);
+    }
+
+    // Spawning the ejection bullets
+    FRotator EjectionSpawnVector = FRotator::ZeroRotator;
+    EjectionSpawnVector.Yaw = 270.0f;
+    UNiagaraFunctionLibrary::SpawnSystemAttached(EjectedCasing, GetMagazineComponent(), FName("ejection_port"),
+                                                 FVector::ZeroVector, EjectionSpawnVector,
+                                                 EAttachLocation::SnapToTarget, true, true);
+}
 
-            if (Hit.PhysMaterial.Get() == WeaponData.NormalDamageSurface || Hit.PhysMaterial.Get() == WeaponData.HeadshotDamageSurface)
+void AWeaponBase::ResolveShot(const FQueuedShot& Shot, const TArray<FHitResult>& HitResults)
+{
+    const FShotResult Result = ApplyShotDamage(Shot, HitResults);
+    PlayShotEffects(Shot, Result);
+}
+
+FShotResult AWeaponBase::ApplyShotDamage(const FQueuedShot& Shot, const TArray<FHitResult>& HitResults)
+{
+    ISOLATION_WEAPON_SCOPE(STAT_WeaponDamage);
+
+    FShotResult Result;
+    Result.EndPoint = Shot.TraceEnd;
+
+    for (const FHitResult& ShotHit : HitResults)
+    {
+        if (ShotHit.bBlockingHit)
+        {
+            // AI deal a flat amount of damage, while the player's damage depends on attachments and the surface hit
+            if (Shot.bAiShot)
             {
-                UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), WeaponData.EnemyHitEffect, Hit.ImpactPoint,
-                                                               Hit.ImpactNormal.Rotation());
+                FinalDamage = WeaponData.AiWeaponData.AiDamage;
             }
-            else if (Hit.PhysMaterial.Get() == WeaponData.GroundSurface)
+            else
             {
-                UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), WeaponData.GroundHitEffect, Hit.ImpactPoint,
-                                                               Hit.ImpactNormal.Rotation());
+                FinalDamage = (WeaponData.BaseDamage + DamageModifier);
+
+                if (ShotHit.PhysMaterial.Get() == WeaponData.HeadshotDamageSurface)
+                {
+                    FinalDamage = (WeaponData.BaseDamage + DamageModifier) * WeaponData.HeadshotMultiplier;
+                }
             }
-            else if (Hit.PhysMaterial.Get() == WeaponData.RockSurface)
+
+            // Applying the previously set damage to the hit actor. Hits are batched so that each victim takes damage
+            // once per frame rather than once per pellet
+            if (DamageBatchSubsystem)
             {
-                UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), WeaponData.RockHitEffect, Hit.ImpactPoint,
-                                                               Hit.ImpactNormal.Rotation());
+                DamageBatchSubsystem->QueuePointDamage(ShotHit.GetActor(), FinalDamage, Shot.TraceDirection, ShotHit,
+                                                       GetInstigatorController(), this, DamageType);
             }
             else
             {
-                UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), WeaponData.DefaultHitEffect, Hit.ImpactPoint,
-                                                               Hit.ImpactNormal.Rotation());
+                UGameplayStatics::ApplyPointDamage(ShotHit.GetActor(), FinalDamage, Shot.TraceDirection, ShotHit,
+                                                   GetInstigatorController(), this, DamageType);
             }
-        }
 
-        // Updating Ai Accuracy
-        WeaponData.AiWeaponData.AiPitchVariation = FMath::Clamp(WeaponData.AiWeaponData.AiPitchVariation - WeaponData.AiWeaponData.PerShotAccuracyImprovement, WeaponData.AiWeaponData.MinAiPitchVariation, WeaponData.AiWeaponData.MaxAiPitchVariation);
-        WeaponData.AiWeaponData.AiYawVariation = FMath::Clamp(WeaponData.AiWeaponData.AiYawVariation - WeaponData.AiWeaponData.PerShotAccuracyImprovement, WeaponData.AiWeaponData.MinAiYawVariation, WeaponData.AiWeaponData.MaxAiYawVariation);
-
-        // Spawning the muzzle flash particle
-        if (WeaponData.bHasAttachments)
-        {
-            UGameplayStatics::SpawnEmitterAttached(WeaponData.MuzzleFlash, BarrelAttachment,
-                                                   WeaponData.ParticleSpawnLocation, FVector::ZeroVector,
-                                                   BarrelAttachment->
-                                                   GetSocketRotation(WeaponData.ParticleSpawnLocation),
-                                                   FVector::OneVector);
+            Result.EndPoint = ShotHit.Location;
+            Result.ImpactHit = &ShotHit;
         }
-        else
+        else if (AFPSCharacter* FlybyCharacter = Cast<AFPSCharacter>(ShotHit.GetActor()))
         {
-            UGameplayStatics::SpawnEmitterAttached(WeaponData.MuzzleFlash, MeshComp, WeaponData.ParticleSpawnLocation,
-                                                   FVector::ZeroVector,
-                                                   MeshComp->GetSocketRotation(WeaponData.ParticleSpawnLocation),
-                                                   FVector::OneVector);
+            // Overlaps along a multi trace are characters that the bullet passed close to
+            FlybyCharacter->PlayFlybySounds(ShotHit);
         }
+    }
 
-        // Spawning the firing sound
-        if(WeaponData.bSilenced)
-        {
-            UGameplayStatics::PlaySoundAtLocation(GetWorld(), WeaponData.SilencedSound, TraceStart);
-        }
-        else
-        {
-            UGameplayStatics::PlaySoundAtLocation(GetWorld(), WeaponData.FireSound, TraceStart);
-        }
+    return Result;
+}
+
+void AWeaponBase::PlayShotEffects(const FQueuedShot& Shot, const FShotResult& Result)
+{
+    ISOLATION_WEAPON_SCOPE(STAT_WeaponVFX);
 
+    // Drawing debug line trace
+    if (bShowDebug)
+    {
+        DrawDebugLine(GetWorld(), Shot.bProjectile ? Shot.TraceStart : GetMuzzleLocation(), Result.EndPoint,
+                      FColor::Red, false, 10.0f, 0.0f, 2.0f);
+    }
 
-        // Spawning the ejection bullets
-        FRotator EjectionSpawnVector = FRotator::ZeroRotator;
-        EjectionSpawnVector.Yaw = 270.0f;
-        UNiagaraFunctionLibrary::SpawnSystemAttached(EjectedCasing, MagazineAttachment, FName("ejection_port"),
-                                                     FVector::ZeroVector, EjectionSpawnVector,
-                                                     EAttachLocation::SnapToTarget, true, true);
+    // Spawning the bullet trace particle effect. Projectiles spawn theirs when fired, not for every segment
+    if (!Shot.bProjectile)
+    {
+        const FRotator ParticleRotation = (Result.EndPoint - GetMuzzleLocation()).Rotation();
+        UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), WeaponData.BulletTrace, GetParticleSpawnLocation(),
+                                                 ParticleRotation);
+    }
 
-        // Stopping the recoil timelines if we don't have automatic fire
-        if (!WeaponData.bAutomaticFire)
+    // Selecting the hit effect based on the hit physical surface material and handing it to the pooled impact effects
+    if (Result.ImpactHit && ImpactEffectSubsystem && ResolvedStats.IsValid())
+    {
+        ImpactEffectSubsystem->QueueImpactEffect(ResolvedStats->FindImpactEffect(Result.ImpactHit->PhysMaterial.Get()),
+                                                 Result.ImpactHit->ImpactPoint, Result.ImpactHit->ImpactNormal.Rotation());
+    }
+
+    if (Result.ImpactHit && HearingSubsystem)
+    {
+        HearingSubsystem->PostNoise(ENoiseType::Impact, Result.ImpactHit->ImpactPoint, GetOwner());
+    }
+}
+
+void AWeaponBase::FireProjectile(const FQueuedShot& Shot)
+{
+    FQueuedShot ProjectileShot = Shot;
+    ProjectileShot.bProjectile = true;
+    ProjectileSubsystem->FireRound(ProjectileShot, WeaponData);
+
+    // Spawning the bullet trace particle effect along the round's initial direction
+    UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), WeaponData.BulletTrace, GetParticleSpawnLocation(),
+                                             Shot.TraceDirection.Rotation());
+}
+
+FVector AWeaponBase::GetMuzzleLocation() const
+{
+    return WeaponData.bHasAttachments
+               ? GetBarrelComponent()->GetSocketLocation(WeaponData.MuzzleLocation)
+               : MeshComp->GetSocketLocation(WeaponData.MuzzleLocation);
+}
+
+FVector AWeaponBase::GetParticleSpawnLocation() const
+{
+    return WeaponData.bHasAttachments
+               ? GetBarrelComponent()->GetSocketLocation(WeaponData.ParticleSpawnLocation)
+               : MeshComp->GetSocketLocation(WeaponData.ParticleSpawnLocation);
+}
+
+USkeletalMeshComponent* AWeaponBase::GetBarrelComponent() const
+{
+    return WeaponData.bHasAttachments && !bUsingMergedMesh ? BarrelAttachment : MeshComp;
+}
+
+USkeletalMeshComponent* AWeaponBase::GetMagazineComponent() const
+{
+    return bUsingMergedMesh ? MeshComp : MagazineAttachment;
+}
+
+USkeletalMesh* AWeaponBase::GetDefaultWeaponMesh() const
+{
+    return GetClass()->GetDefaultObject<AWeaponBase>()->MeshComp->SkeletalMesh;
+}
+
+void AWeaponBase::ApplyAttachmentMeshes(const bool bBroken)
+{
+    const FResolvedWeaponStats& Stats = *ResolvedStats;
+
+    // Merging the weapon and its attachments into one mesh, shared with every other weapon using the same attachments
+    USkeletalMesh* MergedMesh = nullptr;
+    if (bMergeAttachmentMeshes)
+    {
+        if (UWeaponStatsCache* StatsCache = GetWorld()->GetSubsystem<UWeaponStatsCache>())
         {
-            VerticalRecoilTimeline.Stop();
-            HorizontalRecoilTimeline.Stop();
-            RecoilRecovery();
+            USkeletalMesh* BaseMesh = bBroken ? WeaponData.DestroyedMesh : GetDefaultWeaponMesh();
+            MergedMesh = StatsCache->FindOrMergeMesh(WeaponDataTable, FName(DataTableNameRef),
+                                                     RuntimeWeaponData.WeaponAttachments, BaseMesh, bBroken);
         }
     }
-    else if (bCanFire && !bIsReloading)
+
+    bUsingMergedMesh = MergedMesh != nullptr;
+    if (bUsingMergedMesh)
     {
-        UGameplayStatics::PlaySoundAtLocation(GetWorld(), WeaponData.EmptyFireSound, MeshComp->GetSocketLocation(WeaponData.MuzzleLocation));
-        WeaponIsEmpty();
-        // Clearing the ShotDelay timer so that we don't have a constant ticking when the player has no ammo, just a single click
-        GetWorldTimerManager().ClearTimer(ShotDelay);
+        MeshComp->SetSkeletalMesh(MergedMesh);
     }
-    
+
+    // Merged weapons leave their attachment components empty, so that they neither draw nor animate
+    const auto ApplySlot = [this, &Stats, bBroken](USkeletalMeshComponent* Component, const EAttachmentType Type)
+    {
+        const FResolvedAttachmentSlot& Slot = Stats.GetSlot(Type);
+        Component->SetSkeletalMesh(bUsingMergedMesh ? nullptr : (bBroken ? Slot.BrokenMesh : Slot.Mesh));
+        Component->SetVisibility(!bUsingMergedMesh);
+        Component->SetComponentTickEnabled(!bUsingMergedMesh);
+    };
+
+    ApplySlot(BarrelAttachment, EAttachmentType::Barrel);
+    ApplySlot(MagazineAttachment, EAttachmentType::Magazine);
+    ApplySlot(SightsAttachment, EAttachmentType::Sights);
+    ApplySlot(StockAttachment, EAttachmentType::Stock);
+    ApplySlot(GripAttachment, EAttachmentType::Grip);
 }
 
 void AWeaponBase::Recoil()
 {
-    const AFPSCharacter* PlayerCharacter = Cast<AFPSCharacter>(UGameplayStatics::GetPlayerCharacter(GetWorld(), 0));
-    AFPSCharacterController* CharacterController = Cast<AFPSCharacterController>(PlayerCharacter->GetController());
+    AFPSCharacterController* CharacterController = RecoilController.Get();
+    if (!CharacterController || !ResolvedStats.IsValid())
+    {
+        return;
+    }
+
+    // Apply recoil by adding a pitch and yaw input to the character controller. Automatic weapons read further into
+    // the recoil pattern the longer they fire, every other shot uses the start of the pattern
+    const float PatternTime = WeaponData.bAutomaticFire && ShotsFired > 0 ? RecoilTime : 0.0f;
+    CharacterController->AddPitchInput(ResolvedStats->VerticalRecoilTable.Evaluate(PatternTime));
+    CharacterController->AddYawInput(ResolvedStats->HorizontalRecoilTable.Evaluate(PatternTime));
+
+    ShotsFired += 1;
+    CharacterController->ClientStartCameraShake(WeaponData.RecoilCameraShake);
+}
 
-    // Apply recoil by adding a pitch and yaw input to the character controller
-    if (WeaponData.bAutomaticFire && CharacterController && ShotsFired > 0 && IsValid(VerticalRecoilCurve) && IsValid(HorizontalRecoilCurve))
+void AWeaponBase::RecoilRecovery()
+{
+    // Begins recovering, if the player hasn't moved their view since they started firing
+    if (bShouldRecover && RecoveryTable.IsValid() && RecoilController.IsValid())
     {
-        CharacterController->AddPitchInput(WeaponData.VerticalRecoilCurve->GetFloatValue(VerticalRecoilTimeline.GetPlaybackPosition()) * VerticalRecoilModifier);
-        CharacterController->AddYawInput(WeaponData.HorizontalRecoilCurve->GetFloatValue(HorizontalRecoilTimeline.GetPlaybackPosition()) * HorizontalRecoilModifier);
+        SetRecoilState(EWeaponRecoilState::Recovering);
+        RecoveryTime = 0.0f;
     }
     else
     {
-        CharacterController->AddPitchInput(WeaponData.VerticalRecoilCurve->GetFloatValue(0) * VerticalRecoilModifier);
-        CharacterController->AddYawInput(WeaponData.HorizontalRecoilCurve->GetFloatValue(0) * HorizontalRecoilModifier);
+        SetRecoilState(EWeaponRecoilState::Idle);
     }
+}
 
-    ShotsFired += 1;
-    GetWorld()->GetFirstPlayerController()->ClientStartCameraShake(WeaponData.RecoilCameraShake);  
+void AWeaponBase::StopRecoilRecovery()
+{
+    bShouldRecover = false;
+    if (RecoilState == EWeaponRecoilState::Recovering)
+    {
+        SetRecoilState(EWeaponRecoilState::Idle);
+    }
 }
 
-void AWeaponBase::RecoilRecovery()
+void AWeaponBase::SetRecoilState(const EWeaponRecoilState NewState)
 {
-    // Plays the recovery timeline
-    if (bShouldRecover)
+    RecoilState = NewState;
+
+    // The ticker drops weapons by itself once they return to idle
+    if (NewState != EWeaponRecoilState::Idle && AnimationTicker)
     {
-        RecoilRecoveryTimeline.PlayFromStart();
+        AnimationTicker->RegisterWeapon(this);
     }
 }
 
+void AWeaponBase::UpdateRecoil(const float DeltaTime)
+{
+    switch (RecoilState)
+    {
+    case EWeaponRecoilState::Firing:
+        RecoilTime += DeltaTime;
+        break;
+
+    case EWeaponRecoilState::Recovering:
+        {
+            AFPSCharacterController* CharacterController = RecoilController.Get();
+            if (!CharacterController)
+            {
+                SetRecoilState(EWeaponRecoilState::Idle);
+                break;
+            }
+
+            RecoveryTime += DeltaTime;
+
+            // Calculating the new control rotation by interpolating between current and target
+            const float Alpha = RecoveryTable.Evaluate(RecoveryTime);
+            CharacterController->SetControlRotation(FMath::Lerp(CharacterController->GetControlRotation(), ControlRotation, Alpha));
+
+            if (RecoveryTime >= RecoveryTable.GetDuration())
+            {
+                SetRecoilState(EWeaponRecoilState::Idle);
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+}
 
 void AWeaponBase::Reload()
 {
-    
+    ISOLATION_WEAPON_SCOPE(STAT_WeaponReload);
+
     // Casting to the character controller (which stores all the ammunition and health variables)
     const AFPSCharacter* PlayerCharacter = Cast<AFPSCharacter>(UGameplayStatics::GetPlayerCharacter(GetWorld(), 0));
     AFPSCharacterController* CharacterController = Cast<AFPSCharacterController>(PlayerCharacter->GetController());
@@ -830,7 +812,7 @@ void AWeaponBase::Reload()
         {
             if (WeaponData.bHasAttachments)
             {
-                MagazineAttachment->PlayAnimation(WeaponData.EmptyWeaponReload, false);
+                GetMagazineComponent()->PlayAnimation(WeaponData.EmptyWeaponReload, false);
             }
             else
             {
@@ -843,7 +825,7 @@ void AWeaponBase::Reload()
         {
             if (WeaponData.bHasAttachments)
             {
-                MagazineAttachment->PlayAnimation(WeaponData.WeaponReload, false);
+                GetMagazineComponent()->PlayAnimation(WeaponData.WeaponReload, false);
             }
             else
             {
@@ -934,41 +916,54 @@ void AWeaponBase::UpdateAmmo()
     }
 }
 
-
-// Called every frame
-void AWeaponBase::Tick(float DeltaTime)
-{
-	Super::Tick(DeltaTime);
-        
-    VerticalRecoilTimeline.TickTimeline(DeltaTime);
-    HorizontalRecoilTimeline.TickTimeline(DeltaTime);
-    RecoilRecoveryTimeline.TickTimeline(DeltaTime);
-}
-
-// Recovering the player's recoil to the pre-fired position
-void AWeaponBase::HandleRecoveryProgress(float Value) const
-{
-    // Getting a reference to the Character Controller
-    const AFPSCharacter* PlayerCharacter = Cast<AFPSCharacter>(UGameplayStatics::GetPlayerCharacter(GetWorld(), 0));
-    AFPSCharacterController* CharacterController = Cast<AFPSCharacterController>(PlayerCharacter->GetController());
-
-    // Calculating the new control rotation by interpolating between current and target 
-    const FRotator NewControlRotation = FMath::Lerp(CharacterController->GetControlRotation(), ControlRotation, Value);
-    
-    CharacterController->SetControlRotation(NewControlRotation);
-}
-
 // Converts an unmagnified linear FoV and magnification value into a magnified FoV
 float AWeaponBase::FOVFromMagnification() const
 {
     return (FMath::RadiansToDegrees(2*(FMath::Atan(((WeaponData.UnmagnifiedLFoV/WeaponData.ScopeMagnification)/2)/100.0f))));
 }
 
-void AWeaponBase::RenderScope() const
+void AWeaponBase::SetWeaponActive(const bool bActive)
 {
-    const AFPSCharacter* PlayerCharacter = Cast<AFPSCharacter>(UGameplayStatics::GetPlayerCharacter(GetWorld(), 0));
-    if (PlayerCharacter->IsPlayerAiming())
+    SetActorHiddenInGame(!bActive);
+
+    if (!bActive)
     {
-        ScopeCaptureComponent->CaptureScene();
+        StopFire();
     }
-}
\ No newline at end of file
+
+    // Scope captures are scheduled by the scope manager, and only for the player's equipped weapon. The manager tracks
+    // a single scope, so AI weapons never register theirs. Clearing is always allowed, as it only affects the active scope
+    if (WeaponData.bIsScope)
+    {
+        if (UScopeCaptureManager* ScopeCaptureManager = GetWorld()->GetSubsystem<UScopeCaptureManager>())
+        {
+            if (!bActive)
+            {
+                ScopeCaptureManager->ClearActiveScope(this);
+            }
+            else if (WeaponOwner && !WeaponOwner->IsAiWeaponOwner())
+            {
+                ScopeCaptureManager->SetActiveScope(this);
+            }
+        }
+    }
+}
+
+void AWeaponBase::ResetForReuse()
+{
+    SetWeaponActive(false);
+
+    // Cancelling anything that was waiting on a timer, and any recoil still playing
+    GetWorldTimerManager().ClearAllTimersForObject(this);
+    StopRecoilRecovery();
+    SetRecoilState(EWeaponRecoilState::Idle);
+    bCanFire = true;
+    bIsReloading = false;
+
+    DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+    SetOwner(nullptr);
+
+    // Weapons are released once broken, so we swap back to the intact mesh. Attachments are reapplied on reuse
+    MeshComp->SetSkeletalMesh(GetDefaultWeaponMesh());
+    bUsingMergedMesh = false;
+}
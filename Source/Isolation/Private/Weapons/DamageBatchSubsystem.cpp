@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapons/DamageBatchSubsystem.h"
+#include "Isolation/Isolation.h"
+#include "GameFramework/Controller.h"
+#include "Kismet/GameplayStatics.h"
+
+static TAutoConsoleVariable<int32> CVarBatchWeaponDamage(
+	TEXT("isolation.Damage.Batching"),
+	1,
+	TEXT("Whether weapon hits on the same victim by the same instigator are merged and applied once at the end of the frame."),
+	ECVF_Default);
+
+void UDamageBatchSubsystem::Deinitialize()
+{
+	PendingDamage.Empty();
+	PendingDamageIndices.Empty();
+
+	Super::Deinitialize();
+}
+
+void UDamageBatchSubsystem::QueuePointDamage(AActor* Victim, const float Damage, const FVector& ShotDirection,
+                                             const FHitResult& HitInfo, AController* Instigator, AActor* DamageCauser,
+                                             const TSubclassOf<UDamageType> DamageType)
+{
+	if (!Victim)
+	{
+		return;
+	}
+
+	if (CVarBatchWeaponDamage.GetValueOnGameThread() == 0)
+	{
+		UGameplayStatics::ApplyPointDamage(Victim, Damage, ShotDirection, HitInfo, Instigator, DamageCauser, DamageType);
+		return;
+	}
+
+	const TPair<const AActor*, const AController*> Key(Victim, Instigator);
+	int32* ExistingIndex = PendingDamageIndices.Find(Key);
+	FPendingDamage* Batch;
+	if (ExistingIndex)
+	{
+		Batch = &PendingDamage[*ExistingIndex];
+	}
+	else
+	{
+		PendingDamageIndices.Add(Key, PendingDamage.Num());
+		Batch = &PendingDamage.AddDefaulted_GetRef();
+		Batch->Victim = Victim;
+		Batch->Instigator = Instigator;
+		Batch->DamageCauser = DamageCauser;
+		Batch->DamageType = DamageType;
+	}
+
+	FDamageHit& Hit = Batch->Hits.AddDefaulted_GetRef();
+	Hit.Damage = Damage;
+	Hit.ShotDirection = ShotDirection;
+	Hit.HitInfo = HitInfo;
+
+	Batch->TotalDamage += Damage;
+	if (Damage > Batch->Hits[Batch->HighestDamageHit].Damage)
+	{
+		Batch->HighestDamageHit = Batch->Hits.Num() - 1;
+	}
+}
+
+void UDamageBatchSubsystem::Tick(float DeltaTime)
+{
+	ISOLATION_WEAPON_SCOPE(STAT_WeaponDamage);
+
+	// Swapping the batches out first, as damage handlers are free to fire weapons and queue more damage for next frame
+	TArray<FPendingDamage> DamageToApply = MoveTemp(PendingDamage);
+	PendingDamage.Reset();
+	PendingDamageIndices.Reset();
+
+	for (const FPendingDamage& Batch : DamageToApply)
+	{
+		AActor* Victim = Batch.Victim.Get();
+		if (!Victim || Victim->IsPendingKill())
+		{
+			continue;
+		}
+
+		// Letting the victim's health listeners see every hit that made up this damage
+		if (UHealthComponent* HealthComponent = Victim->FindComponentByClass<UHealthComponent>())
+		{
+			HealthComponent->SetPendingDamageHits(Batch.Hits);
+		}
+
+		const FDamageHit& HighestHit = Batch.Hits[Batch.HighestDamageHit];
+		UGameplayStatics::ApplyPointDamage(Victim, Batch.TotalDamage, HighestHit.ShotDirection, HighestHit.HitInfo,
+		                                   Batch.Instigator.Get(), Batch.DamageCauser.Get(), Batch.DamageType);
+	}
+}
@@ -0,0 +1,147 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapons/ImpactEffectSubsystem.h"
+#include "Isolation/Isolation.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+#include "NiagaraComponent.h"
+#include "NiagaraFunctionLibrary.h"
+#include "NiagaraSystem.h"
+
+static TAutoConsoleVariable<int32> CVarImpactEffectPoolSize(
+	TEXT("isolation.ImpactEffects.PoolSize"),
+	8,
+	TEXT("The number of components pre-warmed for each impact effect. Only applies to pools created after changing it."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarImpactEffectsPerFrame(
+	TEXT("isolation.ImpactEffects.MaxPerFrame"),
+	12,
+	TEXT("The maximum number of impact effects played in a single frame. Any further impacts that frame are dropped."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarImpactEffectCullDistance(
+	TEXT("isolation.ImpactEffects.CullDistance"),
+	6000.0f,
+	TEXT("Impacts further than this from the camera are not played. 0 disables distance culling."),
+	ECVF_Default);
+
+void UImpactEffectSubsystem::Deinitialize()
+{
+	for (TPair<UNiagaraSystem*, FImpactEffectPool>& Pool : Pools)
+	{
+		for (UNiagaraComponent* Component : Pool.Value.Components)
+		{
+			if (Component)
+			{
+				Component->DestroyComponent();
+			}
+		}
+	}
+	Pools.Empty();
+	QueuedEffects.Empty();
+
+	Super::Deinitialize();
+}
+
+void UImpactEffectSubsystem::WarmPool(UNiagaraSystem* System)
+{
+	if (System)
+	{
+		FindOrCreatePool(System);
+	}
+}
+
+void UImpactEffectSubsystem::QueueImpactEffect(UNiagaraSystem* System, const FVector& Location, const FRotator& Rotation)
+{
+	if (!System)
+	{
+		return;
+	}
+
+	FQueuedImpactEffect& Effect = QueuedEffects.AddDefaulted_GetRef();
+	Effect.System = System;
+	Effect.Location = Location;
+	Effect.Rotation = Rotation;
+}
+
+void UImpactEffectSubsystem::Tick(float DeltaTime)
+{
+	ISOLATION_WEAPON_SCOPE(STAT_WeaponVFX);
+
+	const int32 MaxEffects = CVarImpactEffectsPerFrame.GetValueOnGameThread();
+	const float CullDistance = CVarImpactEffectCullDistance.GetValueOnGameThread();
+
+	// Culling against the local player's camera, if we have one
+	bool bCullByDistance = false;
+	FVector CameraLocation = FVector::ZeroVector;
+	if (CullDistance > 0.0f)
+	{
+		if (const APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(this, 0))
+		{
+			CameraLocation = CameraManager->GetCameraLocation();
+			bCullByDistance = true;
+		}
+	}
+	const float CullDistanceSquared = FMath::Square(CullDistance);
+
+	int32 PlayedEffects = 0;
+	for (const FQueuedImpactEffect& Effect : QueuedEffects)
+	{
+		if (PlayedEffects >= MaxEffects)
+		{
+			break;
+		}
+
+		if (bCullByDistance && FVector::DistSquared(CameraLocation, Effect.Location) > CullDistanceSquared)
+		{
+			continue;
+		}
+
+		FImpactEffectPool& Pool = FindOrCreatePool(Effect.System);
+		if (Pool.Components.Num() == 0)
+		{
+			continue;
+		}
+
+		// Reusing the next component in the pool, restarting it if it is still playing a previous impact
+		UNiagaraComponent* Component = Pool.Components[Pool.NextIndex];
+		Pool.NextIndex = (Pool.NextIndex + 1) % Pool.Components.Num();
+		if (!Component)
+		{
+			continue;
+		}
+
+		Component->SetWorldLocationAndRotation(Effect.Location, Effect.Rotation);
+		Component->Activate(true);
+		PlayedEffects++;
+	}
+
+	QueuedEffects.Reset();
+}
+
+FImpactEffectPool& UImpactEffectSubsystem::FindOrCreatePool(UNiagaraSystem* System)
+{
+	if (FImpactEffectPool* ExistingPool = Pools.Find(System))
+	{
+		return *ExistingPool;
+	}
+
+	FImpactEffectPool& Pool = Pools.Add(System);
+
+	const int32 PoolSize = FMath::Max(CVarImpactEffectPoolSize.GetValueOnGameThread(), 1);
+	Pool.Components.Reserve(PoolSize);
+	for (int32 Index = 0; Index < PoolSize; Index++)
+	{
+		// Components are created inactive and never auto destroyed, so they stay in the pool for the life of the world
+		UNiagaraComponent* Component = UNiagaraFunctionLibrary::SpawnSystemAtLocation(GetWorld(), System,
+			FVector::ZeroVector, FRotator::ZeroRotator, FVector::OneVector, false, false, ENCPoolMethod::None, false);
+		if (Component)
+		{
+			Pool.Components.Add(Component);
+		}
+	}
+
+	return Pool;
+}
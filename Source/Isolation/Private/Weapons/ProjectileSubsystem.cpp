@@ -0,0 +1,225 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapons/ProjectileSubsystem.h"
+#include "WeaponBase.h"
+#include "Isolation/Isolation.h"
+#include "Engine/World.h"
+
+static TAutoConsoleVariable<float> CVarProjectileStepRate(
+	TEXT("isolation.Projectiles.StepRate"),
+	60.0f,
+	TEXT("The fixed rate, in Hz, that projectiles are simulated at."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarProjectileMaxStepsPerFrame(
+	TEXT("isolation.Projectiles.MaxStepsPerFrame"),
+	4,
+	TEXT("The most fixed steps simulated in a single frame. Any further time is dropped rather than letting a slow frame snowball."),
+	ECVF_Default);
+
+void UProjectileSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	SegmentCompletedDelegate.BindUObject(this, &UProjectileSubsystem::HandleSegmentCompleted);
+}
+
+void UProjectileSubsystem::Deinitialize()
+{
+	// Queued segment traces keep their own copy of the delegate and still call back after this. The weak binding drops
+	// those callbacks once we have been collected, and until then the emptied segments leave them nothing to resolve
+	SegmentCompletedDelegate.Unbind();
+	InFlightSegments.Empty();
+	FinishedRounds.Empty();
+	OutstandingTraces = 0;
+
+	while (RoundIds.Num() > 0)
+	{
+		RemoveRoundAt(RoundIds.Num() - 1);
+	}
+
+	Super::Deinitialize();
+}
+
+void UProjectileSubsystem::FireRound(const FQueuedShot& Shot, const FStaticWeaponData& WeaponData)
+{
+	const UWorld* World = GetWorld();
+	if (!World)
+	{
+		return;
+	}
+
+	const FVector Velocity = Shot.TraceDirection * WeaponData.MuzzleVelocity;
+
+	PositionX.Add(Shot.TraceStart.X);
+	PositionY.Add(Shot.TraceStart.Y);
+	PositionZ.Add(Shot.TraceStart.Z);
+	VelocityX.Add(Velocity.X);
+	VelocityY.Add(Velocity.Y);
+	VelocityZ.Add(Velocity.Z);
+	Drag.Add(WeaponData.ProjectileDrag);
+	GravityZ.Add(World->GetGravityZ() * WeaponData.ProjectileGravityScale);
+	TimeRemaining.Add(WeaponData.ProjectileLifetime);
+	PreviousX.Add(Shot.TraceStart.X);
+	PreviousY.Add(Shot.TraceStart.Y);
+	PreviousZ.Add(Shot.TraceStart.Z);
+	RoundIds.Add(NextRoundId++);
+	RoundShots.Add(Shot);
+}
+
+void UProjectileSubsystem::Tick(float DeltaTime)
+{
+	// Once every segment from the previous steps has returned, rounds that hit something can be removed and the in
+	// flight array reused from the start. Until then a late result could still mark its round finished
+	if (OutstandingTraces == 0)
+	{
+		RemoveFinishedRounds();
+		InFlightSegments.Reset();
+	}
+
+	const float StepTime = 1.0f / FMath::Max(CVarProjectileStepRate.GetValueOnGameThread(), 1.0f);
+	const int32 MaxSteps = FMath::Max(CVarProjectileMaxStepsPerFrame.GetValueOnGameThread(), 1);
+
+	StepAccumulator = FMath::Min(StepAccumulator + DeltaTime, StepTime * MaxSteps);
+	while (StepAccumulator >= StepTime)
+	{
+		StepRounds(StepTime);
+		StepAccumulator -= StepTime;
+	}
+}
+
+void UProjectileSubsystem::StepRounds(const float StepTime)
+{
+	ISOLATION_WEAPON_SCOPE(STAT_WeaponProjectileStep);
+
+	UWorld* World = GetWorld();
+	const int32 NumRounds = RoundIds.Num();
+	if (!World || NumRounds == 0)
+	{
+		return;
+	}
+
+	// Remembering where each round started this step, so we can trace the segment it travels
+	FMemory::Memcpy(PreviousX.GetData(), PositionX.GetData(), NumRounds * sizeof(float));
+	FMemory::Memcpy(PreviousY.GetData(), PositionY.GetData(), NumRounds * sizeof(float));
+	FMemory::Memcpy(PreviousZ.GetData(), PositionZ.GetData(), NumRounds * sizeof(float));
+
+	float* RESTRICT PosX = PositionX.GetData();
+	float* RESTRICT PosY = PositionY.GetData();
+	float* RESTRICT PosZ = PositionZ.GetData();
+	float* RESTRICT VelX = VelocityX.GetData();
+	float* RESTRICT VelY = VelocityY.GetData();
+	float* RESTRICT VelZ = VelocityZ.GetData();
+	float* RESTRICT Time = TimeRemaining.GetData();
+	const float* RESTRICT RoundDrag = Drag.GetData();
+	const float* RESTRICT RoundGravity = GravityZ.GetData();
+
+	// Semi-implicit Euler with linear drag. Branch free, so the compiler can vectorise it
+	for (int32 Index = 0; Index < NumRounds; Index++)
+	{
+		const float DragFactor = FMath::Max(1.0f - RoundDrag[Index] * StepTime, 0.0f);
+		VelX[Index] = VelX[Index] * DragFactor;
+		VelY[Index] = VelY[Index] * DragFactor;
+		VelZ[Index] = VelZ[Index] * DragFactor + RoundGravity[Index] * StepTime;
+		PosX[Index] += VelX[Index] * StepTime;
+		PosY[Index] += VelY[Index] * StepTime;
+		PosZ[Index] += VelZ[Index] * StepTime;
+		Time[Index] -= StepTime;
+	}
+
+	// Submitting the segment each round travelled this step
+	for (int32 Index = 0; Index < NumRounds; Index++)
+	{
+		const uint32 RoundId = RoundIds[Index];
+		if (FinishedRounds.Contains(RoundId))
+		{
+			continue;
+		}
+
+		const AWeaponBase* Weapon = RoundShots[Index].Weapon.Get();
+		if (!Weapon)
+		{
+			// Nothing left to resolve the round's hits
+			FinishedRounds.Add(RoundId);
+			continue;
+		}
+
+		ISOLATION_WEAPON_COUNTER(STAT_WeaponTraces, 1);
+
+		FProjectileSegment& Segment = InFlightSegments.AddDefaulted_GetRef();
+		Segment.RoundId = RoundId;
+		Segment.Shot = RoundShots[Index];
+		Segment.Shot.TraceStart = FVector(PreviousX[Index], PreviousY[Index], PreviousZ[Index]);
+		Segment.Shot.TraceEnd = FVector(PosX[Index], PosY[Index], PosZ[Index]);
+		Segment.Shot.TraceDirection = (Segment.Shot.TraceEnd - Segment.Shot.TraceStart).GetSafeNormal();
+
+		World->AsyncLineTraceByChannel(Segment.Shot.bMultiTrace ? EAsyncTraceType::Multi : EAsyncTraceType::Single,
+		                               Segment.Shot.TraceStart, Segment.Shot.TraceEnd, Segment.Shot.TraceChannel,
+		                               Weapon->GetTraceQueryParams(), FCollisionResponseParams::DefaultResponseParam,
+		                               &SegmentCompletedDelegate, InFlightSegments.Num() - 1);
+		OutstandingTraces++;
+	}
+}
+
+void UProjectileSubsystem::RemoveRoundAt(const int32 Index)
+{
+	PositionX.RemoveAtSwap(Index, 1, false);
+	PositionY.RemoveAtSwap(Index, 1, false);
+	PositionZ.RemoveAtSwap(Index, 1, false);
+	VelocityX.RemoveAtSwap(Index, 1, false);
+	VelocityY.RemoveAtSwap(Index, 1, false);
+	VelocityZ.RemoveAtSwap(Index, 1, false);
+	Drag.RemoveAtSwap(Index, 1, false);
+	GravityZ.RemoveAtSwap(Index, 1, false);
+	TimeRemaining.RemoveAtSwap(Index, 1, false);
+	PreviousX.RemoveAtSwap(Index, 1, false);
+	PreviousY.RemoveAtSwap(Index, 1, false);
+	PreviousZ.RemoveAtSwap(Index, 1, false);
+	RoundIds.RemoveAtSwap(Index, 1, false);
+	RoundShots.RemoveAtSwap(Index, 1, false);
+}
+
+void UProjectileSubsystem::RemoveFinishedRounds()
+{
+	// Walking backwards so that swapped in rounds have already been checked
+	for (int32 Index = RoundIds.Num() - 1; Index >= 0; Index--)
+	{
+		if (TimeRemaining[Index] <= 0.0f || FinishedRounds.Contains(RoundIds[Index]))
+		{
+			RemoveRoundAt(Index);
+		}
+	}
+
+	FinishedRounds.Reset();
+}
+
+void UProjectileSubsystem::HandleSegmentCompleted(const FTraceHandle& Handle, FTraceDatum& Data)
+{
+	OutstandingTraces = FMath::Max(OutstandingTraces - 1, 0);
+
+	if (!InFlightSegments.IsValidIndex(Data.UserData) || Data.OutHits.Num() == 0)
+	{
+		return;
+	}
+
+	// Segments complete in the order they were submitted, so only the first segment of a round to hit is resolved
+	const FProjectileSegment& Segment = InFlightSegments[Data.UserData];
+	if (FinishedRounds.Contains(Segment.RoundId))
+	{
+		return;
+	}
+
+	AWeaponBase* Weapon = Segment.Shot.Weapon.Get();
+	if (!Weapon)
+	{
+		return;
+	}
+
+	// Overlaps along an AI round's path still play flyby sounds, but only a blocking hit stops the round
+	Weapon->ResolveShot(Segment.Shot, Data.OutHits);
+	if (Data.OutHits.ContainsByPredicate([](const FHitResult& Hit) { return Hit.bBlockingHit; }))
+	{
+		FinishedRounds.Add(Segment.RoundId);
+	}
+}
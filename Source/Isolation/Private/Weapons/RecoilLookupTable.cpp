@@ -0,0 +1,33 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapons/RecoilLookupTable.h"
+#include "Curves/CurveFloat.h"
+
+void FRecoilLookupTable::Bake(const UCurveFloat* Curve, const float Scale)
+{
+	bIsValid = false;
+	Duration = 0.0f;
+	InvSampleSpacing = 0.0f;
+
+	if (!Curve)
+	{
+		return;
+	}
+
+	float MinTime = 0.0f;
+	float MaxTime = 0.0f;
+	Curve->GetTimeRange(MinTime, MaxTime);
+
+	// Recoil has always been played from time zero, regardless of where the curve's first key is
+	Duration = FMath::Max(MaxTime, 0.0f);
+
+	const float SampleSpacing = Duration / (NumSamples - 1);
+	for (int32 Index = 0; Index < NumSamples; Index++)
+	{
+		Samples[Index] = Curve->GetFloatValue(SampleSpacing * Index) * Scale;
+	}
+
+	InvSampleSpacing = SampleSpacing > SMALL_NUMBER ? 1.0f / SampleSpacing : 0.0f;
+	bIsValid = true;
+}
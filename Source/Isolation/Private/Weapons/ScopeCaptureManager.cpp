@@ -0,0 +1,203 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapons/ScopeCaptureManager.h"
+#include "WeaponBase.h"
+#include "FPSCharacter.h"
+#include "Isolation/Isolation.h"
+#include "Components/SceneCaptureComponent2D.h"
+#include "Engine/TextureRenderTarget2D.h"
+
+static TAutoConsoleVariable<float> CVarScopeFrameBudgetMs(
+	TEXT("isolation.Scope.FrameBudgetMs"),
+	16.6f,
+	TEXT("Frame time budget in milliseconds. The scope lowers its capture rate, then its resolution, while the game is over it."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarScopeMinRateScale(
+	TEXT("isolation.Scope.MinRateScale"),
+	0.25f,
+	TEXT("The lowest fraction of the weapon's ScopeFrameRate that the scope will capture at."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarScopeMinResolutionScale(
+	TEXT("isolation.Scope.MinResolutionScale"),
+	0.5f,
+	TEXT("The lowest fraction of the scope render target's original resolution that the scope will render at."),
+	ECVF_Default);
+
+namespace ScopeCapture
+{
+	/** The amount the rate or resolution scale changes by in a single step */
+	constexpr float QualityStep = 0.25f;
+
+	/** The minimum time between quality changes, resizing the render target isn't free */
+	constexpr float QualityChangeCooldown = 0.5f;
+
+	/** Frame times below this fraction of the budget are considered to have headroom */
+	constexpr float HeadroomFraction = 0.8f;
+
+	/** How quickly the smoothed frame time follows the real frame time */
+	constexpr float FrameTimeSmoothing = 0.1f;
+}
+
+void UScopeCaptureManager::Deinitialize()
+{
+	RestoreRenderTarget();
+	ActiveScope.Reset();
+	ActiveScopeOwner.Reset();
+
+	Super::Deinitialize();
+}
+
+void UScopeCaptureManager::SetActiveScope(AWeaponBase* Weapon)
+{
+	if (ActiveScope.Get() == Weapon)
+	{
+		return;
+	}
+
+	RestoreRenderTarget();
+
+	ActiveScope = Weapon;
+	ActiveScopeOwner = Weapon ? Cast<AFPSCharacter>(Weapon->GetOwner()) : nullptr;
+	OriginalTargetSize = FIntPoint::ZeroValue;
+	TimeSinceCapture = 0.0f;
+	bWasScopeVisible = false;
+
+	if (const USceneCaptureComponent2D* CaptureComponent = Weapon ? Weapon->GetScopeCaptureComponent() : nullptr)
+	{
+		if (const UTextureRenderTarget2D* RenderTarget = CaptureComponent->TextureTarget)
+		{
+			OriginalTargetSize = FIntPoint(RenderTarget->SizeX, RenderTarget->SizeY);
+		}
+	}
+
+	// Keeping whatever quality we had settled on for the previous scope, the frame time is unlikely to have changed
+	ApplyResolutionScale();
+}
+
+void UScopeCaptureManager::ClearActiveScope(const AWeaponBase* Weapon)
+{
+	if (ActiveScope.Get() != Weapon)
+	{
+		return;
+	}
+
+	RestoreRenderTarget();
+	ActiveScope.Reset();
+	ActiveScopeOwner.Reset();
+}
+
+void UScopeCaptureManager::Tick(float DeltaTime)
+{
+	const AWeaponBase* Weapon = ActiveScope.Get();
+	const AFPSCharacter* ScopeOwner = ActiveScopeOwner.Get();
+	USceneCaptureComponent2D* CaptureComponent = Weapon ? Weapon->GetScopeCaptureComponent() : nullptr;
+	if (!ScopeOwner || !CaptureComponent)
+	{
+		return;
+	}
+
+	UpdateQuality(DeltaTime);
+
+	// Nothing to render until the scope has started blending in
+	if (ScopeOwner->GetScopeBlend() <= 0.0f)
+	{
+		bWasScopeVisible = false;
+		return;
+	}
+
+	TimeSinceCapture += DeltaTime;
+
+	const float CaptureRate = FMath::Max(Weapon->GetScopeFrameRate() * RateScale, 1.0f);
+	if (!bWasScopeVisible || TimeSinceCapture >= 1.0f / CaptureRate)
+	{
+		ISOLATION_WEAPON_SCOPE(STAT_WeaponRenderScope);
+		CaptureComponent->CaptureScene();
+		TimeSinceCapture = 0.0f;
+	}
+
+	bWasScopeVisible = true;
+}
+
+void UScopeCaptureManager::UpdateQuality(float DeltaTime)
+{
+	AverageFrameTimeMs = FMath::Lerp(AverageFrameTimeMs, DeltaTime * 1000.0f, ScopeCapture::FrameTimeSmoothing);
+
+	TimeSinceQualityChange += DeltaTime;
+	if (TimeSinceQualityChange < ScopeCapture::QualityChangeCooldown)
+	{
+		return;
+	}
+
+	const float BudgetMs = CVarScopeFrameBudgetMs.GetValueOnGameThread();
+	const float MinRateScale = FMath::Clamp(CVarScopeMinRateScale.GetValueOnGameThread(), 0.0f, 1.0f);
+	const float MinResolutionScale = FMath::Clamp(CVarScopeMinResolutionScale.GetValueOnGameThread(), 0.0f, 1.0f);
+
+	if (AverageFrameTimeMs > BudgetMs)
+	{
+		// Over budget, capturing less often is cheaper to recover from than rendering at a lower resolution
+		if (RateScale > MinRateScale)
+		{
+			RateScale = FMath::Max(RateScale - ScopeCapture::QualityStep, MinRateScale);
+			TimeSinceQualityChange = 0.0f;
+		}
+		else if (ResolutionScale > MinResolutionScale)
+		{
+			ResolutionScale = FMath::Max(ResolutionScale - ScopeCapture::QualityStep, MinResolutionScale);
+			ApplyResolutionScale();
+			TimeSinceQualityChange = 0.0f;
+		}
+	}
+	else if (AverageFrameTimeMs < BudgetMs * ScopeCapture::HeadroomFraction)
+	{
+		// Under budget, restoring resolution first and then the capture rate
+		if (ResolutionScale < 1.0f)
+		{
+			ResolutionScale = FMath::Min(ResolutionScale + ScopeCapture::QualityStep, 1.0f);
+			ApplyResolutionScale();
+			TimeSinceQualityChange = 0.0f;
+		}
+		else if (RateScale < 1.0f)
+		{
+			RateScale = FMath::Min(RateScale + ScopeCapture::QualityStep, 1.0f);
+			TimeSinceQualityChange = 0.0f;
+		}
+	}
+}
+
+void UScopeCaptureManager::ApplyResolutionScale()
+{
+	const AWeaponBase* Weapon = ActiveScope.Get();
+	const USceneCaptureComponent2D* CaptureComponent = Weapon ? Weapon->GetScopeCaptureComponent() : nullptr;
+	UTextureRenderTarget2D* RenderTarget = CaptureComponent ? CaptureComponent->TextureTarget : nullptr;
+	if (!RenderTarget || OriginalTargetSize.X <= 0 || OriginalTargetSize.Y <= 0)
+	{
+		return;
+	}
+
+	const uint32 NewSizeX = FMath::Max(FMath::RoundToInt(OriginalTargetSize.X * ResolutionScale), 1);
+	const uint32 NewSizeY = FMath::Max(FMath::RoundToInt(OriginalTargetSize.Y * ResolutionScale), 1);
+	if (RenderTarget->SizeX != NewSizeX || RenderTarget->SizeY != NewSizeY)
+	{
+		RenderTarget->ResizeTarget(NewSizeX, NewSizeY);
+	}
+}
+
+void UScopeCaptureManager::RestoreRenderTarget()
+{
+	const AWeaponBase* Weapon = ActiveScope.Get();
+	const USceneCaptureComponent2D* CaptureComponent = Weapon ? Weapon->GetScopeCaptureComponent() : nullptr;
+	UTextureRenderTarget2D* RenderTarget = CaptureComponent ? CaptureComponent->TextureTarget : nullptr;
+	if (!RenderTarget || OriginalTargetSize.X <= 0 || OriginalTargetSize.Y <= 0)
+	{
+		return;
+	}
+
+	// Render targets are assets shared between weapons, so we always hand them back at their original size
+	if (RenderTarget->SizeX != OriginalTargetSize.X || RenderTarget->SizeY != OriginalTargetSize.Y)
+	{
+		RenderTarget->ResizeTarget(OriginalTargetSize.X, OriginalTargetSize.Y);
+	}
+}
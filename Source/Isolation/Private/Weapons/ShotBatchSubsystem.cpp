@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapons/ShotBatchSubsystem.h"
+#include "WeaponBase.h"
+#include "Isolation/Isolation.h"
+#include "Engine/World.h"
+
+void UShotBatchSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	TraceCompletedDelegate.BindUObject(this, &UShotBatchSubsystem::HandleTraceCompleted);
+}
+
+void UShotBatchSubsystem::Deinitialize()
+{
+	// Queued traces hold their own copy of the delegate, so unbinding ours doesn't stop them calling back. Those callbacks
+	// are safe as the binding is weak, so they are dropped once we have been collected, and until then they find no
+	// in flight shots to resolve
+	TraceCompletedDelegate.Unbind();
+	PendingShots.Empty();
+	InFlightShots.Empty();
+	OutstandingTraces = 0;
+
+	Super::Deinitialize();
+}
+
+void UShotBatchSubsystem::Tick(float DeltaTime)
+{
+	ISOLATION_WEAPON_SCOPE(STAT_WeaponTrace);
+
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return;
+	}
+
+	// Once every trace from the previous batch has returned we can reuse the in flight array from the start
+	if (OutstandingTraces == 0)
+	{
+		InFlightShots.Reset();
+	}
+
+	for (const FQueuedShot& Shot : PendingShots)
+	{
+		const AWeaponBase* Weapon = Shot.Weapon.Get();
+		if (!Weapon)
+		{
+			continue;
+		}
+
+		const uint32 ShotIndex = InFlightShots.Add(Shot);
+		World->AsyncLineTraceByChannel(Shot.bMultiTrace ? EAsyncTraceType::Multi : EAsyncTraceType::Single,
+		                               Shot.TraceStart, Shot.TraceEnd, Shot.TraceChannel,
+		                               Weapon->GetTraceQueryParams(), FCollisionResponseParams::DefaultResponseParam,
+		                               &TraceCompletedDelegate, ShotIndex);
+		OutstandingTraces++;
+	}
+
+	ISOLATION_WEAPON_COUNTER(STAT_WeaponTraces, PendingShots.Num());
+	PendingShots.Reset();
+}
+
+void UShotBatchSubsystem::HandleTraceCompleted(const FTraceHandle& Handle, FTraceDatum& Data)
+{
+	OutstandingTraces = FMath::Max(OutstandingTraces - 1, 0);
+
+	if (!InFlightShots.IsValidIndex(Data.UserData))
+	{
+		return;
+	}
+
+	// Handing the results back to the weapon, if it still exists, so that it can apply damage and effects
+	const FQueuedShot& Shot = InFlightShots[Data.UserData];
+	if (AWeaponBase* Weapon = Shot.Weapon.Get())
+	{
+		Weapon->ResolveShot(Shot, Data.OutHits);
+	}
+}
@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapons/WeaponAnimationTicker.h"
+#include "WeaponBase.h"
+
+void UWeaponAnimationTicker::Deinitialize()
+{
+	ActiveWeapons.Empty();
+
+	Super::Deinitialize();
+}
+
+void UWeaponAnimationTicker::Tick(float DeltaTime)
+{
+	// Walking backwards, so that swapping a settled weapon out only ever moves in one we've already updated
+	for (int32 Index = ActiveWeapons.Num() - 1; Index >= 0; Index--)
+	{
+		AWeaponBase* Weapon = ActiveWeapons[Index];
+		if (IsValid(Weapon))
+		{
+			Weapon->UpdateRecoil(DeltaTime);
+		}
+
+		if (!IsValid(Weapon) || !Weapon->IsRecoilActive())
+		{
+			ActiveWeapons.RemoveAtSwap(Index, 1, false);
+		}
+	}
+}
@@ -0,0 +1,123 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapons/WeaponPoolSubsystem.h"
+#include "WeaponBase.h"
+#include "Interactables/WeaponPickup.h"
+#include "Engine/World.h"
+
+static TAutoConsoleVariable<int32> CVarWeaponPoolMaxPerClass(
+	TEXT("isolation.WeaponPool.MaxPerClass"),
+	4,
+	TEXT("The maximum number of inactive weapons or pickups kept for reuse per class. Any more are destroyed when released."),
+	ECVF_Default);
+
+void UWeaponPoolSubsystem::Deinitialize()
+{
+	// The pooled actors belong to the world, which destroys them along with everything else
+	Pools.Empty();
+
+	Super::Deinitialize();
+}
+
+AWeaponBase* UWeaponPoolSubsystem::AcquireWeapon(const TSubclassOf<AWeaponBase> WeaponClass)
+{
+	bool bSpawned = false;
+	AWeaponBase* Weapon = Cast<AWeaponBase>(AcquireActor(WeaponClass, FTransform::Identity, bSpawned));
+
+	// Fresh weapons start active, so we deactivate them to match the ones coming out of the pool
+	if (Weapon && bSpawned)
+	{
+		Weapon->SetWeaponActive(false);
+	}
+
+	return Weapon;
+}
+
+void UWeaponPoolSubsystem::ReleaseWeapon(AWeaponBase* Weapon)
+{
+	if (!IsValid(Weapon))
+	{
+		return;
+	}
+
+	Weapon->ResetForReuse();
+
+	if (!AddToPool(Weapon))
+	{
+		Weapon->Destroy();
+	}
+}
+
+AWeaponPickup* UWeaponPoolSubsystem::AcquirePickup(const TSubclassOf<AWeaponPickup> PickupClass, const FTransform& Transform)
+{
+	bool bSpawned = false;
+	AWeaponPickup* Pickup = Cast<AWeaponPickup>(AcquireActor(PickupClass, Transform, bSpawned));
+	if (Pickup)
+	{
+		Pickup->SetPickupActive(false);
+		if (!bSpawned)
+		{
+			Pickup->SetActorTransform(Transform, false, nullptr, ETeleportType::ResetPhysics);
+		}
+	}
+
+	return Pickup;
+}
+
+void UWeaponPoolSubsystem::ReleasePickup(AWeaponPickup* Pickup)
+{
+	if (!IsValid(Pickup))
+	{
+		return;
+	}
+
+	Pickup->SetPickupActive(false);
+
+	if (!AddToPool(Pickup))
+	{
+		Pickup->Destroy();
+	}
+}
+
+AActor* UWeaponPoolSubsystem::AcquireActor(UClass* ActorClass, const FTransform& Transform, bool& bOutSpawned)
+{
+	bOutSpawned = false;
+	UWorld* World = GetWorld();
+	if (!ActorClass || !World)
+	{
+		return nullptr;
+	}
+
+	if (FPooledActors* Pool = Pools.Find(ActorClass))
+	{
+		// Anything destroyed while pooled (by a level unloading, for example) is skipped over
+		while (Pool->Actors.Num() > 0)
+		{
+			AActor* Actor = Pool->Actors.Pop(false);
+			if (IsValid(Actor))
+			{
+				return Actor;
+			}
+		}
+	}
+
+	// Forcing the actor to spawn at all times, as the inventory always has
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	AActor* Actor = World->SpawnActor(ActorClass, &Transform, SpawnParameters);
+	bOutSpawned = Actor != nullptr;
+	return Actor;
+}
+
+bool UWeaponPoolSubsystem::AddToPool(AActor* Actor)
+{
+	FPooledActors& Pool = Pools.FindOrAdd(Actor->GetClass());
+	if (Pool.Actors.Num() >= CVarWeaponPoolMaxPerClass.GetValueOnGameThread())
+	{
+		return false;
+	}
+
+	Pool.Actors.AddUnique(Actor);
+	return true;
+}
@@ -0,0 +1,285 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapons/WeaponStatsCache.h"
+#include "Engine/DataTable.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/World.h"
+#include "SkeletalMeshMerge.h"
+
+void FResolvedWeaponStats::BakeRecoilTables()
+{
+	VerticalRecoilTable.Bake(WeaponData.VerticalRecoilCurve, VerticalRecoilModifier);
+	HorizontalRecoilTable.Bake(WeaponData.HorizontalRecoilCurve, HorizontalRecoilModifier);
+}
+
+FWeaponStatsKey::FWeaponStatsKey(const UDataTable* InWeaponDataTable, const FName InWeaponRowName, const TArray<FName>& InAttachments)
+	: WeaponDataTable(InWeaponDataTable)
+	, WeaponRowName(InWeaponRowName)
+	, Attachments(InAttachments)
+{
+	Attachments.Sort(FNameFastLess());
+}
+
+TSharedPtr<const FResolvedWeaponStats> UWeaponStatsCache::FindOrResolve(const UDataTable* WeaponDataTable,
+	const FName WeaponRowName, const TArray<FName>& Attachments)
+{
+	const FWeaponStatsKey Key(WeaponDataTable, WeaponRowName, Attachments);
+
+	if (const TSharedRef<const FResolvedWeaponStats>* CachedStats = ResolvedStats.Find(Key))
+	{
+		return *CachedStats;
+	}
+
+	const TSharedPtr<FResolvedWeaponStats> NewStats = ResolveStats(WeaponDataTable, WeaponRowName, Attachments);
+	if (!NewStats.IsValid())
+	{
+		return nullptr;
+	}
+
+	// Keeping track of the tables we've resolved from, so that we can drop the cache if they are modified
+	UDataTable* AttachmentsDataTable = NewStats->WeaponData.AttachmentsDataTable;
+	for (UDataTable* Table : { const_cast<UDataTable*>(WeaponDataTable), AttachmentsDataTable })
+	{
+		if (Table && !ReferencedTables.Contains(Table))
+		{
+			ReferencedTables.Add(Table);
+			Table->OnDataTableChanged().AddUObject(this, &UWeaponStatsCache::HandleDataTableChanged);
+		}
+	}
+
+	ResolvedStats.Add(Key, NewStats.ToSharedRef());
+	return NewStats;
+}
+
+TSharedPtr<const FResolvedWeaponStats> UWeaponStatsCache::GetStats(const UObject* WorldContextObject,
+	const UDataTable* WeaponDataTable, const FName WeaponRowName, const TArray<FName>& Attachments)
+{
+	const UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	if (UWeaponStatsCache* Cache = World ? World->GetSubsystem<UWeaponStatsCache>() : nullptr)
+	{
+		return Cache->FindOrResolve(WeaponDataTable, WeaponRowName, Attachments);
+	}
+	return ResolveStats(WeaponDataTable, WeaponRowName, Attachments);
+}
+
+USkeletalMesh* UWeaponStatsCache::FindOrMergeMesh(const UDataTable* WeaponDataTable, const FName WeaponRowName,
+	const TArray<FName>& Attachments, USkeletalMesh* BaseMesh, const bool bBroken)
+{
+	FMergedWeaponMeshKey Key{ FWeaponStatsKey(WeaponDataTable, WeaponRowName, Attachments), BaseMesh, bBroken };
+
+	if (USkeletalMesh** CachedMesh = MergedMeshes.Find(Key))
+	{
+		return *CachedMesh;
+	}
+
+	const TSharedPtr<const FResolvedWeaponStats> Stats = FindOrResolve(WeaponDataTable, WeaponRowName, Attachments);
+	if (!BaseMesh || !Stats.IsValid())
+	{
+		return nullptr;
+	}
+
+	// Gathering the base mesh and every attachment slot that has a mesh, in slot order
+	TArray<USkeletalMesh*> SourceMeshes;
+	SourceMeshes.Add(BaseMesh);
+	for (const FResolvedAttachmentSlot& Slot : Stats->AttachmentSlots)
+	{
+		if (USkeletalMesh* SlotMesh = bBroken ? Slot.BrokenMesh : Slot.Mesh)
+		{
+			SourceMeshes.Add(SlotMesh);
+		}
+	}
+
+	USkeletalMesh* MergedMesh = NewObject<USkeletalMesh>(this, NAME_None, RF_Transient);
+	MergedMesh->Skeleton = BaseMesh->Skeleton;
+
+	FSkeletalMeshMerge MeshMerger(MergedMesh, SourceMeshes, TArray<FSkelMeshMergeSectionMapping>(), 0);
+	if (!MeshMerger.DoMerge())
+	{
+		UE_LOG(LogProfilingDebugging, Warning, TEXT("Failed to merge attachment meshes for weapon %s"), *WeaponRowName.ToString());
+		MergedMesh = nullptr;
+	}
+	else
+	{
+		MergedMeshReferences.Add(MergedMesh);
+	}
+
+	MergedMeshes.Add(MoveTemp(Key), MergedMesh);
+	return MergedMesh;
+}
+
+void UWeaponStatsCache::Deinitialize()
+{
+	for (UDataTable* Table : ReferencedTables)
+	{
+		if (Table)
+		{
+			Table->OnDataTableChanged().RemoveAll(this);
+		}
+	}
+	ReferencedTables.Empty();
+	ResolvedStats.Empty();
+	MergedMeshes.Empty();
+	MergedMeshReferences.Empty();
+
+	Super::Deinitialize();
+}
+
+TSharedPtr<FResolvedWeaponStats> UWeaponStatsCache::ResolveStats(const UDataTable* WeaponDataTable,
+	const FName WeaponRowName, const TArray<FName>& Attachments)
+{
+	static const FString ContextString(TEXT("UWeaponStatsCache::ResolveStats"));
+
+	if (!WeaponDataTable)
+	{
+		return nullptr;
+	}
+
+	const FStaticWeaponData* WeaponRow = WeaponDataTable->FindRow<FStaticWeaponData>(WeaponRowName, ContextString, true);
+	if (!WeaponRow)
+	{
+		return nullptr;
+	}
+
+	TSharedPtr<FResolvedWeaponStats> Stats = MakeShared<FResolvedWeaponStats>();
+	FStaticWeaponData& WeaponData = Stats->WeaponData;
+	WeaponData = *WeaponRow;
+	Stats->AttachmentSlots.SetNum(static_cast<uint8>(EAttachmentType::Grip) + 1);
+
+	// Setting our default values, these can be overriden later by attachments
+	Stats->AmmoType = WeaponData.AmmoToUse;
+	Stats->ClipCapacity = WeaponData.ClipCapacity;
+	Stats->ClipSize = WeaponData.ClipSize;
+	Stats->WeaponEquip = WeaponData.WeaponEquip;
+	Stats->WalkBlendSpace = WeaponData.BS_Walk;
+	Stats->ADSWalkBlendSpace = WeaponData.BS_Ads_Walk;
+	Stats->Anim_Idle = WeaponData.Anim_Idle;
+	Stats->Anim_Sprint = WeaponData.Anim_Sprint;
+	Stats->Anim_ADS_Idle = WeaponData.Anim_Ads_Idle;
+
+	// Building the surface to impact effect table. Entries from SurfaceHitEffects are added last so that they win
+	const TPair<const UPhysicalMaterial*, UNiagaraSystem*> DamageSurfaceEffects[] = {
+		{ WeaponData.NormalDamageSurface, WeaponData.EnemyHitEffect },
+		{ WeaponData.HeadshotDamageSurface, WeaponData.EnemyHitEffect },
+		{ WeaponData.GroundSurface, WeaponData.GroundHitEffect },
+		{ WeaponData.RockSurface, WeaponData.RockHitEffect },
+	};
+	for (const TPair<const UPhysicalMaterial*, UNiagaraSystem*>& SurfaceEffect : DamageSurfaceEffects)
+	{
+		if (SurfaceEffect.Key)
+		{
+			Stats->ImpactEffects.Add(SurfaceEffect.Key, SurfaceEffect.Value);
+		}
+	}
+	for (const TPair<UPhysicalMaterial*, UNiagaraSystem*>& SurfaceEffect : WeaponData.SurfaceHitEffects)
+	{
+		if (SurfaceEffect.Key)
+		{
+			Stats->ImpactEffects.Add(SurfaceEffect.Key, SurfaceEffect.Value);
+		}
+	}
+
+	if (!WeaponData.bHasAttachments || !WeaponData.AttachmentsDataTable)
+	{
+		Stats->BakeRecoilTables();
+		return Stats;
+	}
+
+	for (const FName RowName : Attachments)
+	{
+		// Going through each of our attachments and updating our static weapon data accordingly
+		const FAttachmentData* AttachmentData = WeaponData.AttachmentsDataTable->FindRow<FAttachmentData>(RowName, ContextString, true);
+		if (!AttachmentData)
+		{
+			continue;
+		}
+
+		Stats->DamageModifier += AttachmentData->BaseDamageImpact;
+		Stats->WeaponPitchModifier += AttachmentData->WeaponPitchVariationImpact;
+		Stats->WeaponYawModifier += AttachmentData->WeaponYawVariationImpact;
+		Stats->HorizontalRecoilModifier += AttachmentData->HorizontalRecoilMultiplier;
+		Stats->VerticalRecoilModifier += AttachmentData->VerticalRecoilMultiplier;
+
+		FResolvedAttachmentSlot& Slot = Stats->AttachmentSlots[static_cast<uint8>(AttachmentData->AttachmentType)];
+		Slot.Mesh = AttachmentData->AttachmentMesh;
+		Slot.BrokenMesh = AttachmentData->AttachmentBrokenMesh;
+		Slot.PickupMesh = AttachmentData->PickupMesh;
+
+		if (AttachmentData->AttachmentType == EAttachmentType::Barrel)
+		{
+			WeaponData.MuzzleLocation = AttachmentData->MuzzleLocationOverride;
+			WeaponData.ParticleSpawnLocation = AttachmentData->ParticleSpawnLocationOverride;
+			WeaponData.bSilenced = AttachmentData->bSilenced;
+		}
+		else if (AttachmentData->AttachmentType == EAttachmentType::Magazine)
+		{
+			WeaponData.FireSound = AttachmentData->FiringSoundOverride;
+			WeaponData.SilencedSound = AttachmentData->SilencedFiringSoundOverride;
+			WeaponData.RateOfFire = AttachmentData->FireRate;
+			WeaponData.bAutomaticFire = AttachmentData->AutomaticFire;
+			WeaponData.PerShotDegradation = AttachmentData->PerShotDegradation;
+			WeaponData.VerticalRecoilCurve = AttachmentData->VerticalRecoilCurve;
+			WeaponData.HorizontalRecoilCurve = AttachmentData->HorizontalRecoilCurve;
+			WeaponData.RecoilCameraShake = AttachmentData->RecoilCameraShake;
+			WeaponData.bIsShotgun = AttachmentData->bIsShotgun;
+			WeaponData.ShotgunRange = AttachmentData->ShotgunRange;
+			WeaponData.ShotgunPellets = AttachmentData->ShotgunPellets;
+			WeaponData.EmptyWeaponReload = AttachmentData->EmptyWeaponReload;
+			WeaponData.WeaponReload = AttachmentData->WeaponReload;
+			WeaponData.EmptyPlayerReload = AttachmentData->EmptyPlayerReload;
+			WeaponData.PlayerReload = AttachmentData->PlayerReload;
+			WeaponData.Gun_Shot = AttachmentData->Gun_Shot;
+			WeaponData.WeaponDestroyedHandsAnim = AttachmentData->WeaponDestroyedHandsAnim;
+			WeaponData.WeaponDestroyedParticleSystem = AttachmentData->WeaponDestroyedParticleSystem;
+			WeaponData.AccuracyDebuff = AttachmentData->AccuracyDebuff;
+			WeaponData.AiWeaponData = AttachmentData->AiWeaponData;
+			WeaponData.AmmoToUse = AttachmentData->AmmoToUse;
+			WeaponData.ClipCapacity = AttachmentData->ClipCapacity;
+			WeaponData.ClipSize = AttachmentData->ClipSize;
+
+			Stats->AmmoType = AttachmentData->AmmoToUse;
+			Stats->ClipCapacity = AttachmentData->ClipCapacity;
+			Stats->ClipSize = AttachmentData->ClipSize;
+			Stats->bHasMagazine = true;
+		}
+		else if (AttachmentData->AttachmentType == EAttachmentType::Sights)
+		{
+			Stats->VerticalCameraOffset = AttachmentData->VerticalCameraOffset;
+			WeaponData.bAimingFOV = AttachmentData->bAimingFOV;
+			WeaponData.AimingFOVChange = AttachmentData->AimingFOVChange;
+			WeaponData.bIsScope = AttachmentData->bIsScope;
+			WeaponData.ScopeMagnification = AttachmentData->ScopeMagnification;
+			WeaponData.UnmagnifiedLFoV = AttachmentData->UnmagnifiedLFoV;
+		}
+		else if (AttachmentData->AttachmentType == EAttachmentType::Grip)
+		{
+			if (AttachmentData->WeaponEquip)
+			{
+				Stats->WeaponEquip = AttachmentData->WeaponEquip;
+			}
+			if (AttachmentData->BS_Walk)
+			{
+				Stats->WalkBlendSpace = AttachmentData->BS_Walk;
+			}
+			if (AttachmentData->BS_Ads_Walk)
+			{
+				Stats->ADSWalkBlendSpace = AttachmentData->BS_Ads_Walk;
+			}
+			if (AttachmentData->Anim_Idle)
+			{
+				Stats->Anim_Idle = AttachmentData->Anim_Idle;
+			}
+			if (AttachmentData->Anim_Sprint)
+			{
+				Stats->Anim_Sprint = AttachmentData->Anim_Sprint;
+			}
+			if (AttachmentData->Anim_Ads_Idle)
+			{
+				Stats->Anim_ADS_Idle = AttachmentData->Anim_Ads_Idle;
+			}
+		}
+	}
+
+	Stats->BakeRecoilTables();
+	return Stats;
+}
@@ -3,18 +3,37 @@
 #include "func_lib/AttachmentHelpers.h"
 #include "Math/UnrealMathUtility.h"	
 
-TArray<FName> FAttachmentHelpers::RandomiseAllAttachments(UDataTable* AttachmentDataTable)
+/** Whether a table's rows are attachments, which has to hold before its row map can be read as FAttachmentData */
+static bool IsAttachmentTable(const UDataTable* DataTable)
 {
-	TArray<FString> BarrelAttachments;
-	TArray<FString> MagazineAttachments;
-	TArray<FString> SightsAttachments;
-	TArray<FString> StockAttachments;
-	TArray<FString> GripAttachments;
-
-	// Sorting attachments into arrays by their type
-	for (FString RowKey : GetDataTableKeyColumnAsString(AttachmentDataTable))
+	const UScriptStruct* RowStruct = DataTable ? DataTable->GetRowStruct() : nullptr;
+	if (!RowStruct || !RowStruct->IsChildOf(FAttachmentData::StaticStruct()))
 	{
-		const FAttachmentData* AttachmentData = AttachmentDataTable->FindRow<FAttachmentData>(FName(*RowKey), RowKey, true);
+		UE_LOG(LogProfilingDebugging, Error, TEXT("%s is not an attachment data table, check the weapon's attachment table"),
+		       *GetNameSafe(DataTable));
+		return false;
+	}
+	return true;
+}
+
+TArray<FName> FAttachmentHelpers::RandomiseAllAttachments(UDataTable* AttachmentDataTable, const FRandomStream* RandomStream)
+{
+	if (!IsAttachmentTable(AttachmentDataTable))
+	{
+		return TArray<FName>();
+	}
+
+	TArray<FName> BarrelAttachments;
+	TArray<FName> MagazineAttachments;
+	TArray<FName> SightsAttachments;
+	TArray<FName> StockAttachments;
+	TArray<FName> GripAttachments;
+
+	// Sorting attachments into arrays by their type, walking the row map directly rather than looking each row up
+	for (const TPair<FName, uint8*>& Row : AttachmentDataTable->GetRowMap())
+	{
+		const FName RowKey = Row.Key;
+		const FAttachmentData* AttachmentData = reinterpret_cast<const FAttachmentData*>(Row.Value);
 
 		switch(AttachmentData->AttachmentType)
 		{
@@ -40,28 +59,36 @@ TArray<FName> FAttachmentHelpers::RandomiseAllAttachments(UDataTable* Attachment
 	TArray<FName> TempArray;
 
 	// Randomly adding one of each type of attachment to the array
-	TempArray.Add(FName(*BarrelAttachments[FMath::RandRange(0, BarrelAttachments.Num() - 1)]));
-	TempArray.Add(FName(*MagazineAttachments[FMath::RandRange(0, MagazineAttachments.Num() - 1)]));
-	TempArray.Add(FName(*SightsAttachments[FMath::RandRange(0, SightsAttachments.Num() - 1)]));
-	TempArray.Add(FName(*StockAttachments[FMath::RandRange(0, StockAttachments.Num() - 1)]));
-	TempArray.Add(FName(*GripAttachments[FMath::RandRange(0, GripAttachments.Num() - 1)]));
+	TempArray.Add(BarrelAttachments[RandomIndex(BarrelAttachments.Num(), RandomStream)]);
+	TempArray.Add(MagazineAttachments[RandomIndex(MagazineAttachments.Num(), RandomStream)]);
+	TempArray.Add(SightsAttachments[RandomIndex(SightsAttachments.Num(), RandomStream)]);
+	TempArray.Add(StockAttachments[RandomIndex(StockAttachments.Num(), RandomStream)]);
+	TempArray.Add(GripAttachments[RandomIndex(GripAttachments.Num(), RandomStream)]);
 	
 	return TempArray;
 }
 
 
-TArray<FName> FAttachmentHelpers::ReplaceIncompatibleAttachments(UDataTable* AttachmentDataTable, TArray<FName> CurrentAttachments)
+TArray<FName> FAttachmentHelpers::ReplaceIncompatibleAttachments(UDataTable* AttachmentDataTable, TArray<FName> CurrentAttachments, const FRandomStream* RandomStream)
 {
-	TArray<FString> BarrelAttachments;
-	TArray<FString> MagazineAttachments;
-	TArray<FString> SightsAttachments;
-	TArray<FString> StockAttachments;
-	TArray<FString> GripAttachments;
-
-	// Sorting attachments into arrays by their type
-	for (FString RowKey : GetDataTableKeyColumnAsString(AttachmentDataTable))
+	static const FString ContextString(TEXT("FAttachmentHelpers::ReplaceIncompatibleAttachments"));
+
+	if (!IsAttachmentTable(AttachmentDataTable))
+	{
+		return CurrentAttachments;
+	}
+
+	TArray<FName> BarrelAttachments;
+	TArray<FName> MagazineAttachments;
+	TArray<FName> SightsAttachments;
+	TArray<FName> StockAttachments;
+	TArray<FName> GripAttachments;
+
+	// Sorting attachments into arrays by their type, walking the row map directly rather than looking each row up
+	for (const TPair<FName, uint8*>& Row : AttachmentDataTable->GetRowMap())
 	{
-		const FAttachmentData* AttachmentData = AttachmentDataTable->FindRow<FAttachmentData>(FName(*RowKey), RowKey, true);
+		const FName RowKey = Row.Key;
+		const FAttachmentData* AttachmentData = reinterpret_cast<const FAttachmentData*>(Row.Value);
 
 		switch(AttachmentData->AttachmentType)
 		{
@@ -89,7 +116,7 @@ TArray<FName> FAttachmentHelpers::ReplaceIncompatibleAttachments(UDataTable* Att
 	// Aggregating incompatible attachments across all attachments
 	for (FName Attachment : CurrentAttachments)
 	{
-		FAttachmentData* IncompatibleAttachmentData = AttachmentDataTable->FindRow<FAttachmentData>(Attachment, Attachment.ToString(), true);
+		const FAttachmentData* IncompatibleAttachmentData = AttachmentDataTable->FindRow<FAttachmentData>(Attachment, ContextString, true);
 
 		if (IncompatibleAttachmentData)
 		{
@@ -110,7 +137,7 @@ TArray<FName> FAttachmentHelpers::ReplaceIncompatibleAttachments(UDataTable* Att
 	// lists generated above
 	for (FName RowKey : AttachmentsToReplace)
 	{
-		const FAttachmentData* AttachmentData = AttachmentDataTable->FindRow<FAttachmentData>(RowKey, RowKey.ToString(), true);
+		const FAttachmentData* AttachmentData = AttachmentDataTable->FindRow<FAttachmentData>(RowKey, ContextString, true);
 
 		switch(AttachmentData->AttachmentType)
 		{
@@ -124,7 +151,7 @@ TArray<FName> FAttachmentHelpers::ReplaceIncompatibleAttachments(UDataTable* Att
 				{
 					CurrentAttachments.Remove(RowKey);
 				}
-				BarrelAttachments.Remove(RowKey.ToString());
+				BarrelAttachments.Remove(RowKey);
 				break;
 				
 			case EAttachmentType::Magazine:
@@ -137,7 +164,7 @@ TArray<FName> FAttachmentHelpers::ReplaceIncompatibleAttachments(UDataTable* Att
 				{
 					CurrentAttachments.Remove(RowKey);
 				}
-				MagazineAttachments.Remove(RowKey.ToString());
+				MagazineAttachments.Remove(RowKey);
 				break;
 				
 			case EAttachmentType::Sights:
@@ -150,7 +177,7 @@ TArray<FName> FAttachmentHelpers::ReplaceIncompatibleAttachments(UDataTable* Att
 				{
 					CurrentAttachments.Remove(RowKey);
 				}
-				SightsAttachments.Remove(RowKey.ToString());
+				SightsAttachments.Remove(RowKey);
 				break;
 				
 			case EAttachmentType::Stock:
@@ -163,7 +190,7 @@ TArray<FName> FAttachmentHelpers::ReplaceIncompatibleAttachments(UDataTable* Att
 				{
 					CurrentAttachments.Remove(RowKey);
 				}
-				StockAttachments.Remove(RowKey.ToString());
+				StockAttachments.Remove(RowKey);
 				break;
 				
 			case EAttachmentType::Grip:
@@ -176,7 +203,7 @@ TArray<FName> FAttachmentHelpers::ReplaceIncompatibleAttachments(UDataTable* Att
 				{
 					CurrentAttachments.Remove(RowKey);
 				}
-				GripAttachments.Remove(RowKey.ToString());
+				GripAttachments.Remove(RowKey);
 				break;
 				
 			default: break;
@@ -189,23 +216,23 @@ TArray<FName> FAttachmentHelpers::ReplaceIncompatibleAttachments(UDataTable* Att
 	{
 		if (Type == EAttachmentType::Barrel)
 		{
-			CurrentAttachments.Add(FName(*BarrelAttachments[FMath::RandRange(0, BarrelAttachments.Num() - 1)]));
+			CurrentAttachments.Add(BarrelAttachments[RandomIndex(BarrelAttachments.Num(), RandomStream)]);
 		}
 		else if (Type == EAttachmentType::Magazine)
 		{
-			CurrentAttachments.Add(FName(*MagazineAttachments[FMath::RandRange(0, MagazineAttachments.Num() - 1)]));
+			CurrentAttachments.Add(MagazineAttachments[RandomIndex(MagazineAttachments.Num(), RandomStream)]);
 		}
 		else if (Type == EAttachmentType::Sights)
 		{
-			CurrentAttachments.Add(FName(*SightsAttachments[FMath::RandRange(0, SightsAttachments.Num() - 1)]));
+			CurrentAttachments.Add(SightsAttachments[RandomIndex(SightsAttachments.Num(), RandomStream)]);
 		}
 		else if (Type == EAttachmentType::Stock)
 		{
-			CurrentAttachments.Add(FName(*StockAttachments[FMath::RandRange(0, StockAttachments.Num() - 1)]));
+			CurrentAttachments.Add(StockAttachments[RandomIndex(StockAttachments.Num(), RandomStream)]);
 		}
 		else if (Type == EAttachmentType::Grip)
 		{
-			CurrentAttachments.Add(FName(*GripAttachments[FMath::RandRange(0, GripAttachments.Num() - 1)]));
+			CurrentAttachments.Add(GripAttachments[RandomIndex(GripAttachments.Num(), RandomStream)]);
 		}
 	}
 	
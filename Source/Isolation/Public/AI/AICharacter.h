@@ -5,9 +5,14 @@
 #include "CoreMinimal.h"
 #include "WeaponBase.h"
 #include "FPSCharacter.h"
+#include "AI/AIManager.h"
 #include "Perception/AIPerceptionComponent.h"
 #include "AICharacter.generated.h"
 
+class AAICharacterController;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FCombatRoleChangedDelegate, ECombatRole, NewRole);
+
 /**
  * 
  */
@@ -27,13 +32,64 @@ public:
 	UFUNCTION(BlueprintCallable)
 	AWeaponBase* GetCurrentWeapon() const { return CurrentWeapon; }
 
+	/** Returns our current weapon to the weapon pool */
+	void ReleaseWeapon();
+
+	/** Returns the seed our loadout is drawn from */
+	int32 GetLoadoutSeed() const { return LoadoutSeed; }
+
+	/** Sets the seed our loadout is drawn from. Only takes effect if called before BeginPlay */
+	void SetLoadoutSeed(const int32 NewLoadoutSeed) { LoadoutSeed = NewLoadoutSeed; }
+
+	/** Asks the AI manager for a firing token. The AI fires at its target whenever it holds one */
 	UFUNCTION(BlueprintCallable, Category = "AI Character")
 	void StartFire();
 
+	/** Gives up the AI's firing token, if it has one, and stops firing */
 	UFUNCTION(BlueprintCallable, Category = "AI Character")
 	void StopFire();
 
+	/** Returns the actor our controller is targeting, if any */
+	AActor* GetTargetActor() const;
+
+	/** Returns whether our controller knows of a target, either in sight or seen recently */
+	bool HasKnownTarget() const;
+
+	/** Returns the squad we belong to. Combat roles are shared out within each squad */
+	int32 GetSquadId() const { return SquadId; }
+
+	/** Sets the squad we belong to. Only takes effect if called before BeginPlay */
+	void SetSquadId(const int32 NewSquadId) { SquadId = NewSquadId; }
+
+	/** Returns the role the AI manager has given us in our squad's fight */
+	UFUNCTION(BlueprintPure, Category = "AI Character")
+	ECombatRole GetCombatRole() const { return CombatRole; }
+
+	/** Sets our combat role. Called by the AI manager, which decides who plays each role */
+	void SetCombatRole(ECombatRole NewRole);
+
+	/** Broadcast when the AI manager gives us a new combat role */
+	UPROPERTY(BlueprintAssignable, Category = "Events")
+	FCombatRoleChangedDelegate OnCombatRoleChanged;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	virtual void GetActorEyesViewPoint(FVector& OutLocation, FRotator& OutRotation) const override;
+
+	/** Caches our controller, so that firing doesn't need to cast to it */
+	virtual void PossessedBy(AController* NewController) override;
+
+	virtual void UnPossessed() override;
+
+	/** AI fire from the weapon's muzzle, towards their controller's target */
+	virtual bool GetShotAim(const AWeaponBase* Weapon, FVector& OutOrigin, FRotator& OutAimRotation) const override;
+
+	virtual bool IsAimingWeapon() const override { return false; }
+
+	virtual bool IsAiWeaponOwner() const override { return true; }
+
+	/** AI weapons don't degrade */
+	virtual void OnWeaponBroken(AWeaponBase* Weapon) override {}
 	
 private:
 
@@ -42,4 +98,16 @@ private:
 	
 	UPROPERTY()
 	AWeaponBase* CurrentWeapon;
+
+	/** The controller possessing us, cached in PossessedBy */
+	TWeakObjectPtr<AAICharacterController> AiController;
+
+	/** The squad we belong to */
+	UPROPERTY(EditInstanceOnly, Category = "AI Character")
+	int32 SquadId = 0;
+
+	ECombatRole CombatRole = ECombatRole::None;
+
+	/** The seed our loadout is drawn from. Zero picks a random seed on BeginPlay */
+	int32 LoadoutSeed = 0;
 };
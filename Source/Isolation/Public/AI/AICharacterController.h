@@ -4,13 +4,20 @@
 
 #include "CoreMinimal.h"
 #include "AIController.h"
+#include "AI/HearingSubsystem.h"
+#include "AI/UtilityAISubsystem.h"
 #include "Perception/AISense.h"
 #include "AICharacterController.generated.h"
 
 class UAISenseConfig_Sight;
+class UTargetSelectionComponent;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FPerceptionUpdateHandlingDelegate, const TArray<AActor*>&, UpdatedActors);
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FNoiseHeardDelegate, FVector, Location, ENoiseType, Type, AActor*, Instigator);
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FUtilityActionChangedDelegate, EUtilityAction, NewAction);
+
 UENUM()
 enum class Attitude : uint8
 {
@@ -47,22 +54,91 @@ public:
 	UPROPERTY(EditDefaultsOnly)
 	UAIPerceptionComponent* AiPerceptionComponent;
 
+	UPROPERTY(EditDefaultsOnly)
+	UTargetSelectionComponent* TargetSelectionComponent;
+
 	// Overriding team
 	virtual ETeamAttitude::Type GetTeamAttitudeTowards(const AActor& Other) const override;
 
 	UPROPERTY(BlueprintAssignable, Category = "Events")
 	FPerceptionUpdateHandlingDelegate PerceptionUpdateHandlingDelegate;
 
+	/** Broadcast when we hear a noise, at most once per frame with the loudest noise heard */
+	UPROPERTY(BlueprintAssignable, Category = "Events")
+	FNoiseHeardDelegate OnNoiseHeard;
+
+	/** Broadcast when the utility AI chooses a new action for us. Taking cover and flanking are started natively */
+	UPROPERTY(BlueprintAssignable, Category = "Events")
+	FUtilityActionChangedDelegate OnUtilityActionChanged;
+
 	virtual void BeginPlay() override;
 
+	virtual void OnPossess(APawn* InPawn) override;
+
+	virtual void OnUnPossess() override;
+
 	UFUNCTION(BlueprintCallable)
 	AActor* GetTargetActor() const { return TargetActor; }
 
+	/** Finds and claims the best baked cover from our target, if we are allowed to take cover
+	 *	@param SearchRadius How far from our pawn to look for cover
+	 *	@param OutCoverLocation The location of the cover found
+	 *	@return Whether cover was found
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Cover")
+	bool FindCoverFromTarget(float SearchRadius, FVector& OutCoverLocation);
+
+	/** Asks the flank planner for a flank around our target, moving to it once planned
+	 *	@return Whether a flank is being planned
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Flanking")
+	bool FlankTarget();
+
+	/** Called by the hearing subsystem with the loudest noise we heard this frame
+	 *	@param Noise The noise heard
+	 *	@param Strength How loud the noise was where we heard it, from 0 at the edge of its radius to 1 at its source
+	 */
+	void HearNoise(const FNoiseEvent& Noise, float Strength);
+
+	/** Returns where we last heard a noise, if it was recent enough
+	 *	@param MaxAge How long ago, in seconds, the noise may have been heard
+	 *	@param OutLocation Where the noise was made
+	 *	@return Whether a noise was heard within MaxAge
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Hearing")
+	bool GetLastHeardNoise(float MaxAge, FVector& OutLocation) const;
+
+	/** Returns the action the utility AI last chose for us */
+	UFUNCTION(BlueprintPure, Category = "Utility AI")
+	EUtilityAction GetUtilityAction() const { return UtilityAction; }
+
+	/** Sets the action we are taking, starting it if it is one handled natively. Called by the utility AI */
+	void SetUtilityAction(EUtilityAction NewAction);
+
+	/** Returns the closest we want to be to our target */
+	float GetCombatMinDistance() const { return CombatMinDistance; }
+
+	/** Returns the furthest we want to be from our target */
+	float GetCombatMaxDistance() const { return CombatMaxDistance; }
+
+	/** Returns whether we prefer to push the fight rather than hold back */
+	bool IsAggressive() const { return Attitude == Attitude::Aggressive; }
+
+	/** Returns whether we may take cover */
+	bool CanTakeCover() const { return bAllowCover; }
+
+	/** Returns whether we may wait in ambush */
+	bool CanAmbush() const { return bAllowAmbush; }
+
 private:
 
-	float CombatMinDistance;
+	/** The closest we want to be to our target */
+	UPROPERTY(EditDefaultsOnly, Category = "Combat")
+	float CombatMinDistance = 500.0f;
 
-	float CombatMaxDistance;
+	/** The furthest we want to be from our target */
+	UPROPERTY(EditDefaultsOnly, Category = "Combat")
+	float CombatMaxDistance = 2500.0f;
 
 	Attitude Attitude;
 
@@ -70,25 +146,43 @@ private:
 
 	PreferredEngagementRange PreferredEngagementRange;
 
-	bool bAllowCover;
+	/** Whether this AI may take cover */
+	UPROPERTY(EditDefaultsOnly, Category = "Cover")
+	bool bAllowCover = true;
 
-	bool bAllowAmbush;
+	/** Whether this AI may wait in ambush for targets that have gone out of sight */
+	UPROPERTY(EditDefaultsOnly, Category = "Combat")
+	bool bAllowAmbush = false;
 
 	bool bAllowHardpointAssignment;
 	
 	UPROPERTY()
 	AActor* TargetActor;
 
-	int Partition(TArray<AActor*> *InArray, int Start, int End) const;
+	/** Where we last heard a noise */
+	FVector LastHeardNoiseLocation = FVector::ZeroVector;
+
+	/** When we last heard a noise, or a negative time if we never have */
+	float LastHeardNoiseTime = -1.0f;
 
-	void QuickSort(TArray<AActor*> *InArray, int Start, int End);
+	/** The action the utility AI last chose for us */
+	EUtilityAction UtilityAction = EUtilityAction::None;
 
 	UFUNCTION()
 	void HandlePerceptionUpdate(const TArray<AActor*>& UpdatedActors);
 
+	/** Moves to the flank location, if the planner found one */
+	void HandleFlankPlanned(bool bFound, const FVector& FlankLocation);
+
+	/** Re-ranks the perceived actors and targets the best one that is visible */
 	UFUNCTION(BlueprintCallable)
 	void UpdateTargetActor();
 
-	UPROPERTY()
-	TArray<AActor*> TargetsArray;
+	/** Puts our pawn back to full update rate, for when it has something to react to */
+	void PromotePawnSignificance() const;
+
+	/** Passes damage dealt to our pawn on to the target selection, so that whoever is hurting us is prioritised */
+	UFUNCTION()
+	void HandlePawnTakeAnyDamage(AActor* DamagedActor, float Damage, const UDamageType* DamageType,
+	                             AController* InstigatedBy, AActor* DamageCauser);
 };
@@ -3,9 +3,27 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Tickable.h"
 #include "Subsystems/WorldSubsystem.h"
+#include "AI/AgentSpatialHash.h"
 #include "AIManager.generated.h"
 
+class AAICharacter;
+class AFPSCharacter;
+
+/** The part an AI plays in its squad's fight. Earlier roles take priority when slots are handed out */
+UENUM(BlueprintType)
+enum class ECombatRole : uint8
+{
+	None,
+	/** Fights the target directly */
+	Engager,
+	/** Waits in ambush for a target that has been seen recently */
+	Ambusher,
+	/** Hunts for a target that has been seen recently */
+	Searcher
+};
+
 /**
  * 
  */
@@ -27,9 +45,11 @@ struct FGlobalCombatParameters
 	UPROPERTY(EditInstanceOnly, Category = "Global Combat Parameters")
 	float EngagerReplacementDelay;
 
+	/** The number of firing token holders whose shots are never held back by the per-frame AI trace budget */
 	UPROPERTY(EditInstanceOnly, Category = "Global Combat Parameters")
 	int MinShooters;
 
+	/** The number of AI allowed to hold a firing token at once. Zero leaves the number of shooters unlimited */
 	UPROPERTY(EditInstanceOnly, Category = "Global Combat Parameters")
 	int MaxShooters;
 
@@ -55,24 +75,251 @@ struct FGlobalCombatParameters
 	float MoveFlankDistanceReset;
 };
 
+/** An AI that wants to fire, and its place in the firing token rotation */
+struct FAiShooter
+{
+	TWeakObjectPtr<AAICharacter> Character;
+
+	/** Whether the AI currently holds a firing token, and so is allowed to fire */
+	bool bHasToken = false;
+
+	/** The world time at which the AI's next shot is due */
+	float NextFireTime = 0.0f;
+
+	/** How long the AI has been waiting for a token. Waiting AI are gradually favoured over current holders, so that
+	 *	tokens rotate between everyone engaged */
+	float TimeWithoutToken = 0.0f;
+
+	/** How strongly the AI deserves a token, from the threat it poses to its target and how close it is */
+	float Priority = 0.0f;
+};
+
+/** An AI taking part in role assignment */
+struct FRoleAgent
+{
+	/** The AI's key in RoleAgentIndices, kept here as the raw pointer can't be recovered once the actor has gone */
+	const AAICharacter* Key = nullptr;
+
+	TWeakObjectPtr<AAICharacter> Character;
+
+	int32 SquadId = 0;
+
+	ECombatRole Role = ECombatRole::None;
+
+	/** Whether the AI is waiting in the dirty queue to be re-evaluated */
+	bool bQueued = false;
+};
+
+/** The roles held within one squad */
+struct FCombatSquad
+{
+	/** The number of members holding each role, indexed by ECombatRole */
+	int32 RoleCounts[4] = {0, 0, 0, 0};
+
+	/** Freed engager slots stay closed until this world time, so that engagers aren't replaced straight away */
+	float EngagerReopenTime = 0.0f;
+
+	TArray<const AAICharacter*> Members;
+};
+
+/** A squad member whose sight traces are shared with the members of its squad around it */
+struct FSightRepresentative
+{
+	TWeakObjectPtr<const AActor> Observer;
+
+	/** Where the representative last looked from */
+	FVector EyeLocation = FVector::ZeroVector;
+
+	/** When the representative last looked. Representatives that stop looking are replaced */
+	float LastQueryTime = 0.0f;
+};
+
+/**
+ * Coordinates AI combat across the level. AI that want to fire request a firing token, and only token holders are
+ * fired, on the manager's tick rather than on a timer per AI. Tokens are capped by MaxShooters and rotated by threat,
+ * distance and time spent waiting, and the number of AI traces made per frame is capped, so that the cost of combat
+ * stays predictable however many AI are alerted.
+ *
+ * The manager also keeps every AI and player in a spatial hash, so that squad logic can ask who is near a location
+ * without iterating every actor in the level.
+ *
+ * Combat roles are handed out per squad, up to the counts in the global combat parameters. Roles are solved
+ * incrementally: only AI whose situation has changed are re-evaluated, a few per frame, along with a slow rolling check
+ * that catches AI drifting out of range. Freeing a role re-evaluates only the squad members that could take it.
+ *
+ * Sight is shared within squads. A few members of each squad act as representatives and trace to the target, and
+ * members close to a representative take its result, as long as the two look at the target from nearly the same
+ * direction. The number of sight traces then grows with the number of squads rather than the number of AI.
+ */
 UCLASS()
-class ISOLATION_API UAIManager : public UWorldSubsystem
+class ISOLATION_API UAIManager : public UWorldSubsystem, public FTickableGameObject
 {
 	GENERATED_BODY()
 	
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 
+	virtual void Deinitialize() override;
+
 public:
 
+	/** Adds an AI to the firing token rotation. The AI fires whenever it holds a token and its weapon is ready
+	 *	@param Character The AI that wants to fire
+	 */
+	void RequestFiringToken(AAICharacter* Character);
+
+	/** Removes an AI from the firing token rotation, giving up its token if it holds one
+	 *	@param Character The AI that has stopped firing
+	 */
+	void ReleaseFiringToken(AAICharacter* Character);
+
+	/** Whether the given AI currently holds a firing token */
+	bool HasFiringToken(const AAICharacter* Character) const;
+
+	/** Adds a character to the spatial hash, making it visible to neighbour queries
+	 *	@param Agent The character to add
+	 *	@param Type Whether the character is an AI or a player
+	 */
+	void RegisterAgent(AActor* Agent, EAgentType Type);
+
+	/** Removes a character from the spatial hash */
+	void UnregisterAgent(const AActor* Agent);
+
+	/** Finds every registered agent of the given types within a radius of a location
+	 *	@param Center The location to search around
+	 *	@param Radius The distance to search within
+	 *	@param Types The kinds of agent to include
+	 *	@param OutAgents Emptied, then filled with the agents found. Reusing the array between calls avoids allocating
+	 *	@param IgnoreAgent An agent to leave out of the results, usually the one asking
+	 */
+	void FindAgentsInRadius(const FVector& Center, const float Radius, const EAgentType Types, TArray<AActor*>& OutAgents,
+	                        const AActor* IgnoreAgent = nullptr) const
+	{
+		SpatialHash.FindInRadius(Center, Radius, Types, OutAgents, IgnoreAgent);
+	}
+
+	/** Finds the closest registered agents of the given types to a location
+	 *	@param Center The location to search around
+	 *	@param MaxRadius The furthest away an agent may be
+	 *	@param MaxResults The most agents to return
+	 *	@param Types The kinds of agent to include
+	 *	@param OutNearest Emptied, then filled with the agents found, closest first. Reusing the array between calls
+	 *	avoids allocating
+	 *	@param IgnoreAgent An agent to leave out of the results, usually the one asking
+	 */
+	void FindNearestAgents(const FVector& Center, const float MaxRadius, const int32 MaxResults, const EAgentType Types,
+	                       TArray<FNearestAgent>& OutNearest, const AActor* IgnoreAgent = nullptr) const
+	{
+		SpatialHash.FindNearest(Center, MaxRadius, MaxResults, Types, OutNearest, IgnoreAgent);
+	}
+
+	/** Queues an AI to have its combat role re-evaluated, for when it gains or loses sight of its target */
+	void MarkCombatRoleDirty(const AAICharacter* Character);
+
+	/** Returns whether a target is visible to an AI, sharing the sight traces of nearby members of its squad
+	 *	@param Target The character being looked for
+	 *	@param Observer The AI looking
+	 *	@param ObserverLocation Where the AI is looking from
+	 *	@param OutSeenLocation The location of the target that was seen, if it was
+	 *	@return Whether the target is visible, either from the AI's own traces or derived from a squad member's
+	 */
+	bool QuerySquadVisibility(const AFPSCharacter* Target, const AActor* Observer, const FVector& ObserverLocation,
+	                          FVector& OutSeenLocation);
+
+	/** Returns the spatial hash of every registered agent, for queries that visit agents in place */
+	const FAgentSpatialHash& GetSpatialHash() const { return SpatialHash; }
+
+	/** Moves agents between spatial hash cells, rotates the firing tokens and fires every token holder whose shot is
+	 *	due */
+	virtual void Tick(float DeltaTime) override;
+
+	/** We only need to tick while there are agents to keep track of or AI wanting to fire */
+	virtual bool IsTickable() const override { return SpatialHash.Num() > 0 || Shooters.Num() > 0; }
+
+	virtual ETickableTickType GetTickableTickType() const override
+	{
+		return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+	}
+
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UAIManager, STATGROUP_Tickables); }
+
+	/** Returns the global combat parameters currently in effect */
+	const FGlobalCombatParameters& GetGlobalCombatParameters() const { return GlobalCombatParameters; }
+
 	/**	Updates the global combat parameters */
 	void UpdateGlobalCombatParameters(const FGlobalCombatParameters NewGlobalCombatParameters)
 	{
 		GlobalCombatParameters = NewGlobalCombatParameters;
+		bTokensDirty = true;
+
+		// The role counts may have changed, so every AI is re-evaluated, spread over the following frames
+		for (const FRoleAgent& RoleAgent : RoleAgents)
+		{
+			MarkCombatRoleDirty(RoleAgent.Key);
+		}
 
 		GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, FString::SanitizeFloat(GlobalCombatParameters.MinShooters));
 	}
 
 private:
 
+	/** Re-scores every shooter and hands the firing tokens to the highest priorities */
+	void RotateFiringTokens();
+
+	/** Fires every token holder whose shot is due, within the frame's trace budget */
+	void FireTokenHolders();
+
+	/** Re-evaluates the queued AI's roles, then a few more in turn, within the frame's budgets */
+	void UpdateCombatRoles();
+
+	/** Gives an AI the best role it is eligible for that has a free slot in its squad, keeping its current role where
+	 *	it can */
+	void AssignCombatRole(FRoleAgent& RoleAgent);
+
+	/** Moves an AI from its current role to a new one, updating its squad and queueing any squad members that could
+	 *	take the role it gave up */
+	void SetCombatRole(FRoleAgent& RoleAgent, FCombatSquad& Squad, ECombatRole NewRole);
+
+	/** Returns the number of AI each squad may have in a role */
+	int32 GetRoleLimit(ECombatRole Role) const;
+
+	/** Removes an AI from role assignment, freeing its role */
+	void RemoveRoleAgent(const AAICharacter* Character);
+
+	/** Drops sight representatives that have gone or stopped looking, so that their squad members take over */
+	void ExpireSightRepresentatives();
+
 	FGlobalCombatParameters GlobalCombatParameters;
+
+	/** Every AI that wants to fire */
+	TArray<FAiShooter> Shooters;
+
+	/** Time since the firing tokens were last rotated */
+	float TimeSinceTokenRotation = 0.0f;
+
+	/** Set when a shooter is added or removed, so that tokens are handed out straight away rather than on the next
+	 *	rotation */
+	bool bTokensDirty = false;
+
+	/** Every registered AI and player, bucketed by location */
+	FAgentSpatialHash SpatialHash;
+
+	/** Every AI taking part in role assignment */
+	TArray<FRoleAgent> RoleAgents;
+
+	/** Index into RoleAgents for each AI */
+	TMap<const AAICharacter*, int32> RoleAgentIndices;
+
+	/** The squads with at least one member, by squad id */
+	TMap<int32, FCombatSquad> Squads;
+
+	/** AI waiting to have their roles re-evaluated, oldest first */
+	TArray<const AAICharacter*> DirtyRoleAgents;
+
+	/** The next AI to be checked by the rolling role check */
+	int32 NextRoleCheck = 0;
+
+	/** The AI whose sight traces are shared with the rest of their squad, by squad id */
+	TMap<int32, TArray<FSightRepresentative, TInlineAllocator<4>>> SightRepresentatives;
 };
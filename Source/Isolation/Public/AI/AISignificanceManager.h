@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Components/SkinnedMeshComponent.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AISignificanceManager.generated.h"
+
+class AAICharacter;
+
+/** How much an AI matters to the player right now, which decides how often it ticks, perceives and animates */
+UENUM(BlueprintType)
+enum class EAiSignificance : uint8
+{
+	/** Close, visible or fighting. Runs at full rate */
+	High,
+	/** Nearby or visible, but not a direct threat */
+	Medium,
+	/** Far away and out of sight */
+	Low
+};
+
+/** An AI whose update rates are managed, and the rates it started with */
+struct FAiSignificanceAgent
+{
+	/** The agent's key in AgentIndices, kept here as the raw pointer can't be recovered once the actor has gone */
+	const AAICharacter* Key = nullptr;
+
+	TWeakObjectPtr<AAICharacter> Character;
+
+	EAiSignificance Significance = EAiSignificance::High;
+
+	/** When the agent last became low significance */
+	float LowSinceTime = 0.0f;
+
+	float DefaultActorTickInterval = 0.0f;
+
+	float DefaultMovementTickInterval = 0.0f;
+
+	float DefaultMeshTickInterval = 0.0f;
+
+	EVisibilityBasedAnimTickOption DefaultAnimTickOption = EVisibilityBasedAnimTickOption::AlwaysTickPose;
+};
+
+/**
+ * Buckets AI by their distance from the player's view, whether they have been rendered recently and their combat role,
+ * and lowers the tick intervals, line of sight rate and animation rate of the less significant ones. Agents are
+ * re-bucketed a few per frame, and are promoted straight back to full rate when something makes them relevant, such as
+ * seeing a target, being shot or being given a role.
+ */
+UCLASS()
+class ISOLATION_API UAISignificanceManager : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	/** Starts managing an AI's update rates, remembering its current rates as its full rate */
+	void RegisterAgent(AAICharacter* Character);
+
+	/** Stops managing an AI, restoring its full rates */
+	void UnregisterAgent(AAICharacter* Character);
+
+	/** Puts an AI back to full rate straight away, for when something has made it relevant */
+	void PromoteAgent(const AAICharacter* Character);
+
+	/** Returns the number of AI being managed */
+	int32 GetNumAgents() const { return Agents.Num(); }
+
+	/** Returns the significance an AI was last given */
+	EAiSignificance GetSignificance(const AAICharacter* Character) const;
+
+	/** Finds the AI that have been low significance for at least the given time, which could be made dormant
+	 *	@param MinLowTime How long an AI has to have been low significance
+	 *	@param OutCandidates Emptied, then filled with the AI found
+	 */
+	void GetDormancyCandidates(float MinLowTime, TArray<AAICharacter*>& OutCandidates) const;
+
+	/** Re-buckets this frame's share of the agents */
+	virtual void Tick(float DeltaTime) override;
+
+	/** We only need to tick while there are agents to manage */
+	virtual bool IsTickable() const override { return Agents.Num() > 0; }
+
+	virtual ETickableTickType GetTickableTickType() const override
+	{
+		return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+	}
+
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UAISignificanceManager, STATGROUP_Tickables); }
+
+private:
+
+	/** Works out an agent's significance from where the player is looking from */
+	EAiSignificance EvaluateSignificance(const AAICharacter* Character, const FVector& ViewLocation) const;
+
+	/** Applies the update rates for a significance to an agent */
+	void ApplySignificance(FAiSignificanceAgent& Agent, EAiSignificance NewSignificance);
+
+	/** Every managed AI */
+	TArray<FAiSignificanceAgent> Agents;
+
+	/** Index into Agents for each managed AI */
+	TMap<const AAICharacter*, int32> AgentIndices;
+
+	/** The next agent to be re-bucketed */
+	int32 NextAgent = 0;
+};
@@ -0,0 +1,158 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** The kinds of agent kept in the spatial hash, combined as flags to filter queries */
+enum class EAgentType : uint8
+{
+	None = 0,
+	AI = 1 << 0,
+	Player = 1 << 1,
+	All = AI | Player
+};
+ENUM_CLASS_FLAGS(EAgentType);
+
+/** An actor registered with the spatial hash */
+struct FSpatialAgent
+{
+	/** The agent's key in AgentIndices, kept here as the raw pointer can't be recovered once the actor has gone */
+	const AActor* Key = nullptr;
+
+	TWeakObjectPtr<AActor> Actor;
+
+	/** Where the actor was when the hash was last updated */
+	FVector Location = FVector::ZeroVector;
+
+	/** The cell the actor is stored in */
+	FIntPoint Cell = FIntPoint::ZeroValue;
+
+	EAgentType Type = EAgentType::None;
+};
+
+/** An agent found by a nearest agents query, and its squared distance from the query location */
+struct FNearestAgent
+{
+	AActor* Actor = nullptr;
+
+	float DistanceSquared = 0.0f;
+};
+
+/**
+ * A uniform grid over the level's XY plane, bucketing agents by cell so that "who is near" queries only visit the cells
+ * overlapping the query rather than every agent. Agents are moved between cells as they are updated, and queries write
+ * into caller owned arrays so that they don't allocate once those arrays have grown. Game thread only.
+ */
+class ISOLATION_API FAgentSpatialHash
+{
+public:
+
+	/** @param InCellSize The width of each cell. Queries are fastest when their radius is on the order of a cell */
+	explicit FAgentSpatialHash(float InCellSize = 1000.0f);
+
+	/** Empties the hash and changes its cell size */
+	void Reset(float InCellSize);
+
+	/** Adds an actor to the hash at its current location. Adding an actor twice does nothing */
+	void Add(AActor* Actor, EAgentType Type);
+
+	/** Removes an actor from the hash, if it is in it */
+	void Remove(const AActor* Actor);
+
+	/** Refreshes the location of every agent, moving those that have changed cell and dropping any that have been
+	 *	destroyed */
+	void Update();
+
+	/** Finds every agent of the given types within a radius of a location
+	 *	@param Center The location to search around
+	 *	@param Radius The distance to search within
+	 *	@param Types The kinds of agent to include
+	 *	@param OutActors Emptied, then filled with the agents found, in no particular order
+	 *	@param IgnoreActor An actor to leave out of the results, usually the one asking
+	 */
+	void FindInRadius(const FVector& Center, float Radius, EAgentType Types, TArray<AActor*>& OutActors,
+	                  const AActor* IgnoreActor = nullptr) const;
+
+	/** Finds the closest agents of the given types to a location, searching outward a ring of cells at a time
+	 *	@param Center The location to search around
+	 *	@param MaxRadius The furthest away an agent may be
+	 *	@param MaxResults The most agents to return
+	 *	@param Types The kinds of agent to include
+	 *	@param OutNearest Emptied, then filled with up to MaxResults agents, closest first
+	 *	@param IgnoreActor An actor to leave out of the results, usually the one asking
+	 */
+	void FindNearest(const FVector& Center, float MaxRadius, int32 MaxResults, EAgentType Types,
+	                 TArray<FNearestAgent>& OutNearest, const AActor* IgnoreActor = nullptr) const;
+
+	/** Calls a function for every agent of the given types within a radius of a location, without gathering them first
+	 *	@param Func Called with the agent and its squared distance from the center
+	 */
+	template <typename FuncType>
+	void ForEachInRadius(const FVector& Center, const float Radius, const EAgentType Types, FuncType Func) const
+	{
+		const float RadiusSquared = FMath::Square(Radius);
+		const FIntPoint MinCell = GetCell(Center - FVector(Radius));
+		const FIntPoint MaxCell = GetCell(Center + FVector(Radius));
+		for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+			{
+				const FCellAgents* CellAgents = Cells.Find(FIntPoint(X, Y));
+				if (!CellAgents)
+				{
+					continue;
+				}
+
+				for (const int32 AgentIndex : *CellAgents)
+				{
+					const FSpatialAgent& Agent = Agents[AgentIndex];
+					const float DistanceSquared = FVector::DistSquared(Center, Agent.Location);
+					if (EnumHasAnyFlags(Types, Agent.Type) && DistanceSquared <= RadiusSquared)
+					{
+						if (AActor* Actor = Agent.Actor.Get())
+						{
+							Func(Actor, DistanceSquared);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	/** Returns the number of agents in the hash */
+	int32 Num() const { return Agents.Num(); }
+
+	/** Returns every agent in the hash, for passes that visit all of them */
+	const TArray<FSpatialAgent>& GetAgents() const { return Agents; }
+
+private:
+
+	typedef TArray<int32, TInlineAllocator<8>> FCellAgents;
+
+	/** Returns the cell containing a location */
+	FIntPoint GetCell(const FVector& Location) const
+	{
+		return FIntPoint(FMath::FloorToInt(Location.X * InvCellSize), FMath::FloorToInt(Location.Y * InvCellSize));
+	}
+
+	/** Removes the agent at the given index, keeping the cells and AgentIndices up to date */
+	void RemoveAt(int32 Index);
+
+	/** Visits the agents in one cell, keeping the closest MaxResults in OutNearest */
+	void GatherNearestInCell(const FIntPoint& Cell, const FVector& Center, float MaxRadiusSquared, int32 MaxResults,
+	                         EAgentType Types, TArray<FNearestAgent>& OutNearest, const AActor* IgnoreActor) const;
+
+	/** Every registered agent */
+	TArray<FSpatialAgent> Agents;
+
+	/** Index into Agents for each registered actor */
+	TMap<const AActor*, int32> AgentIndices;
+
+	/** Indices into Agents for the agents in each occupied cell */
+	TMap<FIntPoint, FCellAgents> Cells;
+
+	float CellSize;
+
+	float InvCellSize;
+};
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI/CoverPointAsset.h"
+#include "GameFramework/Actor.h"
+#include "CoverGenerator.generated.h"
+
+/**
+ * Bakes the cover points for a level and hands them to the cover subsystem when play begins. Generation samples the
+ * navmesh's boundary edges, traces from each sample towards any geometry beside it at crouching and standing height,
+ * and runs the traces across every core. The result is saved as a UCoverPointAsset, so that no cover traces are made
+ * during play. Place one in each level that uses cover.
+ */
+UCLASS()
+class ISOLATION_API ACoverGenerator : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	ACoverGenerator();
+
+#if WITH_EDITOR
+	/** Generates cover points from the level's navmesh and saves them to CoverAsset, creating the asset if needed */
+	UFUNCTION(CallInEditor, Category = "Cover Generation")
+	void GenerateCover();
+#endif
+
+protected:
+
+	/** Loads the baked cover points into the cover subsystem */
+	virtual void BeginPlay() override;
+
+	/** The baked cover points for this level */
+	UPROPERTY(EditInstanceOnly, Category = "Cover Generation")
+	UCoverPointAsset* CoverAsset;
+
+	/** Where new cover assets are created, named after the level */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation")
+	FString CoverAssetPath = TEXT("/Game/AI/Cover");
+
+	/** The distance between samples along each navmesh edge */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation", meta = (ClampMin = "10.0"))
+	float SampleSpacing = 75.0f;
+
+	/** Samples closer than this to an existing cover point are discarded */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation", meta = (ClampMin = "0.0"))
+	float MinPointSpacing = 50.0f;
+
+	/** How far from the navmesh edge geometry has to be to count as cover */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation", meta = (ClampMin = "1.0"))
+	float CoverProbeDistance = 100.0f;
+
+	/** The height above the navmesh that must be blocked for crouching cover */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation")
+	float CrouchCoverHeight = 60.0f;
+
+	/** The height above the navmesh that must be blocked for standing cover */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation")
+	float StandCoverHeight = 150.0f;
+
+	/** The channel traced against to find blocking geometry */
+	UPROPERTY(EditAnywhere, Category = "Cover Generation")
+	TEnumAsByte<ECollisionChannel> CoverTraceChannel = ECC_Visibility;
+
+private:
+
+#if WITH_EDITOR
+	/** Gathers evenly spaced samples along every boundary edge of the navmesh, with the direction facing off the edge */
+	void GatherEdgeSamples(TArray<FVector>& OutLocations, TArray<FVector>& OutNormals) const;
+
+	/** Drops points that are too close to a point already kept */
+	void RemoveDuplicatePoints(TArray<FCoverPoint>& CoverPoints) const;
+
+	/** Creates a new cover asset for this level, or returns null if it couldn't be created */
+	UCoverPointAsset* CreateCoverAsset() const;
+#endif
+};
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "CoverPointAsset.generated.h"
+
+/** The kinds of cover a point provides */
+enum class ECoverType : uint8
+{
+	None = 0,
+	/** Blocks fire at crouching height only, so the AI can shoot over it */
+	Crouch = 1 << 0,
+	/** Blocks fire at standing height as well */
+	Stand = 1 << 1
+};
+ENUM_CLASS_FLAGS(ECoverType);
+
+/** A baked cover point. Kept small, as a level can have thousands of them */
+struct FCoverPoint
+{
+	/** The point on the navmesh the AI stands on to take cover */
+	FVector Location = FVector::ZeroVector;
+
+	/** The direction the cover protects from, as a yaw quantised to 256 steps */
+	uint8 PackedYaw = 0;
+
+	ECoverType Type = ECoverType::None;
+
+	/** Returns the unit direction, on the XY plane, that the cover protects from */
+	FVector GetDirection() const
+	{
+		float Sin, Cos;
+		FMath::SinCos(&Sin, &Cos, PackedYaw * (2.0f * PI / 256.0f));
+		return FVector(Cos, Sin, 0.0f);
+	}
+
+	/** Stores the direction the cover protects from, flattened onto the XY plane */
+	void SetDirection(const FVector& Direction)
+	{
+		const float Yaw = FMath::Atan2(Direction.Y, Direction.X);
+		PackedYaw = static_cast<uint8>(FMath::RoundToInt(Yaw * (256.0f / (2.0f * PI))) & 0xFF);
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FCoverPoint& CoverPoint)
+	{
+		uint8 Type = static_cast<uint8>(CoverPoint.Type);
+		Ar << CoverPoint.Location << CoverPoint.PackedYaw << Type;
+		CoverPoint.Type = static_cast<ECoverType>(Type);
+		return Ar;
+	}
+};
+
+/**
+ * The cover points baked for a level by ACoverGenerator. The points are serialised as a flat binary array rather than
+ * as reflected properties, which keeps the asset small and quick to load.
+ */
+UCLASS(BlueprintType)
+class ISOLATION_API UCoverPointAsset : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Serialize(FArchive& Ar) override;
+
+	/** Replaces the baked cover points */
+	void SetCoverPoints(TArray<FCoverPoint>&& NewCoverPoints);
+
+	const TArray<FCoverPoint>& GetCoverPoints() const { return CoverPoints; }
+
+private:
+
+	/** The number of baked points, shown in the editor for reference */
+	UPROPERTY(VisibleAnywhere, Category = "Cover")
+	int32 NumCoverPoints = 0;
+
+	TArray<FCoverPoint> CoverPoints;
+};
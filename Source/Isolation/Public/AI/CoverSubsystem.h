@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI/CoverPointAsset.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CoverSubsystem.generated.h"
+
+/**
+ * Holds the level's baked cover points in a grid, and answers cover queries from the baked data alone so that no
+ * traces are made during combat. Cover points can be claimed, so that two AI don't run for the same one.
+ */
+UCLASS()
+class ISOLATION_API UCoverSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	/** Adds the cover points baked for a level. Called by each level's ACoverGenerator as play begins */
+	void AddCoverPoints(const UCoverPointAsset* CoverAsset);
+
+	/** Finds the best unclaimed cover from a threat within a radius of a location
+	 *	@param ThreatLocation Where the threat is, which the cover must face
+	 *	@param Origin The location to search around, usually the AI looking for cover
+	 *	@param Radius The distance to search within
+	 *	@param RequiredType The kind of cover needed. Standing cover also counts as crouching cover
+	 *	@param Querier The AI looking for cover, which may take a point it has already claimed
+	 *	@return The index of the best cover point, or INDEX_NONE if there isn't one
+	 */
+	int32 FindBestCover(const FVector& ThreatLocation, const FVector& Origin, float Radius,
+	                    ECoverType RequiredType = ECoverType::Crouch, const AActor* Querier = nullptr) const;
+
+	/** Copies out every cover point inside a box, for work that can't read the subsystem directly
+	 *	@param Box The box to gather cover points from
+	 *	@param OutCoverPoints Emptied, then filled with the cover points found
+	 */
+	void GetCoverPointsInBox(const FBox& Box, TArray<FCoverPoint>& OutCoverPoints) const;
+
+	/** Returns the cover point at the given index, as returned by FindBestCover */
+	const FCoverPoint& GetCoverPoint(const int32 Index) const { return CoverPoints[Index]; }
+
+	/** Claims a cover point for an AI, giving up any point it held before
+	 *	@return Whether the point was free, or already held by the claimant
+	 */
+	bool ClaimCover(int32 Index, const AActor* Claimant);
+
+	/** Gives up the cover point held by an AI, if it holds one */
+	void ReleaseCover(const AActor* Claimant);
+
+private:
+
+	/** Returns the grid cell containing a location */
+	FIntPoint GetCell(const FVector& Location) const
+	{
+		return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+	}
+
+	/** Every loaded cover point */
+	TArray<FCoverPoint> CoverPoints;
+
+	/** The AI holding each cover point, if any, parallel to CoverPoints */
+	TArray<TWeakObjectPtr<const AActor>> Claimants;
+
+	/** The cover point held by each AI */
+	TMap<const AActor*, int32> ClaimedCover;
+
+	/** Indices into CoverPoints for the points in each grid cell */
+	TMap<FIntPoint, TArray<int32>> Cells;
+
+	/** The width of each grid cell */
+	float CellSize = 1000.0f;
+};
@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "DormantAISubsystem.generated.h"
+
+class AAICharacter;
+
+/**
+ * The state of every dormant AI, with one array per field so that passes over the population only touch the fields
+ * they read. Every array is the same length, and a dormant AI is an index into them.
+ */
+struct FDormantAIPopulation
+{
+	TArray<FVector> Locations;
+
+	TArray<float> Yaws;
+
+	/** Index into UDormantAISubsystem::DormantClasses */
+	TArray<int32> ClassIndices;
+
+	TArray<int32> SquadIds;
+
+	TArray<int32> LoadoutSeeds;
+
+	TArray<float> Healths;
+
+	/** Set by the parallel pass for the AI that should be hydrated */
+	TArray<bool> WantsHydration;
+
+	int32 Num() const { return Locations.Num(); }
+
+	void Add(const FVector& Location, float Yaw, int32 ClassIndex, int32 SquadId, int32 LoadoutSeed, float Health);
+
+	void RemoveAtSwap(int32 Index);
+
+	void Empty();
+};
+
+/**
+ * Keeps AI that are far from the player as plain data rather than actors, so that levels can hold hundreds of them.
+ * AI that have been low significance for a while, and are far enough away, are dehydrated: their location, squad,
+ * loadout seed and health are recorded and the actor, controller and weapon are given up. Each frame the dormant
+ * population is checked against the player's view in parallel, and those close enough are hydrated back into full
+ * actors, a few per frame.
+ */
+UCLASS()
+class ISOLATION_API UDormantAISubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	/** Adds a dormant AI without spawning it, for populating a level with AI that start far from the player
+	 *	@param CharacterClass The AI to spawn once hydrated
+	 *	@param Transform Where the AI is. Only the yaw of the rotation is kept
+	 *	@param SquadId The squad the AI belongs to
+	 *	@param LoadoutSeed The seed the AI's loadout is drawn from. Zero picks a random seed
+	 *	@param Health The health the AI has once hydrated
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AI")
+	void AddDormantAI(TSubclassOf<AAICharacter> CharacterClass, const FTransform& Transform, int32 SquadId = 0,
+	                  int32 LoadoutSeed = 0, float Health = 100.0f);
+
+	/** Records an AI's state and removes its actor, controller and weapon
+	 *	@return Whether the AI was made dormant. AI that are dead or fighting are left alone
+	 */
+	bool DehydrateAI(AAICharacter* Character);
+
+	/** Returns the number of AI currently dormant */
+	UFUNCTION(BlueprintPure, Category = "AI")
+	int32 GetNumDormantAI() const { return Population.Num(); }
+
+	/** Hydrates the dormant AI near the player, and dehydrates the AI that have drifted out of relevance */
+	virtual void Tick(float DeltaTime) override;
+
+	/** We only need to tick while there are dormant AI to hydrate or awake AI that could be dehydrated */
+	virtual bool IsTickable() const override;
+
+	virtual ETickableTickType GetTickableTickType() const override
+	{
+		return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+	}
+
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UDormantAISubsystem, STATGROUP_Tickables); }
+
+private:
+
+	/** Spawns the dormant AI at the given index and removes it from the population */
+	AAICharacter* HydrateAI(int32 Index);
+
+	/** Dehydrates the AI that have been low significance for long enough and are far enough from the player */
+	void DehydrateIdleAI(const FVector& ViewLocation);
+
+	/** Returns the index of a class in DormantClasses, adding it if needed */
+	int32 FindOrAddClass(UClass* CharacterClass);
+
+	FDormantAIPopulation Population;
+
+	/** The classes of the dormant AI, which are referenced here so that they aren't garbage collected */
+	UPROPERTY()
+	TArray<UClass*> DormantClasses;
+
+	/** Reused for the AI that could be dehydrated */
+	TArray<AAICharacter*> DehydrationCandidates;
+
+	/** When idle AI were last looked for to be dehydrated */
+	float LastDehydrateCheckTime = 0.0f;
+};
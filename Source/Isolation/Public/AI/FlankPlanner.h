@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "AI/CoverPointAsset.h"
+#include "NavigationData.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FlankPlanner.generated.h"
+
+class AAICharacter;
+
+/** Called when a flank has been planned, with whether a good enough flank was found and where it leads to */
+DECLARE_DELEGATE_TwoParams(FFlankPlannedDelegate, bool /* bFound */, const FVector& /* FlankLocation */);
+
+/** Identifies a flank path by the cells its start, goal and target fall in */
+struct FFlankPathKey
+{
+	FIntVector StartCell;
+
+	FIntVector GoalCell;
+
+	FIntVector TargetCell;
+
+	bool operator==(const FFlankPathKey& Other) const
+	{
+		return StartCell == Other.StartCell && GoalCell == Other.GoalCell && TargetCell == Other.TargetCell;
+	}
+
+	friend uint32 GetTypeHash(const FFlankPathKey& Key)
+	{
+		return HashCombine(HashCombine(GetTypeHash(Key.StartCell), GetTypeHash(Key.GoalCell)), GetTypeHash(Key.TargetCell));
+	}
+};
+
+/** A candidate flank path waiting to be submitted to the navigation system */
+struct FFlankPathQuery
+{
+	FFlankPathKey Key;
+
+	FVector Start = FVector::ZeroVector;
+
+	FVector Goal = FVector::ZeroVector;
+
+	FVector TargetLocation = FVector::ZeroVector;
+
+	FVector TargetForward = FVector::ForwardVector;
+
+	/** The navmesh generation the query was made against. Results from older generations aren't cached */
+	int32 NavGeneration = 0;
+};
+
+/** A found path waiting to be rated on a worker thread, along with everything the rating needs */
+struct FFlankPathToRate
+{
+	FFlankPathQuery Query;
+
+	TArray<FVector> PathPoints;
+
+	/** The cover points around the path, copied out so the worker doesn't touch the cover subsystem */
+	TArray<FCoverPoint> NearbyCover;
+};
+
+/** A candidate goal in a flank request */
+struct FFlankCandidate
+{
+	FFlankPathKey Key;
+
+	FVector Goal = FVector::ZeroVector;
+
+	/** The candidate's rating once known. Negative if there is no path */
+	TOptional<float> Rating;
+};
+
+/** An AI waiting on its flank to be planned */
+struct FFlankRequest
+{
+	TWeakObjectPtr<AAICharacter> Character;
+
+	TArray<FFlankCandidate, TInlineAllocator<4>> Candidates;
+
+	FFlankPlannedDelegate OnPlanned;
+};
+
+/**
+ * Plans flanking moves for AI without pathfinding on the game thread. Each request proposes a few goals around the
+ * target, and the paths to them are found as asynchronous navigation queries, a batch per frame. Found paths are rated
+ * on a worker thread by how exposed they leave the AI to the target, how much cover they pass and how much of a
+ * detour they are. Ratings are cached by the cells the path starts, ends and targets, until the navmesh changes, so AI
+ * flanking from similar positions share the work.
+ */
+UCLASS()
+class ISOLATION_API UFlankPlanner : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+	/** Plans a flank around a target. The AI's previous request, if any, is replaced
+	 *	@param Character The AI that wants to flank
+	 *	@param Target The actor to flank
+	 *	@param OnPlanned Called once the flank has been planned, which may be straight away if every path is cached
+	 *	@return Whether the request was accepted. AI have to wait WaitToFlankTime between flanks
+	 */
+	bool RequestFlank(AAICharacter* Character, const AActor* Target, FFlankPlannedDelegate OnPlanned);
+
+	/** Submits this frame's path queries, and hands any found paths to a worker to be rated */
+	virtual void Tick(float DeltaTime) override;
+
+	/** We only need to tick while there are flanks being planned */
+	virtual bool IsTickable() const override { return Requests.Num() > 0 || QueuedQueries.Num() > 0 || PathsToRate.Num() > 0; }
+
+	virtual ETickableTickType GetTickableTickType() const override
+	{
+		return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+	}
+
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UFlankPlanner, STATGROUP_Tickables); }
+
+private:
+
+	/** Rates a flank path from 0 to 1, higher being better. Safe to call from any thread */
+	static float RateFlankPath(const FFlankPathToRate& Path);
+
+	/** Returns the cache cell containing a location */
+	FIntVector GetCell(const FVector& Location) const;
+
+	/** Called by the navigation system when one of our path queries has completed */
+	void HandlePathFound(uint32 QueryId, ENavigationQueryResult::Type Result, FNavPathSharedPtr Path);
+
+	/** Records a path's rating, and completes any requests that were waiting on it */
+	void StoreRating(const FFlankPathKey& Key, float Rating, int32 NavGeneration);
+
+	/** Completes every request whose candidates have all been rated */
+	void CompleteRequests();
+
+	/** Drops every cached rating when the navmesh is rebuilt */
+	UFUNCTION()
+	void HandleNavigationGenerated(ANavigationData* NavData);
+
+	/** Every request waiting on its flank */
+	TArray<FFlankRequest> Requests;
+
+	/** Path queries waiting to be submitted */
+	TArray<FFlankPathQuery> QueuedQueries;
+
+	/** Path queries submitted to the navigation system, by query id */
+	TMap<uint32, FFlankPathQuery> InFlightQueries;
+
+	/** Paths waiting to be sent to a worker to be rated */
+	TArray<FFlankPathToRate> PathsToRate;
+
+	/** Every path that is queued, in flight or being rated, so that the same path is never queried twice at once */
+	TSet<FFlankPathKey> PendingPaths;
+
+	/** Cached path ratings. Negative if there is no path */
+	TMap<FFlankPathKey, float> Ratings;
+
+	/** When each AI last requested a flank */
+	TMap<TWeakObjectPtr<AAICharacter>, float> LastRequestTimes;
+
+	/** Bumped whenever the navmesh is rebuilt */
+	int32 NavGeneration = 0;
+
+	/** Whether we are listening for the navmesh being rebuilt */
+	bool bBoundToNavigation = false;
+
+	/** Delegate bound to HandlePathFound, shared by every query */
+	FNavPathQueryDelegate PathFoundDelegate;
+};
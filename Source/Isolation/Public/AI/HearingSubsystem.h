@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "HearingSubsystem.generated.h"
+
+class AAICharacterController;
+
+/** The kinds of noise AI can hear, each with its own loudness */
+UENUM(BlueprintType)
+enum class ENoiseType : uint8
+{
+	Gunshot,
+	/** A bullet hitting a surface */
+	Impact,
+	Footstep
+};
+
+/** A noise made this frame, waiting to be routed to the AI that can hear it */
+struct FNoiseEvent
+{
+	FVector Location = FVector::ZeroVector;
+
+	/** The distance the noise can be heard from */
+	float Radius = 0.0f;
+
+	ENoiseType Type = ENoiseType::Gunshot;
+
+	TWeakObjectPtr<AActor> Instigator;
+};
+
+/** The loudest noise an AI heard this frame */
+struct FHeardNoise
+{
+	TWeakObjectPtr<AAICharacterController> Listener;
+
+	/** Index into the pending noises */
+	int32 NoiseIndex = INDEX_NONE;
+
+	/** How loud the noise was where the AI heard it, from 0 at the edge of its radius to 1 at its source */
+	float Strength = 0.0f;
+};
+
+/**
+ * Lets AI hear gunshots, impacts and footsteps. Noises are posted into a fixed size ring buffer as they are made, and
+ * once per frame every pending noise is routed through the AI manager's spatial hash to the AI within its radius. Each
+ * AI is only told about the loudest noise it heard that frame.
+ */
+UCLASS()
+class ISOLATION_API UHearingSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+	/** Makes a noise for AI to hear. If the buffer is full the oldest pending noise is dropped
+	 *	@param Type The kind of noise, which decides how far away it can be heard
+	 *	@param Location Where the noise was made
+	 *	@param Instigator The actor responsible for the noise, which doesn't hear it itself
+	 *	@param LoudnessScale Scales the distance the noise can be heard from, such as for silenced weapons
+	 */
+	void PostNoise(ENoiseType Type, const FVector& Location, AActor* Instigator, float LoudnessScale = 1.0f);
+
+	/** Routes every noise posted since last frame to the AI in range */
+	virtual void Tick(float DeltaTime) override;
+
+	/** We only need to tick while there are noises to route */
+	virtual bool IsTickable() const override { return NumPendingNoises > 0; }
+
+	virtual ETickableTickType GetTickableTickType() const override
+	{
+		return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+	}
+
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UHearingSubsystem, STATGROUP_Tickables); }
+
+private:
+
+	/** Returns the distance a kind of noise can be heard from */
+	static float GetNoiseRadius(ENoiseType Type);
+
+	/** Pending noises, written in a ring starting at FirstPendingNoise */
+	TArray<FNoiseEvent> NoiseBuffer;
+
+	/** The oldest pending noise */
+	int32 FirstPendingNoise = 0;
+
+	int32 NumPendingNoises = 0;
+
+	/** The loudest noise heard by each listener this frame, reused between frames */
+	TArray<FHeardNoise> HeardNoises;
+
+	/** Index into HeardNoises for each listener */
+	TMap<const AAICharacterController*, int32> HeardNoiseIndices;
+};
@@ -0,0 +1,150 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "InfluenceMapSubsystem.generated.h"
+
+/** The layers of the influence map */
+UENUM(BlueprintType)
+enum class EInfluenceLayer : uint8
+{
+	/** Where players are, spreading out to where they could soon be */
+	Threat,
+	/** Where shots have recently been fired */
+	Gunfire,
+	/** Where AI are standing */
+	Occupancy,
+	Count UMETA(Hidden)
+};
+
+static constexpr int32 NumInfluenceLayers = static_cast<int32>(EInfluenceLayer::Count);
+
+/** Influence to be added to a layer around a cell on the next update */
+struct FInfluenceStamp
+{
+	EInfluenceLayer Layer = EInfluenceLayer::Threat;
+
+	/** The centre of the stamp, in cells */
+	FVector2D Cell = FVector2D::ZeroVector;
+
+	/** The radius of the stamp, in cells */
+	float Radius = 0.0f;
+
+	/** The influence at the centre of the stamp, falling off to nothing at its radius */
+	float Strength = 1.0f;
+};
+
+/** The influence map's grids, shared with the worker that updates them so that they outlive the subsystem if needed */
+struct FInfluenceMapBuffers
+{
+	/** Two copies of every layer. Readers use the copy at ReadIndex while the worker writes the other */
+	TArray<float> Layers[2][NumInfluenceLayers];
+
+	/** The copy readers use. Only changed on the game thread, once the worker has finished */
+	int32 ReadIndex = 0;
+
+	/** Set while the worker is writing the other copy */
+	FThreadSafeBool bUpdateInFlight;
+};
+
+/**
+ * A 2D grid over the navigable area that layers where the players threaten, where shots have recently been fired and
+ * where AI are standing, so that tactical decisions can be answered with grid lookups rather than traces. Layers are
+ * updated incrementally on a worker thread: each update decays and spreads the previous influence with vectorised
+ * kernels, then stamps in the latest players, AI and gunfire. The grid is double buffered, so AI read the last finished
+ * update without locking while the next one is being built.
+ */
+UCLASS()
+class ISOLATION_API UInfluenceMapSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	/** Records a shot, which is stamped into the gunfire layer on the next update */
+	void AddGunfire(const FVector& Location);
+
+	/** Returns the influence of a layer at a location, or zero outside the map
+	 *	@param Layer The layer to read
+	 *	@param Location The location to read at. Only X and Y are used
+	 */
+	UFUNCTION(BlueprintPure, Category = "AI | Influence")
+	float GetInfluence(EInfluenceLayer Layer, const FVector& Location) const;
+
+	/** Finds the cell with the least influence of a layer within a radius, such as the safest place to fall back to
+	 *	@param Layer The layer to read
+	 *	@param Center The location to search around
+	 *	@param Radius The distance to search within
+	 *	@param OutLocation The centre of the cell found, at the height of Center
+	 *	@return Whether any cell of the map was within the radius
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AI | Influence")
+	bool FindLowestInfluence(EInfluenceLayer Layer, const FVector& Center, float Radius, FVector& OutLocation) const;
+
+	/** Publishes the last finished update, and starts the next one when it is due */
+	virtual void Tick(float DeltaTime) override;
+
+	/** We stop ticking for good if the world turns out to have no navigation to cover */
+	virtual bool IsTickable() const override { return bHasNavigation; }
+
+	virtual ETickableTickType GetTickableTickType() const override
+	{
+		return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+	}
+
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UInfluenceMapSubsystem, STATGROUP_Tickables); }
+
+private:
+
+	/** Sizes the grid to cover the navigation bounds, clearing bHasNavigation if the world has no navigation system
+	 *	@return Whether there were navigation bounds to cover
+	 */
+	bool InitialiseGrid();
+
+	/** Decays and spreads the influence of one layer from Source into Dest. Safe to call from any thread */
+	static void PropagateLayer(const float* Source, float* Dest, int32 Width, int32 Height, float Keep, float Spread);
+
+	/** Adds a stamp's influence to a layer, keeping the strongest influence in each cell. Safe to call from any thread */
+	static void ApplyStamp(const FInfluenceStamp& Stamp, float* Layer, int32 Width, int32 Height);
+
+	/** Returns the cell containing a location, in cells but not rounded */
+	FVector2D GetCellCoordinates(const FVector& Location) const
+	{
+		return FVector2D((Location.X - Origin.X) / CellSize, (Location.Y - Origin.Y) / CellSize);
+	}
+
+	/** The grids, shared with the worker */
+	TSharedPtr<FInfluenceMapBuffers, ESPMode::ThreadSafe> Buffers;
+
+	/** Gunfire recorded since the last update was started */
+	TArray<FVector> PendingGunfire;
+
+	/** The corner of the grid with the lowest X and Y */
+	FVector2D Origin = FVector2D::ZeroVector;
+
+	float CellSize = 200.0f;
+
+	int32 Width = 0;
+
+	int32 Height = 0;
+
+	/** Time since the last update was started */
+	float TimeSinceUpdate = 0.0f;
+
+	/** Whether an update has been started and not yet published */
+	bool bUpdateStarted = false;
+
+	/** The world time of the next attempt to size the grid, while there are no navigation bounds yet */
+	float NextGridAttemptTime = 0.0f;
+
+	/** Cleared once the world is found to have no navigation system, as the grid can never be sized */
+	bool bHasNavigation = true;
+};
@@ -0,0 +1,146 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+#include "LineOfSightCache.generated.h"
+
+class AFPSCharacter;
+
+/** Identifies the line of sight between an observer and a target */
+typedef TPair<const AActor*, const AFPSCharacter*> FLineOfSightKey;
+
+/** What one observer knows about its line of sight to each of a target's detection points */
+struct FLineOfSightEntry
+{
+	/** The pair's key in EntryIndices, kept here as the raw pointers can't be recovered once the actors have gone */
+	FLineOfSightKey Key;
+
+	TWeakObjectPtr<const AActor> Observer;
+
+	TWeakObjectPtr<const AFPSCharacter> Target;
+
+	/** Where the observer was looking from when it last asked */
+	FVector ObserverLocation = FVector::ZeroVector;
+
+	/** When each detection point was last traced, or a negative time if it never has been */
+	TArray<float, TInlineAllocator<8>> PointResultTimes;
+
+	/** Whether each detection point was visible when it was last traced */
+	TArray<bool, TInlineAllocator<8>> PointVisible;
+
+	/** The point that was most recently visible, which is always checked before any other */
+	int32 LastVisiblePoint = INDEX_NONE;
+
+	/** The next point to check while no point is visible, cycling through them one trace at a time */
+	int32 NextPoint = 0;
+
+	/** When the observer last asked about this target. Entries that stop being asked about are dropped */
+	float LastQueryTime = 0.0f;
+
+	/** When this entry last submitted a trace */
+	float LastTraceTime = -MAX_FLT;
+
+	/** The least time between this entry's traces, set by the observer's significance */
+	float TraceInterval = 0.0f;
+
+	/** Whether a trace for this entry is in flight */
+	bool bTracePending = false;
+};
+
+/** A line of sight trace that has been submitted and is waiting on its result */
+struct FLineOfSightTrace
+{
+	FLineOfSightKey Key;
+
+	int32 PointIndex = INDEX_NONE;
+};
+
+/**
+ * Answers AI sight queries against the player from cached, asynchronously traced results rather than tracing to every
+ * detection socket on every query. Each observer's visibility of each socket is cached for a short window, the socket
+ * last seen is re-checked first, and unseen sockets are checked one per frame in turn. The traces for every observer
+ * share a per-frame budget.
+ */
+UCLASS()
+class ISOLATION_API ULineOfSightCache : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+	/** Returns whether the target is currently known to be visible to the observer, and queues the traces needed to keep
+	 *	that knowledge fresh. A pair that has never been queried reports not visible until its first traces return
+	 *	@param Target The character being looked for
+	 *	@param Observer The actor looking, ignored by the traces
+	 *	@param ObserverLocation Where the observer is looking from
+	 *	@param OutSeenLocation The location of the visible detection point, if there is one
+	 *	@return Whether any of the target's detection points was visible within the validity window
+	 */
+	bool QueryVisibility(const AFPSCharacter* Target, const AActor* Observer, const FVector& ObserverLocation,
+	                     FVector& OutSeenLocation);
+
+	/** Sets the least time between an observer's traces, so that less significant AI perceive less often. Results are
+	 *	trusted for the interval on top of the usual validity window
+	 *	@param Observer The AI whose traces to throttle
+	 *	@param Interval The least time between traces, or zero to trace as often as the budget allows
+	 */
+	void SetObserverTraceInterval(const AActor* Observer, float Interval);
+
+	/** Submits this frame's line of sight traces, within the budget */
+	virtual void Tick(float DeltaTime) override;
+
+	/** We only need to tick while someone is looking */
+	virtual bool IsTickable() const override { return Entries.Num() > 0; }
+
+	virtual ETickableTickType GetTickableTickType() const override
+	{
+		return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+	}
+
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(ULineOfSightCache, STATGROUP_Tickables); }
+
+private:
+
+	/** Called by the world when one of our asynchronous traces has completed */
+	void HandleTraceCompleted(const FTraceHandle& Handle, FTraceDatum& Data);
+
+	/** Returns the detection point an entry should trace next, or INDEX_NONE if it is up to date */
+	static int32 GetPointToTrace(const FLineOfSightEntry& Entry, float CurrentTime, float ValidityWindow);
+
+	/** Removes the entry at the given index, keeping EntryIndices up to date */
+	void RemoveEntryAt(int32 Index);
+
+	/** Every observer and target pair being tracked */
+	TArray<FLineOfSightEntry> Entries;
+
+	/** Index into Entries for each observer and target pair */
+	TMap<FLineOfSightKey, int32> EntryIndices;
+
+	/** The entry to start submitting traces from next frame, so that the budget is shared fairly between observers */
+	int32 NextEntry = 0;
+
+	/** The trace interval of each throttled observer */
+	TMap<const AActor*, float> ObserverTraceIntervals;
+
+	/** Traces that have been submitted and are waiting on their results, indexed by the trace's user data */
+	TArray<FLineOfSightTrace> InFlightTraces;
+
+	/** The number of submitted traces which have not yet returned */
+	int32 OutstandingTraces = 0;
+
+	/** Reused for every trace, with only the ignored observer changing */
+	FCollisionQueryParams QueryParams;
+
+	/** Delegate bound to HandleTraceCompleted, shared by every trace */
+	FTraceDelegate TraceCompletedDelegate;
+};
@@ -0,0 +1,154 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UtilityAISubsystem.generated.h"
+
+class AAICharacterController;
+
+/** The actions the utility AI chooses between */
+UENUM(BlueprintType)
+enum class EUtilityAction : uint8
+{
+	None,
+	/** Fight the target from where we are */
+	Engage,
+	/** Close the distance to a target beyond our combat range */
+	Advance,
+	/** Back away from a target inside our combat range */
+	Retreat,
+	/** Move to cover from the target */
+	TakeCover,
+	/** Work around the target's side */
+	Flank,
+	/** Reload before the clip runs dry */
+	Reload,
+	/** Wait for a target that has gone out of sight to reappear */
+	Ambush,
+	Count UMETA(Hidden)
+};
+
+/** The considerations of every agent being evaluated, one array per consideration, filled on the game thread */
+struct FUtilityConsiderations
+{
+	/** Distance to the visible target, or negative if there isn't one */
+	TArray<float> TargetDistances;
+
+	TArray<float> MinCombatDistances;
+
+	TArray<float> MaxCombatDistances;
+
+	/** The fraction of the clip left, from 0 to 1 */
+	TArray<float> AmmoFractions;
+
+	/** The fraction of weapon health left, from 0 to 1 */
+	TArray<float> WeaponHealthFractions;
+
+	/** 1 if there is free cover from the target nearby, otherwise 0 */
+	TArray<float> CoverAvailability;
+
+	/** 1 for aggressive AI, 0 for defensive ones */
+	TArray<float> Aggression;
+
+	/** The player threat where the AI is standing, from the influence map */
+	TArray<float> Threats;
+
+	/** Seconds the AI has spent engaging without doing anything else, so that a standoff can be broken with a flank */
+	TArray<float> EngagedTimes;
+
+	/** 1 if the AI knows of a target it can't currently see, otherwise 0 */
+	TArray<float> LostTargets;
+
+	/** 1 if the AI may ambush, otherwise 0 */
+	TArray<float> AmbushAllowed;
+
+	/** The action the AI is currently taking, which is favoured so that decisions don't flicker */
+	TArray<EUtilityAction> CurrentActions;
+
+	/** Sizes every array for the given number of agents */
+	void SetNum(int32 Num);
+};
+
+/** An AI controller whose decisions are made by the utility AI */
+struct FUtilityAgent
+{
+	/** The agent's key in AgentIndices, kept here as the raw pointer can't be recovered once the actor has gone */
+	const AAICharacterController* Key = nullptr;
+
+	TWeakObjectPtr<AAICharacterController> Controller;
+
+	/** Seconds Engage has been chosen for in a row */
+	float TimeEngaged = 0.0f;
+};
+
+/**
+ * Chooses an action for every AI by scoring each action against a handful of considerations: where the target is
+ * relative to the AI's combat range, how much ammunition and weapon health it has left, whether there is cover nearby,
+ * how threatened its position is and its attitude. Every agent is evaluated together on an interval. Considerations are
+ * gathered on the game thread into flat arrays, scored across worker threads, and the chosen actions are written back
+ * to the controllers.
+ */
+UCLASS()
+class ISOLATION_API UUtilityAISubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+	/** Starts choosing actions for an AI */
+	void RegisterAgent(AAICharacterController* Controller);
+
+	/** Stops choosing actions for an AI */
+	void UnregisterAgent(const AAICharacterController* Controller);
+
+	/** Evaluates every agent, when the evaluation interval has passed */
+	virtual void Tick(float DeltaTime) override;
+
+	/** We only need to tick while there are agents to evaluate */
+	virtual bool IsTickable() const override { return Agents.Num() > 0; }
+
+	virtual ETickableTickType GetTickableTickType() const override
+	{
+		return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+	}
+
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UUtilityAISubsystem, STATGROUP_Tickables); }
+
+private:
+
+	/** Fills in the considerations of every agent. Agents that have lost their pawn are left with no target */
+	void GatherConsiderations();
+
+	/** Scores every action for one agent and returns the best. Safe to call from any thread */
+	static EUtilityAction ChooseAction(const FUtilityConsiderations& AgentConsiderations, int32 Index);
+
+#if !UE_BUILD_SHIPPING
+	/** Runs a set of typical situations for each attitude through ChooseAction, warning about any that no longer choose
+	 *	the action expected of them, so that retuning the curves can't quietly stop an archetype using an action */
+	static void CheckArchetypeChoices();
+#endif
+
+	/** Every agent being evaluated */
+	TArray<FUtilityAgent> Agents;
+
+	/** Index into Agents for each controller */
+	TMap<const AAICharacterController*, int32> AgentIndices;
+
+	/** Reused for every evaluation */
+	FUtilityConsiderations Considerations;
+
+	/** The action chosen for each agent, parallel to Agents */
+	TArray<EUtilityAction> ChosenActions;
+
+	/** Time since the agents were last evaluated */
+	float TimeSinceEvaluation = 0.0f;
+};
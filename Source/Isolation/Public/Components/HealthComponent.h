@@ -4,8 +4,27 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "Engine/EngineTypes.h"
 #include "HealthComponent.generated.h"
 
+/** A single hit that contributed to a batch of damage applied by UDamageBatchSubsystem */
+USTRUCT(BlueprintType)
+struct FDamageHit
+{
+	GENERATED_BODY()
+
+	/** The damage dealt by this hit, before it was merged with the rest of the batch */
+	UPROPERTY(BlueprintReadOnly, Category = "Damage")
+	float Damage = 0.0f;
+
+	/** The direction the shot was travelling in */
+	UPROPERTY(BlueprintReadOnly, Category = "Damage")
+	FVector ShotDirection = FVector::ZeroVector;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Damage")
+	FHitResult HitInfo;
+};
+
 /** Delegate that is passed through to the owner via Blueprint */
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_SixParams(FOnHealthChangedSignature, UHealthComponent*, HealthComponent, float,
                                              Health, float, HealthDelta, const class UDamageType*, DamageType,
@@ -26,6 +45,19 @@ public:
 
 	UFUNCTION(BlueprintPure, Category = "HealthComponent")
 	float GetHealth() const { return Health; }
+
+	/** Sets the current health directly, without broadcasting, for restoring an owner's saved state */
+	void SetHealth(const float NewHealth) { Health = FMath::Clamp(NewHealth, 0.0f, 100.0f); }
+
+	/** Returns every hit merged into the damage currently being broadcast through OnHealthChanged. Only valid while
+	 *	OnHealthChanged is broadcasting, and empty for damage that was not applied by UDamageBatchSubsystem */
+	UFUNCTION(BlueprintPure, Category = "HealthComponent")
+	const TArray<FDamageHit>& GetLastDamageHits() const { return LastDamageHits; }
+
+	/** Called by UDamageBatchSubsystem before it applies a batch of damage, so that listeners can look up its hits
+	 *	@param Hits The hits about to be applied
+	 */
+	void SetPendingDamageHits(const TArray<FDamageHit>& Hits) { LastDamageHits = Hits; }
 	
 protected:
 	/** Called when the game starts */
@@ -38,6 +70,9 @@ protected:
 	/** The current active health */
 	float Health = 100.0f;
 
+	/** The hits making up the damage being broadcast, see GetLastDamageHits */
+	TArray<FDamageHit> LastDamageHits;
+
 	/** The function that handles taking damage, signature is the same as OnTakeAnyDamage */
 	UFUNCTION()
 	void HandleTakeAnyDamage(AActor* DamagedActor, float Damage, const UDamageType* DamageType,
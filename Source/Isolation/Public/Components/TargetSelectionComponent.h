@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "TargetSelectionComponent.generated.h"
+
+class UAIPerceptionComponent;
+
+/** A perceived actor and how strongly the AI should consider targeting it */
+USTRUCT(BlueprintType)
+struct FTargetScore
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Target Selection")
+	AActor* Actor = nullptr;
+
+	/** The combined score, higher is a better target */
+	UPROPERTY(BlueprintReadOnly, Category = "Target Selection")
+	float Score = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Target Selection")
+	float DistanceSquared = 0.0f;
+
+	/** How long ago the actor was last seen, 0 if it is currently visible */
+	UPROPERTY(BlueprintReadOnly, Category = "Target Selection")
+	float VisibilityAge = 0.0f;
+
+	/** The recent damage the actor has dealt to us, decaying over time */
+	UPROPERTY(BlueprintReadOnly, Category = "Target Selection")
+	float DamageReceived = 0.0f;
+
+	/** Whether the actor is currently visible */
+	UPROPERTY(BlueprintReadOnly, Category = "Target Selection")
+	bool bVisible = false;
+};
+
+/**
+ * Ranks the actors an AI has seen by distance, how recently they were seen and how much damage they have dealt to
+ * the AI. Each update scores every perceived actor once and keeps only the best few, so the cost of choosing a target
+ * grows linearly with the number of perceived actors.
+ */
+UCLASS( ClassGroup=(Isolation), meta=(BlueprintSpawnableComponent) )
+class ISOLATION_API UTargetSelectionComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	/** Sets default values for this component's properties */
+	UTargetSelectionComponent();
+
+	/** Re-scores every actor the perception component has seen, rebuilding the ranked targets
+	 *	@param PerceptionComponent The perception of the AI we are choosing targets for
+	 */
+	void UpdateTargets(const UAIPerceptionComponent* PerceptionComponent);
+
+	/** Records damage dealt to the AI, which makes its source a more likely target
+	 *	@param Source The actor responsible for the damage
+	 *	@param Damage The amount of damage dealt
+	 */
+	void ReportDamage(AActor* Source, float Damage);
+
+	/** Returns the best scoring targets from the last update, best first. Includes actors that have recently gone out
+	 *	of sight */
+	UFUNCTION(BlueprintPure, Category = "Target Selection")
+	const TArray<FTargetScore>& GetRankedTargets() const { return RankedTargets; }
+
+	/** Returns the best scoring target that is currently visible, if there is one */
+	UFUNCTION(BlueprintPure, Category = "Target Selection")
+	AActor* GetBestVisibleTarget() const;
+
+protected:
+
+	/** The number of targets kept in the ranked list */
+	UPROPERTY(EditDefaultsOnly, Category = "Target Selection")
+	int32 MaxRankedTargets = 4;
+
+	/** Actors further away than this score nothing for distance */
+	UPROPERTY(EditDefaultsOnly, Category = "Target Selection")
+	float MaxTargetDistance = 5000.0f;
+
+	/** How long an actor that has gone out of sight is remembered for */
+	UPROPERTY(EditDefaultsOnly, Category = "Target Selection")
+	float VisibilityMemory = 5.0f;
+
+	/** The damage at which the damage score reaches half of its weight */
+	UPROPERTY(EditDefaultsOnly, Category = "Target Selection")
+	float DamageHalfScore = 25.0f;
+
+	/** How long it takes for the damage remembered from an actor to halve */
+	UPROPERTY(EditDefaultsOnly, Category = "Target Selection")
+	float DamageHalfLife = 4.0f;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Target Selection | Weights")
+	float DistanceWeight = 1.0f;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Target Selection | Weights")
+	float VisibilityWeight = 1.0f;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Target Selection | Weights")
+	float DamageWeight = 1.5f;
+
+private:
+
+	/** Decays the remembered damage up to the current time */
+	void DecayDamage();
+
+	/** The best targets from the last update, best first */
+	UPROPERTY()
+	TArray<FTargetScore> RankedTargets;
+
+	/** The damage remembered from each actor that has hurt us */
+	TMap<TWeakObjectPtr<AActor>, float> DamageReceived;
+
+	/** When DamageReceived was last decayed */
+	float LastDamageDecayTime = 0.0f;
+};
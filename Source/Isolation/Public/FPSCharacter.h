@@ -17,6 +17,7 @@
 #include "Components/TimelineComponent.h"
 #include "GameFramework/Character.h"
 #include "Widgets/PauseWidget.h"
+#include "Weapons/WeaponOwner.h"
 #include "FPSCharacter.generated.h"
 
 class UCameraComponent;
@@ -61,7 +62,7 @@ struct FMovementVariables
 };
 
 UCLASS()
-class ISOLATION_API AFPSCharacter : public ACharacter, public IAISightTargetInterface
+class ISOLATION_API AFPSCharacter : public ACharacter, public IAISightTargetInterface, public IWeaponOwner
 {
 	GENERATED_BODY()
 
@@ -107,6 +108,9 @@ public:
 	UFUNCTION(BlueprintCallable)
 	bool IsPlayerAiming() const { return bIsAiming; }
 
+	/** Returns how far the scope overlay is blended in, from 0 (hidden) to 1 (fully visible) */
+	float GetScopeBlend() const { return ScopeBlend; }
+
 	/** Returns whether the player is sprinting or not */
 	UFUNCTION(BlueprintCallable)
 	bool IsPlayerSprinting() const { return bIsSprinting; }
@@ -182,10 +186,35 @@ public:
 	/** Sets default values for this character's properties */
 	AFPSCharacter();
 
+	/** Answers AI sight queries from the line of sight cache, which traces to our detection sockets asynchronously */
 	virtual bool CanBeSeenFrom(const FVector& ObserverLocation, FVector& OutSeenLocation, int32& NumberOfLoSChecksPerformed, float& OutSightStrength, const AActor* IgnoreActor, const bool* bWasVisible, int32* UserData) const override;
 
+	/** Returns the number of points AI check to see us: each detection socket, then our actor location */
+	int32 GetNumDetectionPoints() const { return DetectionSocketBoneNames.Num() + 1; }
+
+	/** Returns the world location of the given detection point
+	 *	@param PointIndex The point, between 0 and GetNumDetectionPoints
+	 */
+	FVector GetDetectionPointLocation(const int32 PointIndex) const
+	{
+		return DetectionSocketBoneNames.IsValidIndex(PointIndex)
+			       ? HandsMeshComp->GetSocketLocation(DetectionSocketBoneNames[PointIndex])
+			       : GetActorLocation();
+	}
+
 	/** Called when the game starts or when spawned */
 	virtual void BeginPlay() override;
+
+	/** Removes us from the AI manager's neighbour queries */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** The player fires from the camera, in the direction they are looking */
+	virtual bool GetShotAim(const AWeaponBase* Weapon, FVector& OutOrigin, FRotator& OutAimRotation) const override;
+
+	virtual bool IsAimingWeapon() const override { return bIsAiming; }
+
+	/** Destroys the player's current weapon, playing its destroyed animation */
+	virtual void OnWeaponBroken(AWeaponBase* Weapon) override;
 	
 protected:
 
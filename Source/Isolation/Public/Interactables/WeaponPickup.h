@@ -35,6 +35,12 @@ public:
 	/** Set the cached data struct that this weapon pickup hold */
 	void SetCacheDataStruct(const FRuntimeWeaponData* NewDataStruct) { DataStruct = *NewDataStruct; }
 
+	/** Shows or hides the pickup when it is handed out or returned by UWeaponPoolSubsystem. Inactive pickups have no
+	 *	collision, so can't be interacted with, and active pickups simulate physics unless they are static
+	 *	@param bActive Whether the pickup is now in the world
+	 */
+	void SetPickupActive(bool bActive);
+
 	/** Returns the name of the weapon that this pickup is associated with (used for HUD) */
 	FText GetWeaponName() const { return WeaponName; } 
 	
@@ -3,8 +3,9 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "Components/TimelineComponent.h"
 #include "Engine/DataTable.h"
+#include "Weapons/RecoilLookupTable.h"
+#include "Weapons/WeaponOwner.h"
 #include "GameFramework/Actor.h"
 #include "WeaponBase.generated.h"
 
@@ -18,6 +19,18 @@ class USoundCue;
 class UPhysicalMaterial;
 class UDataTable;
 class AWeaponPickup;
+class UProjectileSubsystem;
+class UShotBatchSubsystem;
+class UImpactEffectSubsystem;
+class UWeaponAnimationTicker;
+class UHearingSubsystem;
+class UDamageBatchSubsystem;
+class AFPSCharacterController;
+class UCurveFloat;
+struct FQueuedShot;
+struct FShotRequest;
+struct FShotResult;
+struct FResolvedWeaponStats;
 
 /** Enumerator holding the 4 types of ammunition that weapons can use (used as part of the FSingleWeaponParams struct)
  * and to keep track of the total ammo the player has (ammoMap) */
@@ -41,6 +54,15 @@ enum class EAttachmentType : uint8
 	Grip		UMETA(DispayName = "Grip Attachment"),
 };
 
+/** Enumerator holding the states that a weapon's recoil moves between */
+UENUM()
+enum class EWeaponRecoilState : uint8
+{
+	Idle		UMETA(DisplayName = "Idle"),
+	Firing		UMETA(DisplayName = "Firing"),
+	Recovering	UMETA(DisplayName = "Recovering"),
+};
+
 /** Struct keeping track of important weapon variables modified at runtime. This structs contains data that is either
  *	modified at runtime, such as the amount of ammunition in the weapon, but also data required to spawn attachments
  *	and pickups
@@ -363,6 +385,28 @@ struct FStaticWeaponData : public FTableRowBase
 	UPROPERTY(EditDefaultsOnly, Category = "Required")
 	float WeaponYawVariation;
 
+	/** Projectiles */
+
+	/** Whether the weapon fires simulated projectiles rather than instant line traces */
+	UPROPERTY(EditDefaultsOnly, Category = "Projectiles")
+	bool bUseProjectiles = false;
+
+	/** The speed of the projectile as it leaves the barrel, in cm/s */
+	UPROPERTY(EditDefaultsOnly, Category = "Projectiles", meta=(EditCondition="bUseProjectiles", ClampMin=0.0f))
+	float MuzzleVelocity = 40000.0f;
+
+	/** The fraction of its velocity that the projectile loses every second to air resistance */
+	UPROPERTY(EditDefaultsOnly, Category = "Projectiles", meta=(EditCondition="bUseProjectiles", ClampMin=0.0f))
+	float ProjectileDrag = 0.1f;
+
+	/** Multiplier for the world's gravity acting on the projectile */
+	UPROPERTY(EditDefaultsOnly, Category = "Projectiles", meta=(EditCondition="bUseProjectiles"))
+	float ProjectileGravityScale = 1.0f;
+
+	/** The time, in seconds, that a projectile can fly for before being removed */
+	UPROPERTY(EditDefaultsOnly, Category = "Projectiles", meta=(EditCondition="bUseProjectiles", ClampMin=0.0f))
+	float ProjectileLifetime = 3.0f;
+
 	/** Attachments */
 
 	/** Whether this weapon has a unique set of attachments and is broken up into multiple meshes or is unique */
@@ -557,6 +601,10 @@ struct FStaticWeaponData : public FTableRowBase
 	UPROPERTY(EditDefaultsOnly, Category = "VFX", meta=(EditCondition="!bHasAttachments"))
 	UNiagaraSystem* DefaultHitEffect;
 
+	/** particle effects (Niagara systems) for any further surfaces, these take priority over the effects above */
+	UPROPERTY(EditDefaultsOnly, Category = "VFX", meta=(EditCondition="!bHasAttachments"))
+	TMap<UPhysicalMaterial*, UNiagaraSystem*> SurfaceHitEffects;
+
 	/** particle effect to be spawned at the muzzle when a shot is fired */
 	UPROPERTY(EditDefaultsOnly, Category = "VFX", meta=(EditCondition="!bHasAttachments"))
 	UParticleSystem* MuzzleFlash;
@@ -626,8 +674,16 @@ public:
 	/** Starts firing the gun (sets the timer for automatic fire) */
 	void StartFire();
 
-	/** Starts firing the gun in the case of an AI using it, targeting the TargetActor */
-	void ScheduleAiFire();
+	/** Prepares the gun for a new burst of AI fire, resetting the AI's accuracy. The shots themselves are scheduled by
+	 *	UAIManager, which fires the weapon while its owner holds a firing token */
+	void BeginAiFire();
+
+	/** Fires a single trigger pull for whoever is holding the weapon, player or AI. Builds a shot request from the
+	 *	owner's aim, then runs each pellet through the spread, trace, damage and effects stages */
+	void Fire();
+
+	/** Returns the number of traces a single trigger pull makes */
+	int32 GetPelletsPerShot() const { return WeaponData.bIsShotgun ? WeaponData.ShotgunPellets : 1; }
 	
 	/** Stops the timer that allows for automatic fire */
 	void StopFire();
@@ -638,6 +694,9 @@ public:
 	/** Spawns the weapons attachments and applies their data/modifications to the weapon's statistics */ 
 	void SpawnAttachments();
 
+	/** Returns the stats resolved from the weapon's attachments by SpawnAttachments */
+	TSharedPtr<const FResolvedWeaponStats> GetResolvedStats() const { return ResolvedStats; }
+
 	/** Whether the weapon can fire or not */
 	bool CanFire() const { return bCanFire; }
 
@@ -657,8 +716,17 @@ public:
 	 */
 	void SetShouldRecover(const bool bNewShouldRecover) { bShouldRecover = bNewShouldRecover; } 
 
-	/** A reference to the recoil recovery timeline */
-	FTimeline* GetRecoilRecoveryTimeline() { return &RecoilRecoveryTimeline; }
+	/** Cancels any recoil recovery in progress, leaving the player's view where it currently is */
+	void StopRecoilRecovery();
+
+	/** Advances the recoil state machine, interpolating the player back to their initial view while recovering. Called
+	 *	by UWeaponAnimationTicker while the recoil is active
+	 *	@param DeltaTime The time since the last update
+	 */
+	void UpdateRecoil(float DeltaTime);
+
+	/** Whether the weapon is firing or recovering from recoil, and so needs updating every frame */
+	bool IsRecoilActive() const { return RecoilState != EWeaponRecoilState::Idle; }
 
 	/** A reference to the key name of the Weapon Data datatable */
 	FString GetDataTableNameRef() const { return DataTableNameRef; }
@@ -695,6 +763,38 @@ public:
 
 	/** Sets the weapon's display variables to the damaged state */
 	void SetWeaponDestroyed();
+
+	/** Applies damage and spawns effects for the hits of a single pellet. Called straight away for synchronous traces,
+	 *	or by UShotBatchSubsystem and UProjectileSubsystem once their traces have completed
+	 *	@param Shot The shot that was traced
+	 *	@param HitResults The hits returned by the trace
+	 */
+	void ResolveShot(const FQueuedShot& Shot, const TArray<FHitResult>& HitResults);
+
+	/** Returns the collision parameters used for this weapon's traces */
+	const FCollisionQueryParams& GetTraceQueryParams() const { return QueryParams; }
+
+	/** Returns the world location of the muzzle socket, taking the barrel attachment into account */
+	FVector GetMuzzleLocation() const;
+
+	/** Caches the new owner's IWeaponOwner interface, which supplies the aim for every shot */
+	virtual void SetOwner(AActor* NewOwner) override;
+
+	/** Enables or disables the weapon when it is equipped or holstered. Inactive weapons are hidden, stop firing and stop
+	 *	rendering their scope
+	 *	@param bActive Whether the weapon is now the equipped weapon
+	 */
+	void SetWeaponActive(bool bActive);
+
+	/** Returns the weapon to the state it was spawned in, ready to be handed out again by UWeaponPoolSubsystem. Stops
+	 *	any firing, reloading and recoil, detaches the weapon from its owner, repairs its meshes and deactivates it */
+	void ResetForReuse();
+
+	/** Returns the scene capture used to render the scope */
+	USceneCaptureComponent2D* GetScopeCaptureComponent() const { return ScopeCaptureComponent; }
+
+	/** Returns the highest rate that the scope should be captured at */
+	float GetScopeFrameRate() const { return ScopeFrameRate; }
 	
 private:
 
@@ -703,11 +803,27 @@ private:
 	/** Sets default values for this actor's properties */
 	AWeaponBase();
 	
-	/** Spawns the line trace that deals damage and applies sound/visual effects */
-	void Fire();
+	/** Aim stage, fills in the shot's origin, aim, spread and range from our owner and the weapon data
+	 *	@param OutRequest The request to fill in
+	 *	@return Whether our owner has something to fire at
+	 */
+	bool BuildShotRequest(FShotRequest& OutRequest) const;
+
+	/** Spread stage, returns a single pellet's trace with random variation applied to the request's aim */
+	FQueuedShot ApplySpread(const FShotRequest& Request);
 
-	/** Handles firing logic for AI enemies wielding this weapon */
-	void AiFire();
+	/** Trace stage, traces the pellet immediately or hands it to the shot batch or projectile simulation, all of which
+	 *	finish in ResolveShot */
+	void TraceShot(const FQueuedShot& Shot);
+
+	/** Plays the muzzle flash, firing sound and ejected casing for a trigger pull */
+	void PlayFireEffects(const FShotRequest& Request);
+
+	/** Damage stage, applies damage to blocking hits and plays flyby sounds for any overlaps */
+	FShotResult ApplyShotDamage(const FQueuedShot& Shot, const TArray<FHitResult>& HitResults);
+
+	/** Effects stage, spawns the bullet trace and impact effects for a resolved pellet */
+	void PlayShotEffects(const FQueuedShot& Shot, const FShotResult& Result);
 
 	/** Applies recoil to the player controller */
 	void Recoil();
@@ -721,24 +837,43 @@ private:
 	/** Begins applying recoil to the weapon */
 	void StartRecoil();
 
-	/** Initiates the recoil function */
+	/** Stops applying recoil and begins recovering to the view the player had when they started firing */
 	void RecoilRecovery();
 
-	/** Interpolates the player back to their initial view vector */
-	UFUNCTION()
-	void HandleRecoveryProgress(float Value) const;
-
 	/** Converts an unmagnified linear FOV and a magnification constant into a magnified FOV */
 	float FOVFromMagnification() const;
 
-	/** Renders the scope widget to it's virtual texture */
-	void RenderScope() const;
-	
+	/** Launches a simulated projectile for the given shot, rather than tracing it instantly
+	 *	@param Shot The shot being fired, traced from its start along its direction
+	 */
+	void FireProjectile(const FQueuedShot& Shot);
+
+	/** Returns the world location of the particle spawn socket, taking the barrel attachment into account */
+	FVector GetParticleSpawnLocation() const;
+
+	/** Returns the component holding the barrel's sockets, which is the weapon mesh itself for merged or attachment-less
+	 *	weapons */
+	USkeletalMeshComponent* GetBarrelComponent() const;
+
+	/** Returns the component that plays the magazine's reload animations and holds the ejection port */
+	USkeletalMeshComponent* GetMagazineComponent() const;
+
+	/** Returns the intact mesh the weapon was created with */
+	USkeletalMesh* GetDefaultWeaponMesh() const;
+
+	/** Sets the mesh of every attachment component, hiding the components entirely when the weapon is merged
+	 *	@param bBroken Whether to use the broken attachment meshes
+	 */
+	void ApplyAttachmentMeshes(bool bBroken);
+
 	/** Called when the game starts or when spawned */
 	virtual void BeginPlay() override;
+
+	/** Called when the weapon is destroyed or removed from the world */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	
-	/** Called every frame */
-	virtual void Tick(float DeltaTime) override;
+	/** Moves the recoil into a new state, handing the weapon to the animation ticker when it becomes active */
+	void SetRecoilState(EWeaponRecoilState NewState);
 
 #pragma endregion
 
@@ -757,6 +892,17 @@ private:
 	UPROPERTY(EditDefaultsOnly, Category = "Data | Data Table")
 	FString DataTableNameRef;
 
+	/** Whether the player's shots are traced immediately, rather than batched with the rest of the frame's traces and
+	 *	resolved on the next tick. Keeps hit feedback instant for the player */
+	UPROPERTY(EditDefaultsOnly, Category = "Data | Firing")
+	bool bSynchronousPlayerTraces = true;
+
+	/** Whether the weapon and its attachments are merged into a single skeletal mesh, rather than drawn and animated as
+	 *	separate components. Merged meshes are shared by every weapon with the same attachments. Requires the weapon and
+	 *	attachment meshes to share a skeleton and allow CPU access */
+	UPROPERTY(EditDefaultsOnly, Category = "Data | Rendering")
+	bool bMergeAttachmentMeshes = false;
+
 	/** Debug boolean, toggle for debug strings and line traces to be shown */
 	UPROPERTY(EditDefaultsOnly, Category = "Debug")
 	bool bShowDebug = false;
@@ -824,8 +970,8 @@ private:
 	/** Reference to the data stored in the weapon DataTable */
 	FStaticWeaponData WeaponData;
 
-	/** Reference to the data stored in the attachment DataTable */
-	FAttachmentData* AttachmentData;
+	/** The stats resolved from our weapon row and attachments, shared with other weapons using the same attachments */
+	TSharedPtr<const FResolvedWeaponStats> ResolvedStats;
 	
 	/** The override for the weapon socket, in the case that we have a barrel attachment */
 	FName SocketOverride;
@@ -833,18 +979,6 @@ private:
 	/** The override for the particle system socket, in the case that we have a barrel attachment */
 	FName ParticleSocketOverride;
 	
-	/** Keeps track of the starting position of the line trace */
-	FVector TraceStart;
-	
-	/** keeps track of the starting rotation of the line trace (required for calculating the trace end point) */
-	FRotator TraceStartRotation;
-	
-	/** keeps track of the vector direction of the line trace (derived from rotation) */
-	FVector TraceDirection;
-	
-	/** end point of the line trace */
-	FVector TraceEnd;
-	
 	/** collision parameters for spawning the line trace */
 	FCollisionQueryParams QueryParams;
 
@@ -852,9 +986,34 @@ private:
 	UPROPERTY()
 	FHitResult Hit;
 
-	/** Hit results variable set when a multi line trace is spawned, used for AI traces */
+	/** Reusable buffer holding the results of a synchronous trace, passed to ResolveShot */
+	TArray<FHitResult> TraceHitResults;
+
+	/** Whether MeshComp is currently showing a merged mesh of the weapon and its attachments */
+	bool bUsingMergedMesh = false;
+
+	/** The interface of our owner, cached in SetOwner */
+	IWeaponOwner* WeaponOwner = nullptr;
+
+	/** Subsystems that every shot passes through, cached in BeginPlay */
+
 	UPROPERTY()
-	TArray<FHitResult> AiHitResults;
+	UShotBatchSubsystem* ShotBatchSubsystem;
+
+	UPROPERTY()
+	UProjectileSubsystem* ProjectileSubsystem;
+
+	UPROPERTY()
+	UImpactEffectSubsystem* ImpactEffectSubsystem;
+
+	UPROPERTY()
+	UDamageBatchSubsystem* DamageBatchSubsystem;
+
+	UPROPERTY()
+	UWeaponAnimationTicker* AnimationTicker;
+
+	UPROPERTY()
+	UHearingSubsystem* HearingSubsystem;
 
 	/** internal variable used to keep track of the final damage value after modifications */
 	float FinalDamage;
@@ -868,25 +1027,20 @@ private:
 	/** The timer used to keep track of how long a reloading animation takes and only assigning variables */ 
 	FTimerHandle ReloadingDelay;
 	
-	/** The timer used for rendering the scope image */
-	FTimerHandle ScopeRenderTimer;
-	
-	/** The curve for vertical recoil (set from WeaponData) */
-	UPROPERTY()
-	UCurveFloat* VerticalRecoilCurve;
+	/** Whether we are currently firing, recovering, or neither */
+	EWeaponRecoilState RecoilState = EWeaponRecoilState::Idle;
 
-	/** The timeline for vertical recoil (generated from the curve) */
-	FTimeline VerticalRecoilTimeline;
+	/** Time since firing began, used to index the recoil tables */
+	float RecoilTime = 0.0f;
 
-	/** The curve for horizontal recoil (set from WeaponData) */ 
-	UPROPERTY()
-	UCurveFloat* HorizontalRecoilCurve;
+	/** Time since recovery began, used to index the recovery table */
+	float RecoveryTime = 0.0f;
 
-	/** The timeline for horizontal recoil (generated from the curve) */
-	FTimeline HorizontalRecoilTimeline;
+	/** RecoveryCurve, baked when the weapon begins play */
+	FRecoilLookupTable RecoveryTable;
 
-	/** The timeline for recover (set from the curve) */
-	FTimeline RecoilRecoveryTimeline;
+	/** The controller of the player holding this weapon, cached when they start firing */
+	TWeakObjectPtr<AFPSCharacterController> RecoilController;
 	
 	/** A value to temporarily cache the player's control rotation so that we can return to it */
 	FRotator ControlRotation;
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Components/HealthComponent.h"
+#include "DamageBatchSubsystem.generated.h"
+
+class AController;
+class UDamageType;
+
+/** Every hit dealt to one victim by one instigator during a frame, applied together as a single point of damage */
+struct FPendingDamage
+{
+	TWeakObjectPtr<AActor> Victim;
+
+	TWeakObjectPtr<AController> Instigator;
+
+	/** The damage causer and type of the batch's first hit */
+	TWeakObjectPtr<AActor> DamageCauser;
+
+	TSubclassOf<UDamageType> DamageType;
+
+	float TotalDamage = 0.0f;
+
+	/** Index into Hits of the hit that dealt the most damage, which is used as the batch's hit info */
+	int32 HighestDamageHit = 0;
+
+	TArray<FDamageHit> Hits;
+};
+
+/**
+ * Merges the point damage dealt by weapons during a frame, so that each victim takes damage once per instigator rather
+ * than once per pellet. UHealthComponent then clamps and broadcasts its health once for the whole batch, and the
+ * individual hits remain available to its listeners through GetLastDamageHits.
+ */
+UCLASS()
+class ISOLATION_API UDamageBatchSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	/** Adds a hit to this frame's damage. Applied immediately instead if batching is disabled
+	 *	@param Victim The actor that was hit
+	 *	@param Damage The damage dealt by this hit
+	 *	@param ShotDirection The direction the shot was travelling in
+	 *	@param HitInfo The hit itself
+	 *	@param Instigator The controller responsible for the damage
+	 *	@param DamageCauser The actor that dealt the damage, usually the weapon
+	 *	@param DamageType The type of damage dealt
+	 */
+	void QueuePointDamage(AActor* Victim, float Damage, const FVector& ShotDirection, const FHitResult& HitInfo,
+	                      AController* Instigator, AActor* DamageCauser, TSubclassOf<UDamageType> DamageType);
+
+	/** Applies every batch of damage queued this frame */
+	virtual void Tick(float DeltaTime) override;
+
+	/** We only need to tick while there is damage waiting to be applied */
+	virtual bool IsTickable() const override { return PendingDamage.Num() > 0; }
+
+	virtual ETickableTickType GetTickableTickType() const override
+	{
+		return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+	}
+
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UDamageBatchSubsystem, STATGROUP_Tickables); }
+
+private:
+
+	/** Damage queued this frame, in the order each victim and instigator pair was first hit */
+	TArray<FPendingDamage> PendingDamage;
+
+	/** Index into PendingDamage for each victim and instigator pair hit this frame */
+	TMap<TPair<const AActor*, const AController*>, int32> PendingDamageIndices;
+};
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ImpactEffectSubsystem.generated.h"
+
+class UNiagaraSystem;
+class UNiagaraComponent;
+
+/** A fixed set of reusable components for a single Niagara system */
+USTRUCT()
+struct FImpactEffectPool
+{
+	GENERATED_BODY()
+
+	/** The pooled components, created inactive and reactivated in place for each impact */
+	UPROPERTY()
+	TArray<UNiagaraComponent*> Components;
+
+	/** The next component to reuse. Once every component is in use the oldest effect is restarted */
+	int32 NextIndex = 0;
+};
+
+/** An impact waiting to be played */
+struct FQueuedImpactEffect
+{
+	/** The effect to play */
+	UNiagaraSystem* System = nullptr;
+
+	/** Where to play it */
+	FVector Location = FVector::ZeroVector;
+
+	/** The effect's orientation (the surface normal) */
+	FRotator Rotation = FRotator::ZeroRotator;
+};
+
+/**
+ * Plays bullet impact effects from pre-warmed pools of Niagara components rather than spawning a new component per
+ * hit. Impacts are queued as they are resolved and played at the end of the frame, up to a fixed budget, with any
+ * impacts too far from the camera being discarded.
+ */
+UCLASS()
+class ISOLATION_API UImpactEffectSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	/** Creates the pool for an effect ahead of time, so that the first impacts don't pay for component creation
+	 *	@param System The effect to pre-warm
+	 */
+	void WarmPool(UNiagaraSystem* System);
+
+	/** Queues an impact effect to be played this frame
+	 *	@param System The effect to play
+	 *	@param Location Where to play it
+	 *	@param Rotation The orientation of the effect
+	 */
+	void QueueImpactEffect(UNiagaraSystem* System, const FVector& Location, const FRotator& Rotation);
+
+	/** Plays this frame's queued effects */
+	virtual void Tick(float DeltaTime) override;
+
+	/** We only need to tick while there are effects waiting to be played */
+	virtual bool IsTickable() const override { return QueuedEffects.Num() > 0; }
+
+	virtual ETickableTickType GetTickableTickType() const override
+	{
+		return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+	}
+
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UImpactEffectSubsystem, STATGROUP_Tickables); }
+
+private:
+
+	/** Returns the pool for the given effect, creating and filling it if necessary */
+	FImpactEffectPool& FindOrCreatePool(UNiagaraSystem* System);
+
+	/** Pools of components, one per effect */
+	UPROPERTY()
+	TMap<UNiagaraSystem*, FImpactEffectPool> Pools;
+
+	/** Effects queued this frame */
+	TArray<FQueuedImpactEffect> QueuedEffects;
+};
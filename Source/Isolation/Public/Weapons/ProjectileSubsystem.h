@@ -0,0 +1,126 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+#include "Weapons/ShotBatchSubsystem.h"
+#include "ProjectileSubsystem.generated.h"
+
+struct FStaticWeaponData;
+
+/** A segment of a round's flight that has been submitted for tracing */
+struct FProjectileSegment
+{
+	/** The round this segment belongs to */
+	uint32 RoundId = 0;
+
+	/** The shot that fired the round, with its trace start, end and direction set to this segment */
+	FQueuedShot Shot;
+};
+
+/**
+ * Simulates weapon projectiles without an actor per round. Rounds in flight are stored as a structure of arrays and
+ * integrated at a fixed rate, with each step's movement submitted as a batch of asynchronous segment traces. Hits are
+ * handed back to the firing weapon through AWeaponBase::ResolveShot, the same as an instant trace.
+ */
+UCLASS()
+class ISOLATION_API UProjectileSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+	/** Launches a round from the shot's trace start along its trace direction
+	 *	@param Shot The shot being fired. Its weapon, channel and flags are used for every segment of the round's flight
+	 *	@param WeaponData The firing weapon's data, holding the projectile's ballistics
+	 */
+	void FireRound(const FQueuedShot& Shot, const FStaticWeaponData& WeaponData);
+
+	/** Returns the number of rounds currently in flight */
+	int32 GetNumRoundsInFlight() const { return RoundIds.Num(); }
+
+	/** Steps the simulation and submits the resulting segment traces */
+	virtual void Tick(float DeltaTime) override;
+
+	/** We only tick while there are rounds in flight */
+	virtual bool IsTickable() const override { return RoundIds.Num() > 0; }
+
+	virtual ETickableTickType GetTickableTickType() const override
+	{
+		return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+	}
+
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UProjectileSubsystem, STATGROUP_Tickables); }
+
+private:
+
+	/** Integrates every round by a single fixed step, and queues the segment each one travelled */
+	void StepRounds(float StepTime);
+
+	/** Removes the rounds at the given index, keeping all arrays packed */
+	void RemoveRoundAt(int32 Index);
+
+	/** Removes every round that hit something or ran out of time */
+	void RemoveFinishedRounds();
+
+	/** Called by the world when one of our segment traces has completed */
+	void HandleSegmentCompleted(const FTraceHandle& Handle, FTraceDatum& Data);
+
+	/** Round state, one entry per round in flight. Kept as separate arrays so that the integration loop only touches
+	 *	the data it needs and can be vectorised */
+
+	TArray<float> PositionX;
+	TArray<float> PositionY;
+	TArray<float> PositionZ;
+
+	TArray<float> VelocityX;
+	TArray<float> VelocityY;
+	TArray<float> VelocityZ;
+
+	/** Fraction of velocity lost per second */
+	TArray<float> Drag;
+
+	/** Acceleration due to gravity, in cm/s^2 */
+	TArray<float> GravityZ;
+
+	/** Time remaining before the round is removed */
+	TArray<float> TimeRemaining;
+
+	/** Positions at the start of the current step, used as the start of each segment trace */
+	TArray<float> PreviousX;
+	TArray<float> PreviousY;
+	TArray<float> PreviousZ;
+
+	/** Unique ID of each round, so that trace results can find their round after the arrays have been compacted */
+	TArray<uint32> RoundIds;
+
+	/** The shot that fired each round */
+	TArray<FQueuedShot> RoundShots;
+
+	/** Rounds whose segments have hit something, to be removed once every segment in flight has returned */
+	TSet<uint32> FinishedRounds;
+
+	/** Segments that have been submitted and are waiting on their results, indexed by the trace's user data */
+	TArray<FProjectileSegment> InFlightSegments;
+
+	/** The number of submitted segment traces which have not yet returned */
+	int32 OutstandingTraces = 0;
+
+	/** Time that has not yet been simulated */
+	float StepAccumulator = 0.0f;
+
+	/** The ID given to the next round fired */
+	uint32 NextRoundId = 1;
+
+	/** Delegate bound to HandleSegmentCompleted, shared by all segment traces */
+	FTraceDelegate SegmentCompletedDelegate;
+};
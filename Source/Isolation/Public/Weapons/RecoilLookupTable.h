@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UCurveFloat;
+
+/**
+ * A float curve baked into a fixed number of evenly spaced samples, so that it can be read with a table lookup rather
+ * than a curve evaluation. Used for weapon recoil and recoil recovery.
+ */
+struct ISOLATION_API FRecoilLookupTable
+{
+	/** The number of samples taken across the curve's time range */
+	static constexpr int32 NumSamples = 64;
+
+	/** Samples the given curve across its time range, multiplying each sample by Scale. Leaves the table empty if
+	 *	there is no curve
+	 *	@param Curve The curve to bake
+	 *	@param Scale Multiplier applied to every sample
+	 */
+	void Bake(const UCurveFloat* Curve, float Scale = 1.0f);
+
+	/** Returns the value at the given time, relative to the start of the curve. Times outside of the curve are clamped
+	 *	to its first or last sample, and an empty table always returns 0 */
+	float Evaluate(const float Time) const
+	{
+		if (!bIsValid)
+		{
+			return 0.0f;
+		}
+
+		const float SamplePosition = FMath::Clamp(Time * InvSampleSpacing, 0.0f, static_cast<float>(NumSamples - 1));
+		const int32 Index = FMath::Min(FMath::TruncToInt(SamplePosition), NumSamples - 2);
+		return FMath::Lerp(Samples[Index], Samples[Index + 1], SamplePosition - Index);
+	}
+
+	/** Returns the length of the baked curve, in seconds */
+	float GetDuration() const { return Duration; }
+
+	/** Whether a curve has been baked into the table */
+	bool IsValid() const { return bIsValid; }
+
+private:
+
+	float Samples[NumSamples] = {};
+
+	/** The number of samples per second of curve */
+	float InvSampleSpacing = 0.0f;
+
+	float Duration = 0.0f;
+
+	bool bIsValid = false;
+};
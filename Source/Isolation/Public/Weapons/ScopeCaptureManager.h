@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ScopeCaptureManager.generated.h"
+
+class AWeaponBase;
+class AFPSCharacter;
+
+/**
+ * Schedules scope scene captures for the player's equipped scoped weapon. Only ticks while a scoped weapon is
+ * equipped, and only captures while its owner has the scope blended in. The capture rate and render target
+ * resolution are lowered when the game is over its frame time budget, and raised again once there is headroom.
+ */
+UCLASS()
+class ISOLATION_API UScopeCaptureManager : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	/** Starts scheduling captures for the given weapon, replacing any previously active scope
+	 *	@param Weapon The scoped weapon that has been equipped
+	 */
+	void SetActiveScope(AWeaponBase* Weapon);
+
+	/** Stops scheduling captures for the given weapon, if it is the active scope
+	 *	@param Weapon The scoped weapon that has been unequipped
+	 */
+	void ClearActiveScope(const AWeaponBase* Weapon);
+
+	/** Captures the scope when it is due */
+	virtual void Tick(float DeltaTime) override;
+
+	/** We only tick while there is a scoped weapon equipped */
+	virtual bool IsTickable() const override { return ActiveScope.IsValid(); }
+
+	virtual ETickableTickType GetTickableTickType() const override
+	{
+		return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+	}
+
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UScopeCaptureManager, STATGROUP_Tickables); }
+
+private:
+
+	/** Moves the capture rate and resolution towards what the current frame time allows */
+	void UpdateQuality(float DeltaTime);
+
+	/** Resizes the active scope's render target to the current resolution scale */
+	void ApplyResolutionScale();
+
+	/** Restores the active scope's render target to its original size */
+	void RestoreRenderTarget();
+
+	/** The currently equipped scoped weapon */
+	TWeakObjectPtr<AWeaponBase> ActiveScope;
+
+	/** The character holding the active scope, whose scope blend decides whether we capture */
+	TWeakObjectPtr<AFPSCharacter> ActiveScopeOwner;
+
+	/** The size of the active scope's render target before any scaling was applied */
+	FIntPoint OriginalTargetSize = FIntPoint::ZeroValue;
+
+	/** The resolution scale currently applied to the render target */
+	float ResolutionScale = 1.0f;
+
+	/** The capture rate as a fraction of the weapon's ScopeFrameRate */
+	float RateScale = 1.0f;
+
+	/** Smoothed game frame time, in milliseconds */
+	float AverageFrameTimeMs = 0.0f;
+
+	/** Time since the capture rate or resolution last changed, so that we don't thrash between quality levels */
+	float TimeSinceQualityChange = 0.0f;
+
+	/** Time since the last capture */
+	float TimeSinceCapture = 0.0f;
+
+	/** Whether the scope was blended in last frame, so that we can capture as soon as it appears */
+	bool bWasScopeVisible = false;
+};
@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+#include "Weapons/ShotTypes.h"
+#include "ShotBatchSubsystem.generated.h"
+
+/**
+ * Collects every weapon trace queued during a frame and submits them together through the asynchronous trace API.
+ * Results are handed back to the weapon that fired them once the traces complete at the start of the next frame.
+ */
+UCLASS()
+class ISOLATION_API UShotBatchSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+	/** Adds a shot to the current frame's batch
+	 *	@param Shot The shot to trace
+	 */
+	void QueueShot(const FQueuedShot& Shot) { PendingShots.Add(Shot); }
+
+	/** Submits the current batch */
+	virtual void Tick(float DeltaTime) override;
+
+	/** We only need to tick while there are shots waiting to be submitted */
+	virtual bool IsTickable() const override { return PendingShots.Num() > 0; }
+
+	virtual ETickableTickType GetTickableTickType() const override
+	{
+		return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+	}
+
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UShotBatchSubsystem, STATGROUP_Tickables); }
+
+private:
+
+	/** Called by the world when one of our asynchronous traces has completed */
+	void HandleTraceCompleted(const FTraceHandle& Handle, FTraceDatum& Data);
+
+	/** Shots queued this frame, waiting to be submitted */
+	TArray<FQueuedShot> PendingShots;
+
+	/** Shots that have been submitted and are waiting on their results, indexed by the trace's user data */
+	TArray<FQueuedShot> InFlightShots;
+
+	/** The number of submitted traces which have not yet returned */
+	int32 OutstandingTraces = 0;
+
+	/** Delegate bound to HandleTraceCompleted, shared by all traces in the batch */
+	FTraceDelegate TraceCompletedDelegate;
+};
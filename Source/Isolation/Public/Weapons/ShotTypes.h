@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+
+class AWeaponBase;
+
+/** Everything needed to fire a single trigger pull, gathered from the weapon's owner before any pellets are traced */
+struct FShotRequest
+{
+	/** Where the pellets are traced from */
+	FVector Origin = FVector::ZeroVector;
+
+	/** The direction the owner is aiming in, before spread is applied */
+	FRotator AimRotation = FRotator::ZeroRotator;
+
+	/** The maximum random pitch applied to each pellet, in degrees */
+	float SpreadPitch = 0.0f;
+
+	/** The maximum random yaw applied to each pellet, in degrees */
+	float SpreadYaw = 0.0f;
+
+	/** The length of each pellet's trace */
+	float Range = 0.0f;
+
+	/** The number of pellets fired */
+	int32 NumPellets = 1;
+
+	/** The channel that the pellets are traced on */
+	ECollisionChannel TraceChannel = ECC_Visibility;
+
+	/** Whether the shot was fired by an AI */
+	bool bAiShot = false;
+};
+
+/** A single pellet's trace, waiting to be submitted or resolved */
+struct FQueuedShot
+{
+	/** The weapon that fired the shot, and which will resolve its hits */
+	TWeakObjectPtr<AWeaponBase> Weapon;
+
+	/** The start point of the trace */
+	FVector TraceStart = FVector::ZeroVector;
+
+	/** The end point of the trace */
+	FVector TraceEnd = FVector::ZeroVector;
+
+	/** The normalised direction of the trace (used as the damage direction) */
+	FVector TraceDirection = FVector::ForwardVector;
+
+	/** The channel that the trace runs on */
+	ECollisionChannel TraceChannel = ECC_Visibility;
+
+	/** Whether the trace should return every hit along its path (used by AI for flyby sounds) */
+	bool bMultiTrace = false;
+
+	/** Whether the shot was fired by an AI */
+	bool bAiShot = false;
+
+	/** Whether the trace is one segment of a simulated projectile's flight, rather than an instant trace from the muzzle */
+	bool bProjectile = false;
+};
+
+/** The outcome of resolving a single pellet's hits, handed from the damage stage to the effects stage */
+struct FShotResult
+{
+	/** The blocking hit that stopped the pellet, or nullptr if it didn't hit anything */
+	const FHitResult* ImpactHit = nullptr;
+
+	/** Where the pellet stopped, either the blocking hit or the end of its trace */
+	FVector EndPoint = FVector::ZeroVector;
+};
@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WeaponAnimationTicker.generated.h"
+
+class AWeaponBase;
+
+/**
+ * Updates the recoil and recoil recovery of every weapon that is currently firing or recovering, in a single loop.
+ * Weapons register themselves when their recoil starts and are dropped once it settles, so weapons don't need an
+ * actor tick and idle or holstered weapons cost nothing per frame.
+ */
+UCLASS()
+class ISOLATION_API UWeaponAnimationTicker : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	/** Starts updating a weapon's recoil every frame, until it returns to idle
+	 *	@param Weapon The weapon whose recoil has started
+	 */
+	void RegisterWeapon(AWeaponBase* Weapon) { ActiveWeapons.AddUnique(Weapon); }
+
+	/** Stops updating a weapon straight away, for weapons being removed from the world
+	 *	@param Weapon The weapon to stop updating
+	 */
+	void UnregisterWeapon(AWeaponBase* Weapon) { ActiveWeapons.RemoveSwap(Weapon, false); }
+
+	/** Updates every active weapon, dropping those whose recoil has settled */
+	virtual void Tick(float DeltaTime) override;
+
+	/** We only need to tick while a weapon's recoil is active */
+	virtual bool IsTickable() const override { return ActiveWeapons.Num() > 0; }
+
+	virtual ETickableTickType GetTickableTickType() const override
+	{
+		return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+	}
+
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UWeaponAnimationTicker, STATGROUP_Tickables); }
+
+private:
+
+	/** The weapons whose recoil or recovery is in progress */
+	UPROPERTY()
+	TArray<AWeaponBase*> ActiveWeapons;
+};
@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Interface.h"
+#include "WeaponOwner.generated.h"
+
+class AWeaponBase;
+
+// This class does not need to be modified.
+UINTERFACE(MinimalAPI)
+class UWeaponOwner : public UInterface
+{
+	GENERATED_BODY()
+};
+
+/**
+ * Implemented by anything that can hold and fire a weapon. The weapon caches its owner's interface when its owner is
+ * set, so that firing never has to find or cast to the player or AI.
+ */
+class ISOLATION_API IWeaponOwner
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Returns where the weapon's shots should be traced from and the direction they are aimed in, before spread
+	 *	@param Weapon The weapon being fired
+	 *	@param OutOrigin The start point of every pellet's trace
+	 *	@param OutAimRotation The direction the shot is aimed in
+	 *	@return Whether the owner has something to aim at
+	 */
+	virtual bool GetShotAim(const AWeaponBase* Weapon, FVector& OutOrigin, FRotator& OutAimRotation) const = 0;
+
+	/** Whether the owner is aiming down the weapon's sights, which tightens its spread */
+	virtual bool IsAimingWeapon() const { return false; }
+
+	/** Whether the owner is an AI. AI shots use the weapon's AI data for spread and damage */
+	virtual bool IsAiWeaponOwner() const { return false; }
+
+	/** Called once the weapon has degraded to the point of breaking
+	 *	@param Weapon The broken weapon
+	 */
+	virtual void OnWeaponBroken(AWeaponBase* Weapon) {}
+};
@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WeaponPoolSubsystem.generated.h"
+
+class AWeaponBase;
+class AWeaponPickup;
+
+/** The inactive actors of a single class, waiting to be reused */
+USTRUCT()
+struct FPooledActors
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<AActor*> Actors;
+};
+
+/**
+ * Recycles weapon and pickup actors, so that swapping, picking up and dropping weapons doesn't construct a new actor
+ * (and all of its mesh and scene capture components) every time. Released actors are reset, hidden and have their
+ * collision disabled, then handed back out the next time an actor of the same class is requested.
+ */
+UCLASS()
+class ISOLATION_API UWeaponPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	/** Returns an inactive weapon of the given class, spawning one if the pool is empty. The caller is responsible for
+	 *	setting the weapon's owner, runtime data and attachments, and for activating it
+	 *	@param WeaponClass The class of weapon to acquire
+	 *	@return The weapon, or nullptr if it could not be spawned
+	 */
+	AWeaponBase* AcquireWeapon(TSubclassOf<AWeaponBase> WeaponClass);
+
+	/** Resets a weapon and returns it to the pool, destroying it instead if the pool for its class is full
+	 *	@param Weapon The weapon to release
+	 */
+	void ReleaseWeapon(AWeaponBase* Weapon);
+
+	/** Returns a pickup of the given class, placed at the given transform. Pickups are returned inactive, so that
+	 *	their data can be set before they are shown with SetPickupActive
+	 *	@param PickupClass The class of pickup to acquire
+	 *	@param Transform Where to place the pickup
+	 *	@return The pickup, or nullptr if it could not be spawned
+	 */
+	AWeaponPickup* AcquirePickup(TSubclassOf<AWeaponPickup> PickupClass, const FTransform& Transform);
+
+	/** Hides a pickup and returns it to the pool, destroying it instead if the pool for its class is full
+	 *	@param Pickup The pickup to release
+	 */
+	void ReleasePickup(AWeaponPickup* Pickup);
+
+private:
+
+	/** Takes an actor of the given class from its pool, or spawns a new one */
+	AActor* AcquireActor(UClass* ActorClass, const FTransform& Transform, bool& bOutSpawned);
+
+	/** Adds an actor to its class's pool, returning false if the pool is already full */
+	bool AddToPool(AActor* Actor);
+
+	/** Inactive actors, keyed by class */
+	UPROPERTY()
+	TMap<UClass*, FPooledActors> Pools;
+};
@@ -0,0 +1,249 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WeaponBase.h"
+#include "Weapons/RecoilLookupTable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WeaponStatsCache.generated.h"
+
+/** The meshes used by a single attachment slot */
+USTRUCT()
+struct FResolvedAttachmentSlot
+{
+	GENERATED_BODY()
+
+	/** The skeletal mesh displayed on the weapon itself */
+	UPROPERTY()
+	USkeletalMesh* Mesh = nullptr;
+
+	/** The skeletal mesh displayed on the weapon once it has been destroyed */
+	UPROPERTY()
+	USkeletalMesh* BrokenMesh = nullptr;
+
+	/** The static mesh displayed on the weapon pickup */
+	UPROPERTY()
+	UStaticMesh* PickupMesh = nullptr;
+};
+
+/** The result of applying a set of attachments to a weapon's static data. Resolved once per (weapon, attachment set)
+ *	pair and then shared between every weapon, pickup and AI using that combination, so should never be modified */
+USTRUCT()
+struct FResolvedWeaponStats
+{
+	GENERATED_BODY()
+
+	/** The weapon's static data, with every attachment override already applied */
+	UPROPERTY()
+	FStaticWeaponData WeaponData;
+
+	/** Default ammunition type (from the magazine attachment, or the weapon itself) */
+	UPROPERTY()
+	EAmmoType AmmoType = EAmmoType::Pistol;
+
+	/** Default clip capacity (from the magazine attachment, or the weapon itself) */
+	UPROPERTY()
+	int ClipCapacity = 0;
+
+	/** Default clip size (from the magazine attachment, or the weapon itself) */
+	UPROPERTY()
+	int ClipSize = 0;
+
+	/** Whether the attachment set contains a magazine */
+	UPROPERTY()
+	bool bHasMagazine = false;
+
+	/** The sum of the modifications the attachments make to damage */
+	UPROPERTY()
+	float DamageModifier = 0.0f;
+
+	/** The sum of the modifications the attachments make to pitch */
+	UPROPERTY()
+	float WeaponPitchModifier = 0.0f;
+
+	/** The sum of the modifications the attachments make to yaw */
+	UPROPERTY()
+	float WeaponYawModifier = 0.0f;
+
+	/** The multiplier for vertical recoil */
+	UPROPERTY()
+	float VerticalRecoilModifier = 1.0f;
+
+	/** The multiplier for horizontal recoil */
+	UPROPERTY()
+	float HorizontalRecoilModifier = 1.0f;
+
+	/** The offset given to the camera in order to align the gun sights */
+	UPROPERTY()
+	float VerticalCameraOffset = 0.0f;
+
+	/** Attachment meshes, indexed by EAttachmentType */
+	UPROPERTY()
+	TArray<FResolvedAttachmentSlot> AttachmentSlots;
+
+	/** Animations, taken from the weapon and overridden by the grip attachment */
+
+	UPROPERTY()
+	UAnimMontage* WeaponEquip = nullptr;
+
+	UPROPERTY()
+	UBlendSpace* WalkBlendSpace = nullptr;
+
+	UPROPERTY()
+	UBlendSpace* ADSWalkBlendSpace = nullptr;
+
+	UPROPERTY()
+	UAnimSequence* Anim_Idle = nullptr;
+
+	UPROPERTY()
+	UAnimSequence* Anim_Sprint = nullptr;
+
+	UPROPERTY()
+	UAnimSequence* Anim_ADS_Idle = nullptr;
+
+	/** The impact effect for each surface, built from the weapon's damage surfaces and SurfaceHitEffects. Everything
+	 *	in here is also referenced by WeaponData, so it doesn't need to be a UPROPERTY */
+	TMap<const UPhysicalMaterial*, UNiagaraSystem*> ImpactEffects;
+
+	/** Returns the impact effect to play when the given surface is hit, or the default hit effect for unknown surfaces */
+	UNiagaraSystem* FindImpactEffect(const UPhysicalMaterial* Surface) const
+	{
+		UNiagaraSystem* const* Effect = ImpactEffects.Find(Surface);
+		return Effect ? *Effect : WeaponData.DefaultHitEffect;
+	}
+
+	/** The vertical recoil curve, baked with VerticalRecoilModifier already applied */
+	FRecoilLookupTable VerticalRecoilTable;
+
+	/** The horizontal recoil curve, baked with HorizontalRecoilModifier already applied */
+	FRecoilLookupTable HorizontalRecoilTable;
+
+	/** Bakes the recoil curves from WeaponData into the recoil tables */
+	void BakeRecoilTables();
+
+	/** Returns the meshes for the given attachment slot */
+	const FResolvedAttachmentSlot& GetSlot(const EAttachmentType Type) const { return AttachmentSlots[static_cast<uint8>(Type)]; }
+};
+
+/** Key identifying a weapon row and a set of attachments. Attachments are sorted so that the order they were
+ *	picked in doesn't matter */
+struct FWeaponStatsKey
+{
+	const UDataTable* WeaponDataTable = nullptr;
+
+	FName WeaponRowName;
+
+	TArray<FName, TInlineAllocator<5>> Attachments;
+
+	FWeaponStatsKey(const UDataTable* InWeaponDataTable, const FName InWeaponRowName, const TArray<FName>& InAttachments);
+
+	bool operator==(const FWeaponStatsKey& Other) const
+	{
+		return WeaponDataTable == Other.WeaponDataTable && WeaponRowName == Other.WeaponRowName && Attachments == Other.Attachments;
+	}
+
+	friend uint32 GetTypeHash(const FWeaponStatsKey& Key)
+	{
+		uint32 Hash = HashCombine(GetTypeHash(Key.WeaponDataTable), GetTypeHash(Key.WeaponRowName));
+		for (const FName Attachment : Key.Attachments)
+		{
+			Hash = HashCombine(Hash, GetTypeHash(Attachment));
+		}
+		return Hash;
+	}
+};
+
+/** Key identifying a merged weapon mesh: the weapon's base mesh with the meshes of a set of attachments */
+struct FMergedWeaponMeshKey
+{
+	FWeaponStatsKey StatsKey;
+
+	const USkeletalMesh* BaseMesh = nullptr;
+
+	/** Whether the mesh is built from the broken versions of the attachments */
+	bool bBroken = false;
+
+	bool operator==(const FMergedWeaponMeshKey& Other) const
+	{
+		return StatsKey == Other.StatsKey && BaseMesh == Other.BaseMesh && bBroken == Other.bBroken;
+	}
+
+	friend uint32 GetTypeHash(const FMergedWeaponMeshKey& Key)
+	{
+		return HashCombine(HashCombine(GetTypeHash(Key.StatsKey), GetTypeHash(Key.BaseMesh)), GetTypeHash(Key.bBroken));
+	}
+};
+
+/**
+ * Per-world cache of resolved weapon stats. Turns a weapon row and attachment set into a single flattened
+ * FResolvedWeaponStats the first time it is requested, so that spawning weapons, pickups and AI loadouts doesn't
+ * repeatedly search the data tables.
+ */
+UCLASS()
+class ISOLATION_API UWeaponStatsCache : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Returns the resolved stats for the given weapon and attachments, resolving them if they aren't cached yet
+	 *	@param WeaponDataTable The table holding the weapon's FStaticWeaponData
+	 *	@param WeaponRowName The weapon's row in WeaponDataTable
+	 *	@param Attachments The attachments applied to the weapon
+	 *	@return The resolved stats, or nullptr if the weapon row could not be found
+	 */
+	TSharedPtr<const FResolvedWeaponStats> FindOrResolve(const UDataTable* WeaponDataTable, FName WeaponRowName,
+	                                                     const TArray<FName>& Attachments);
+
+	/** Looks up the world's cache and returns the resolved stats from it. Falls back to resolving the stats without
+	 *	caching them if there is no world (e.g. when previewing a pickup outside of a level)
+	 *	@param WorldContextObject Any object in the world whose cache should be used
+	 */
+	static TSharedPtr<const FResolvedWeaponStats> GetStats(const UObject* WorldContextObject, const UDataTable* WeaponDataTable,
+	                                                       FName WeaponRowName, const TArray<FName>& Attachments);
+
+	/** Returns a single skeletal mesh combining the weapon's base mesh with the meshes of its attachments, merging it
+	 *	the first time it is requested. Every weapon using the same base mesh and attachment set shares the result.
+	 *	The source meshes must share a skeleton and allow CPU access to their render data
+	 *	@param WeaponDataTable The table holding the weapon's FStaticWeaponData
+	 *	@param WeaponRowName The weapon's row in WeaponDataTable
+	 *	@param Attachments The attachments applied to the weapon
+	 *	@param BaseMesh The weapon's own mesh, which the attachments are merged onto
+	 *	@param bBroken Whether to merge the attachments' broken meshes rather than their intact ones
+	 *	@return The merged mesh, or nullptr if the meshes could not be merged
+	 */
+	USkeletalMesh* FindOrMergeMesh(const UDataTable* WeaponDataTable, FName WeaponRowName, const TArray<FName>& Attachments,
+	                               USkeletalMesh* BaseMesh, bool bBroken);
+
+	virtual void Deinitialize() override;
+
+private:
+
+	/** Builds the resolved stats for the given weapon and attachments */
+	static TSharedPtr<FResolvedWeaponStats> ResolveStats(const UDataTable* WeaponDataTable, FName WeaponRowName,
+	                                                     const TArray<FName>& Attachments);
+
+	/** Throws away all cached stats when one of the tables they were built from is modified */
+	void HandleDataTableChanged()
+	{
+		ResolvedStats.Reset();
+		MergedMeshes.Reset();
+		MergedMeshReferences.Reset();
+	}
+
+	/** The cached stats */
+	TMap<FWeaponStatsKey, TSharedRef<const FResolvedWeaponStats>> ResolvedStats;
+
+	/** The cached merged meshes. Meshes that failed to merge are cached as nullptr, so that we don't retry them */
+	TMap<FMergedWeaponMeshKey, USkeletalMesh*> MergedMeshes;
+
+	/** Keeps every merged mesh alive for as long as it is cached */
+	UPROPERTY()
+	TArray<USkeletalMesh*> MergedMeshReferences;
+
+	/** The tables that cached stats were resolved from. Holding on to these keeps every asset referenced by the
+	 *	cached stats loaded */
+	UPROPERTY()
+	TArray<UDataTable*> ReferencedTables;
+};
@@ -12,19 +12,22 @@ public:
 	/**
 	 * Obtain a random set of attachments (one of each type)
 	 * @param AttachmentDataTable Data Table from which we pull attachments
+	 * @param RandomStream The stream to draw from, so that a loadout can be rebuilt from its seed. Uses the global
+	 * random number generator if null
 	 * @warning Make sure that AttachmentDataTable is of type FAttachmentData
 	 * @return A randomised array of weapon attachments
 	 */
-	static TArray<FName> RandomiseAllAttachments(UDataTable* AttachmentDataTable);
+	static TArray<FName> RandomiseAllAttachments(UDataTable* AttachmentDataTable, const FRandomStream* RandomStream = nullptr);
 
 	/**
 	 * Clean up attachment incompatibilities in the given attachment set
 	 * @param AttachmentDataTable Data Table from which we pull attachments
 	 * @param CurrentAttachments The array of the weapon's current attachments
+	 * @param RandomStream The stream to draw replacements from. Uses the global random number generator if null
 	 * @warning Make sure that AttachmentDataTable is of type FAttachmentData
 	 * @return A cleaned up array of weapon attachments with no incompatibilities
 	 */
-	static TArray<FName> ReplaceIncompatibleAttachments(UDataTable* AttachmentDataTable, TArray<FName> CurrentAttachments);
+	static TArray<FName> ReplaceIncompatibleAttachments(UDataTable* AttachmentDataTable, TArray<FName> CurrentAttachments, const FRandomStream* RandomStream = nullptr);
 
 	/**
 	 * Collect all keys from a data table
@@ -32,4 +35,12 @@ public:
 	 * @return An array of keys as strings
 	 */
 	static TArray<FString> GetDataTableKeyColumnAsString(UDataTable* DataTable);
+
+private:
+
+	/** Returns a random index into an array of the given size, from the stream if there is one */
+	static int32 RandomIndex(const int32 Num, const FRandomStream* RandomStream)
+	{
+		return RandomStream ? RandomStream->RandRange(0, Num - 1) : FMath::RandRange(0, Num - 1);
+	}
 };